@@ -17,31 +17,162 @@
 #include <stdio.h>
 #include "assert.h"
 #include "compress40.h"
+#include "batch.h"
+#include "stats.h"
 
 static void (*compress_or_decompress)(FILE *input) = compress40;
 
+/* Parses a positive count such as the N in "-j N", or exits */
+static unsigned parseCount(const char *progname, const char *arg)
+{
+        char *end;
+        long count = strtol(arg, &end, 10);
+
+        if (*arg == '\0' || *end != '\0' || count < 1 || count > 1024) {
+                fprintf(stderr, "%s: bad count '%s'\n", progname, arg);
+                exit(1);
+        }
+        return count;
+}
+
+/* Parses the "x,y,w,h" of "--crop x,y,w,h" into the options, or exits */
+static void parseCrop(const char *progname, const char *arg)
+{
+        unsigned x, y, w, h;
+        int used = -1;
+
+        sscanf(arg, "%u,%u,%u,%u%n", &x, &y, &w, &h, &used);
+        if (used < 0 || arg[used] != '\0' || w == 0 || h == 0) {
+                fprintf(stderr, "%s: bad crop '%s'\n", progname, arg);
+                exit(1);
+        }
+        compress40Options.crop.x = x;
+        compress40Options.crop.y = y;
+        compress40Options.crop.width = w;
+        compress40Options.crop.height = h;
+}
+
+/* Parses the "1/N" of "--scale 1/N" into the options, or exits */
+static void parseScale(const char *progname, const char *arg)
+{
+        if (strcmp(arg, "1/2") == 0) {
+                compress40Options.scale = 2;
+        } else if (strcmp(arg, "1/4") == 0) {
+                compress40Options.scale = 4;
+        } else if (strcmp(arg, "1/8") == 0) {
+                compress40Options.scale = 8;
+        } else {
+                fprintf(stderr, "%s: bad scale '%s' (1/2, 1/4 or 1/8)\n", 
+                        progname, arg);
+                exit(1);
+        }
+}
+
 int main(int argc, char *argv[])
 {
         int i;
+        const char *batchList = NULL, *outDir = NULL;
 
         for (i = 1; i < argc; i++) {
                 if (strcmp(argv[i], "-c") == 0) {
                         compress_or_decompress = compress40;
                 } else if (strcmp(argv[i], "-d") == 0) {
                         compress_or_decompress = decompress40;
+                } else if (strcmp(argv[i], "--stream") == 0) {
+                        compress40Options.stream = 1;
+                } else if (strcmp(argv[i], "--pipeline") == 0) {
+                        compress40Options.pipeline = 1;
+                } else if (strcmp(argv[i], "--saturate") == 0) {
+                        compress40Options.saturate = 1;
+                } else if (strcmp(argv[i], "--exact") == 0) {
+                        compress40Options.exact = 1;
+                } else if (strcmp(argv[i], "--entropy") == 0) {
+                        compress40Options.entropy = 1;
+                } else if (strcmp(argv[i], "--tiled") == 0) {
+                        compress40Options.tiled = 1;
+                } else if (strcmp(argv[i], "--plain") == 0) {
+                        compress40Options.plain = 1;
+                } else if (strcmp(argv[i], "--stats") == 0) {
+                        Stats_enable(NULL);
+                } else if (strncmp(argv[i], "--stats=", 8) == 0) {
+                        Stats_enable(argv[i] + 8);
+                } else if (strcmp(argv[i], "--profile") == 0) {
+                        Stats_profile();
+                } else if (strcmp(argv[i], "--scale") == 0 && 
+                           i + 1 < argc) {
+                        parseScale(argv[0], argv[++i]);
+                } else if (strcmp(argv[i], "--crop") == 0 && i + 1 < argc) {
+                        parseCrop(argv[0], argv[++i]);
+                } else if (strcmp(argv[i], "--batch") == 0 && 
+                           i + 1 < argc) {
+                        batchList = argv[++i];
+                } else if (strcmp(argv[i], "--outdir") == 0 && 
+                           i + 1 < argc) {
+                        outDir = argv[++i];
+                } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+                        compress40Options.threads = parseCount(argv[0], 
+                                                               argv[++i]);
                 } else if (*argv[i] == '-') {
                         fprintf(stderr, "%s: unknown option '%s'\n",
                                 argv[0], argv[i]);
                         exit(1);
                 } else if (argc - i > 2) {
-                        fprintf(stderr, "Usage: %s -d [filename]\n"
-                                "       %s -c [filename]\n",
-                                argv[0], argv[0]);
+                        fprintf(stderr, "Usage: %s -d [-j N] [--stream | "
+                                "--pipeline | --crop x,y,w,h | --scale 1/N]\n"
+                                "          [--exact] [--tiled] [--plain] "
+                                "[--stats[=file]] [--profile] [filename]\n"
+                                "       %s -c [-j N] [--stream | --pipeline] "
+                                "[--saturate] [--exact] [--entropy]\n"
+                                "          [--tiled] [--stats[=file]] "
+                                "[--profile] [filename]\n"
+                                "       %s -c|-d --batch list --outdir dir "
+                                "[-j N] [--saturate] [--exact]\n"
+                                "          [--entropy] [--plain]\n",
+                                argv[0], argv[0], argv[0]);
                         exit(1);
                 } else {
                         break;
                 }
         }
+        if (compress40Options.crop.width > 0 && compress40Options.scale > 1) {
+                fprintf(stderr, "%s: --crop and --scale do not combine\n",
+                        argv[0]);
+                exit(1);
+        }
+        if (compress40Options.stream && compress40Options.pipeline) {
+                fprintf(stderr, "%s: --stream and --pipeline do not "
+                        "combine\n", argv[0]);
+                exit(1);
+        }
+        if (compress40Options.entropy && (compress40Options.stream ||
+                                          compress40Options.pipeline)) {
+                fprintf(stderr, "%s: --entropy does not combine with "
+                        "--stream or --pipeline\n", argv[0]);
+                exit(1);
+        }
+        if (compress40Options.tiled && (compress40Options.stream || 
+                                        compress40Options.pipeline ||
+                                        compress40Options.crop.width > 0 ||
+                                        compress40Options.scale > 1)) {
+                fprintf(stderr, "%s: --tiled does not combine with "
+                        "--stream, --pipeline, --crop or --scale\n", 
+                        argv[0]);
+                exit(1);
+        }
+        if (batchList != NULL) {
+                if (outDir == NULL || i < argc || compress40Options.stream ||
+                    compress40Options.pipeline || compress40Options.tiled ||
+                    compress40Options.crop.width > 0 || 
+                    compress40Options.scale > 1 || Stats_enabled) {
+                        fprintf(stderr, "%s: --batch needs --outdir and no "
+                                "filename, --stream, --pipeline, --tiled, "
+                                "--crop, --scale or --stats\n", argv[0]);
+                        exit(1);
+                }
+                unsigned failed = Batch_run(batchList, outDir, 
+                                        compress_or_decompress == compress40);
+                return failed > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+        }
         assert(argc - i <= 1);    /* at most one file on command line */
         if (i < argc) {
                 FILE *fp = fopen(argv[i], "r");
@@ -51,6 +182,8 @@ int main(int argc, char *argv[])
         } else {
                 compress_or_decompress(stdin);
         }
+        Stats_report(compress_or_decompress == compress40 ? "compress" 
+                                                          : "decompress");
 
         return EXIT_SUCCESS; 
 }
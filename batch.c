@@ -0,0 +1,553 @@
+/**************************************************************
+ *
+ *                     batch.c
+ *
+ *     Assignment: arith
+ *     Authors: Anh Hoang, Emilio Aleman
+ *     Date:  3/8/2024
+ *
+ *    This file contains the implementation of batch mode. Every file in
+ *    the list is a task on a work-stealing pool. A file task reads its
+ *    input and splits it into bands of block rows: a small image is one
+ *    band, which the task runs itself, while a large one spawns a task
+ *    per band for idle workers to steal. Whichever band finishes last
+ *    writes the output file and reports the file's throughput.
+ *
+ **************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "assert.h"
+#include "mem.h"
+#include "compress40.h"
+#include "encodeKernel.h"
+#include "decodeKernel.h"
+#include "codewordIO.h"
+#include "workPool.h"
+#include "chunked.h"
+#include "batch.h"
+
+/* Images are split into bands of about this many blocks */
+#define BAND_BLOCKS 65536
+
+/* One file of the batch. Compressing, image holds the pixels read and
+ * words the codewords, in file order (host order with --entropy);
+ * decompressing, body holds the codewords read, or for format 3 chunked
+ * reads a chunk per band from input into words, and image the pixels. */
+struct BatchFile
+{
+        char *path, *outPath;
+        int compress;
+        PackedImage image;
+        unsigned width, height;
+        unsigned blocks, blockRows, rowsPerBand;
+        uint32_t *words;
+        unsigned char *body;
+        FILE *input;
+        ChunkedReader chunked;
+        struct BatchBand *bands;
+        unsigned remaining;     /* bands not yet done, updated atomically */
+        struct timespec start;
+        int failed;
+};
+
+struct BatchBand
+{
+        struct BatchFile *file;
+        unsigned index;
+};
+
+static void fileTask(WorkPool pool, unsigned worker, void *arg);
+static void bandTask(WorkPool pool, unsigned worker, void *arg);
+static void encodeRows(struct BatchFile *file, unsigned first,
+                       unsigned last);
+static void decodeRows(struct BatchFile *file, unsigned first,
+                       unsigned last);
+static void finishFile(struct BatchFile *file);
+static char *outputPath(const char *outDir, const char *path,
+                        const char *extension);
+static double elapsedMs(const struct timespec *start);
+static int openCompressed(FILE *input, struct BatchFile *file);
+
+/********** Batch_run ********
+ * 
+ * Compresses or decompresses every file named in a list, writing the
+ * results to a directory
+ *
+ * Parameters:
+ *      const char *listPath: A file naming one input per line; blank
+ *                            lines and lines starting with '#' are skipped
+ *      const char *outDir:   Where the outputs go, created if missing
+ *      int compress:         1 to compress PPM images to <name>.c40, 0 to
+ *                            decompress to <name>.ppm, where <name> is the
+ *                            input's file name without its extension
+ * 
+ * Return: the number of files that could not be opened or written
+ *
+ * Notes:
+ *      - CRE if a path is NULL, the list cannot be read or an input is
+ *        badly formatted, as when compressing one file
+ *      - uses compress40Options.threads threads and honours saturate,
+ *        exact, entropy and plain; a line per file, then a total, goes to 
+ *        stderr
+ *      - decompresses format 2 and format 3 alike
+ *      
+ **********************************/
+unsigned Batch_run(const char *listPath, const char *outDir, int compress)
+{
+        assert(listPath != NULL && outDir != NULL);
+
+        FILE *list = fopen(listPath, "r");
+        assert(list != NULL);
+        if (mkdir(outDir, 0777) != 0) {
+                assert(errno == EEXIST);
+        }
+
+        encodeSetEngine(compress40Options.exact ? ENCODE_EXACT
+                                                : ENCODE_FIXED);
+        decodeSetEngine(compress40Options.exact ? DECODE_EXACT
+                                                : DECODE_TABLES);
+        PackedImage_setFormat(compress40Options.plain ? PPM_PLAIN : PPM_RAW);
+
+        unsigned count = 0, size = 16;
+        struct BatchFile *files = ALLOC(size * sizeof(*files));
+        char *line = NULL;
+        size_t capacity = 0;
+        ssize_t length;
+
+        while ((length = getline(&line, &capacity, list)) >= 0) {
+                while (length > 0 && (line[length - 1] == '\n' ||
+                                      line[length - 1] == '\r')) {
+                        line[--length] = '\0';
+                }
+                if (length == 0 || line[0] == '#') {
+                        continue;
+                }
+                if (count == size) {
+                        size *= 2;
+                        RESIZE(files, size * sizeof(*files));
+                }
+
+                struct BatchFile *file = &files[count++];
+                memset(file, 0, sizeof(*file));
+                file->path = ALLOC(length + 1);
+                strcpy(file->path, line);
+                file->outPath = outputPath(outDir, line,
+                                           compress ? ".c40" : ".ppm");
+                file->compress = compress;
+        }
+        free(line);     /* from getline, so not through Mem */
+        fclose(list);
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        unsigned threads = compress40Options.threads;
+        WorkPool pool = WorkPool_new(threads);
+        /* Spawned last first, as each worker takes its newest task */
+        for (unsigned i = count; i-- > 0; ) {
+                WorkPool_spawn(pool, i % threads, fileTask, &files[i]);
+        }
+        WorkPool_run(pool);
+        WorkPool_free(&pool);
+
+        unsigned failed = 0;
+        double megabytes = 0;
+        for (unsigned i = 0; i < count; i++) {
+                failed += files[i].failed;
+                if (!files[i].failed) {
+                        megabytes += files[i].width * 3.0 *
+                                     files[i].height / 1e6;
+                }
+                FREE(files[i].path);
+                FREE(files[i].outPath);
+        }
+        FREE(files);
+
+        double ms = elapsedMs(&start);
+        fprintf(stderr, "batch: %u files, %u failed, %.1f MB of pixels in "
+                "%.1f ms, %.1f MB/s\n", count, failed, megabytes, ms,
+                ms > 0 ? megabytes * 1000 / ms : 0);
+
+        return failed;
+}
+
+/********** fileTask ********
+ * 
+ * Reads one file of the batch and starts work on its bands
+ *
+ * Parameters:
+ *      WorkPool pool:   The pool running the batch
+ *      unsigned worker: The thread running the task
+ *      void *arg:       The struct BatchFile
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if an image to compress is badly formatted or truncated
+ *      - a compressed image with a bad header, or a format 3 image cut
+ *        short, fails like a file that cannot be opened; a format 2 body
+ *        cut short is padded with 0xff, as in decompress40
+ *      - the first band runs here; the rest are spawned for stealing
+ *      
+ **********************************/
+static void fileTask(WorkPool pool, unsigned worker, void *arg)
+{
+        struct BatchFile *file = arg;
+        clock_gettime(CLOCK_MONOTONIC, &file->start);
+
+        FILE *input = fopen(file->path, "rb");
+        if (input == NULL) {
+                fprintf(stderr, "%s: cannot open\n", file->path);
+                file->failed = 1;
+                return;
+        }
+
+        if (file->compress) {
+                file->image = PackedImage_map(input);
+                if (file->image == NULL) {
+                        file->image = PackedImage_read(input, 1);
+                }
+                file->width = file->image->width & ~1u;
+                file->height = file->image->height & ~1u;
+        } else if (!openCompressed(input, file)) {
+                fprintf(stderr, "%s: not a compressed image\n", file->path);
+                fclose(input);
+                file->failed = 1;
+                return;
+        } else if (file->chunked != NULL) {
+                ChunkedReader_load(file->chunked);
+        }
+        assert(file->width % 2 == 0 && file->height % 2 == 0);
+
+        file->blocks = file->width / 2;
+        file->blockRows = file->height / 2;
+        size_t count = (size_t)file->blocks * file->blockRows;
+
+        if (file->compress || file->chunked != NULL) {
+                file->words = ALLOC(count * sizeof(uint32_t) + 1);
+        }
+        if (!file->compress) {
+                file->image = PackedImage_new(file->width, file->height);
+        }
+        if (!file->compress && file->chunked == NULL) {
+                file->body = ALLOC(count * 4 + 1);
+                size_t read = fread(file->body, 1, count * 4, input);
+                memset(file->body + read, 0xff, count * 4 - read);
+        }
+
+        /* A band of format 3 is a chunk, which its task reads itself */
+        if (file->chunked != NULL) {
+                file->input = input;
+                file->rowsPerBand = ChunkedReader_rowsPerChunk(file->chunked);
+        } else {
+                fclose(input);
+                file->rowsPerBand = BAND_BLOCKS / (file->blocks > 0
+                                                   ? file->blocks : 1);
+        }
+        if (file->rowsPerBand == 0) {
+                file->rowsPerBand = 1;
+        }
+        unsigned bands = (file->blockRows + file->rowsPerBand - 1) /
+                         file->rowsPerBand;
+        if (bands == 0) {
+                finishFile(file);
+                return;
+        }
+
+        file->remaining = bands;
+        file->bands = ALLOC(bands * sizeof(*file->bands));
+        for (unsigned i = bands; i-- > 0; ) {
+                file->bands[i].file = file;
+                file->bands[i].index = i;
+                if (i > 0) {
+                        WorkPool_spawn(pool, worker, bandTask,
+                                       &file->bands[i]);
+                }
+        }
+        bandTask(pool, worker, &file->bands[0]);
+}
+
+/********** bandTask ********
+ * 
+ * Compresses or decompresses one band of a file, and finishes the file
+ * if it was the last band left
+ *
+ * Parameters:
+ *      WorkPool pool:   The pool running the batch
+ *      unsigned worker: The thread running the task
+ *      void *arg:       The struct BatchBand
+ * 
+ * Return: none
+ *
+ * Notes: none
+ *      
+ **********************************/
+static void bandTask(WorkPool pool, unsigned worker, void *arg)
+{
+        struct BatchBand *band = arg;
+        struct BatchFile *file = band->file;
+        (void)pool;
+        (void)worker;
+
+        unsigned first = band->index * file->rowsPerBand;
+        unsigned last = first + file->rowsPerBand;
+        if (last > file->blockRows) {
+                last = file->blockRows;
+        }
+
+        if (file->compress) {
+                encodeRows(file, first, last);
+        } else {
+                decodeRows(file, first, last);
+        }
+
+        if (__atomic_sub_fetch(&file->remaining, 1, __ATOMIC_ACQ_REL) == 0) {
+                finishFile(file);
+        }
+}
+
+/********** encodeRows ********
+ * 
+ * Compresses block rows of a file into its codewords, in file order
+ *
+ * Parameters:
+ *      struct BatchFile *file: The file
+ *      unsigned first:         The first block row
+ *      unsigned last:          One past the last block row
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - raises Bitpack_Overflow as compress40 does, unless saturating
+ *      - with --entropy the codewords stay in host order for 
+ *        Chunked_write
+ *      
+ **********************************/
+static void encodeRows(struct BatchFile *file, unsigned first,
+                       unsigned last)
+{
+        PackedImage image = file->image;
+        Bitpack_mode mode = compress40Options.saturate ? BITPACK_SATURATE
+                                                       : BITPACK_CHECKED;
+        struct Compressed *comps = ALLOC((file->blocks + 1) *
+                                         sizeof(*comps));
+        uint32_t *words = file->words + (size_t)first * file->blocks;
+
+        for (unsigned row = first; row < last; row++) {
+                unsigned char *top = image->pixels + 2 * row * image->stride;
+
+                encodeBlockRow(top, top + image->stride, file->blocks,
+                               comps);
+                Codeword_packBatch(comps, words + (size_t)(row - first) *
+                                   file->blocks, file->blocks, mode);
+        }
+        if (!compress40Options.entropy) {
+                Codewords_swap(words, (size_t)(last - first) * file->blocks);
+        }
+
+        FREE(comps);
+}
+
+/********** decodeRows ********
+ * 
+ * Decompresses block rows of a file's codewords into its pixels
+ *
+ * Parameters:
+ *      struct BatchFile *file: The file
+ *      unsigned first:         The first block row
+ *      unsigned last:          One past the last block row
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - in format 3 the rows are one chunk, decoded into file->words
+ *        first
+ *      
+ **********************************/
+static void decodeRows(struct BatchFile *file, unsigned first,
+                       unsigned last)
+{
+        PackedImage image = file->image;
+        size_t rowBytes = (size_t)file->blocks * 4;
+        uint32_t *words = ALLOC((file->blocks + 1) * sizeof(*words));
+
+        if (file->chunked != NULL) {
+                unsigned char *scratch = ALLOC(
+                        ChunkedReader_maxChunkBytes(file->chunked) + 1);
+                ChunkedReader_decodeChunk(file->chunked, 
+                                          first / file->rowsPerBand, scratch,
+                                          file->words + (size_t)first *
+                                          file->blocks);
+                FREE(scratch);
+        }
+
+        for (unsigned row = first; row < last; row++) {
+                unsigned char *top = image->pixels + 2 * row * image->stride;
+                const uint32_t *rowWords = words;
+
+                if (file->chunked != NULL) {
+                        rowWords = file->words + (size_t)row * file->blocks;
+                } else {
+                        Codewords_load(file->body + row * rowBytes,
+                                       file->blocks, words);
+                }
+                decodeBlockRow(rowWords, file->blocks, top,
+                               top + image->stride);
+        }
+
+        FREE(words);
+}
+
+/********** finishFile ********
+ * 
+ * Writes a file's output, reports its throughput and frees its buffers
+ *
+ * Parameters:
+ *      struct BatchFile *file: The file, with every band done
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - a file whose output cannot be created is reported and marked
+ *        as failed
+ *      
+ **********************************/
+static void finishFile(struct BatchFile *file)
+{
+        FILE *output = fopen(file->outPath, "wb");
+
+        if (output == NULL) {
+                fprintf(stderr, "%s: cannot create\n", file->outPath);
+                file->failed = 1;
+        } else if (file->compress && compress40Options.entropy) {
+                Chunked_write(output, file->words, file->width, 
+                              file->height, 1);
+                fclose(output);
+        } else if (file->compress) {
+                writeCompressedHeader(output, file->width, file->height);
+                fwrite(file->words, sizeof(uint32_t),
+                       (size_t)file->blocks * file->blockRows, output);
+                fclose(output);
+        } else {
+                PackedImage_write(output, file->image);
+                fclose(output);
+        }
+
+        if (!file->failed) {
+                double ms = elapsedMs(&file->start);
+                double megabytes = file->width * 3.0 * file->height / 1e6;
+                fprintf(stderr, "%s: %ux%u in %.3f ms, %.1f MB/s\n",
+                        file->path, file->width, file->height, ms,
+                        ms > 0 ? megabytes * 1000 / ms : 0);
+        }
+
+        PackedImage_free(&file->image);
+        if (file->words != NULL) {
+                FREE(file->words);
+        }
+        if (file->body != NULL) {
+                FREE(file->body);
+        }
+        if (file->bands != NULL) {
+                FREE(file->bands);
+        }
+        if (file->chunked != NULL) {
+                ChunkedReader_close(&file->chunked);
+                fclose(file->input);
+        }
+}
+
+/********** outputPath ********
+ * 
+ * Builds the path of a file's output
+ *
+ * Parameters:
+ *      const char *outDir:    The output directory
+ *      const char *path:      The input's path
+ *      const char *extension: What to put after the input's name
+ * 
+ * Return: outDir, a slash, the input's file name without its extension,
+ *         then extension, in new storage
+ *
+ * Notes:
+ *      - the caller frees the result with FREE
+ *      
+ **********************************/
+static char *outputPath(const char *outDir, const char *path,
+                        const char *extension)
+{
+        const char *name = strrchr(path, '/');
+        name = (name == NULL) ? path : name + 1;
+
+        const char *dot = strrchr(name, '.');
+        size_t length = (dot == NULL || dot == name) ? strlen(name)
+                                                     : (size_t)(dot - name);
+
+        size_t size = strlen(outDir) + 1 + length + strlen(extension) + 1;
+        char *out = ALLOC(size);
+        snprintf(out, size, "%s/%.*s%s", outDir, (int)length, name,
+                 extension);
+
+        return out;
+}
+
+/********** elapsedMs ********
+ * 
+ * Measures the time since a moment
+ *
+ * Parameters:
+ *      const struct timespec *start: The moment, from CLOCK_MONOTONIC
+ * 
+ * Return: the milliseconds since then
+ *
+ * Notes: none
+ *      
+ **********************************/
+static double elapsedMs(const struct timespec *start)
+{
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        return (now.tv_sec - start->tv_sec) * 1e3 +
+               (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+/********** openCompressed ********
+ * 
+ * Reads the header of a compressed image, without raising on a bad one
+ *
+ * Parameters:
+ *      FILE *input:             The stream, at its start
+ *      struct BatchFile *file:  Gets the image's width and height, and
+ *                               for format 3 its chunked reader
+ * 
+ * Return: 1 if the header was read, 0 if it is badly formatted, the
+ *         image has an odd side, or a format 3 index is bad or its file
+ *         too short
+ *
+ * Notes:
+ *      - reads what readCompressedHeader and ChunkedReader_open do
+ *      
+ **********************************/
+static int openCompressed(FILE *input, struct BatchFile *file)
+{
+        int format;
+        int read = fscanf(input, "COMP40 Compressed image format %d\n%u %u",
+                          &format, &file->width, &file->height);
+        if (read != 3 || (format != 2 && format != 3) ||
+            getc(input) != '\n' || file->width % 2 != 0 ||
+            file->height % 2 != 0) {
+                return 0;
+        }
+        if (format == 3) {
+                file->chunked = ChunkedReader_tryOpen(input, file->width,
+                                                      file->height);
+                return file->chunked != NULL;
+        }
+
+        return 1;
+}
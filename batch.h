@@ -0,0 +1,18 @@
+/**************************************************************
+ *
+ *                     batch.h
+ *
+ *     Assignment: arith
+ *     Authors: Anh Hoang, Emilio Aleman
+ *     Date:  3/8/2024
+ *
+ *    This file contains the declaration of batch mode, which compresses
+ *    or decompresses every file named in a list within one process.
+ *
+ **************************************************************/
+#ifndef BATCH_INCLUDED
+#define BATCH_INCLUDED
+
+unsigned Batch_run(const char *listPath, const char *outDir, int compress);
+
+#endif
@@ -0,0 +1,525 @@
+/**************************************************************
+ *
+ *                     bench.c
+ *
+ *     Assignment: arith
+ *     Authors:  Anh Hoang and Emilio Aleman
+ *     Date:     3/8/24
+ *
+ *     This file contains the benchmark run by "make bench". It makes a
+ *     corpus of synthetic images (noise, gradient, flat and photo-like) at
+ *     several sizes, times every stage of compression and decompression
+ *     on each one separately, and prints the results as JSON.
+ *
+ **************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <stdint.h>
+#include "assert.h"
+#include "mem.h"
+#include "helpers.h"
+#include "packedImage.h"
+#include "rgbConversion.h"
+#include "compVidConversion.h"
+#include "bitpackInline.h"
+#include "codewordIO.h"
+#include "encodeKernel.h"
+#include "decodeKernel.h"
+
+/*
+ * Everything one image's stages read and write. Each stage runs over the
+ * whole image, taking its input from the stage before, so the stages can
+ * be timed one at a time.
+ */
+struct Bench
+{
+        PackedImage image;
+        unsigned blocks, blockRows;
+        size_t count;                   /* blocks * blockRows */
+        char *ppm, *compressed;         /* the image as files, in memory */
+        size_t ppmSize, compressedSize;
+        char *out;                      /* where the write stages go */
+        size_t outSize;
+        struct CompVidQuad *cv;
+        struct Compressed *comps;
+        uint32_t *words;
+        PackedImage decoded;
+};
+
+typedef void Stage(struct Bench *bench);
+
+struct StageTime
+{
+        const char *name;
+        Stage *run;
+        Stage *reset;   /* undoes what run did to its input, or NULL */
+};
+
+static void makeImage(PackedImage image, const char *kind);
+static void setUp(struct Bench *bench, PackedImage image);
+static void tearDown(struct Bench *bench);
+static double bestOf(struct Bench *bench, const struct StageTime *stage,
+                     unsigned repeats);
+static void printStage(const struct Bench *bench, const char *name,
+                       double ns, int last);
+
+static void parsePpm(struct Bench *bench);
+static void rgbToCv(struct Bench *bench);
+static void dctQuantize(struct Bench *bench);
+static void packWords(struct Bench *bench);
+static void writeCompressed(struct Bench *bench);
+static void swapBack(struct Bench *bench);
+static void encodeFused(struct Bench *bench);
+static void readCompressed(struct Bench *bench);
+static void unpackWords(struct Bench *bench);
+static void dequantizeIdct(struct Bench *bench);
+static void cvToRgb(struct Bench *bench);
+static void writePpm(struct Bench *bench);
+static void decodeFused(struct Bench *bench);
+
+static const char *kinds[] = { "noise", "gradient", "flat", "photo" };
+static const unsigned sizes[][2] = { { 256, 256 }, { 1024, 768 },
+                                     { 2048, 1536 } };
+
+/*
+ * The stages in pipeline order. The staged ones are the portable scalar
+ * path; the fused ones are the kernels 40image runs, for comparison.
+ */
+static const struct StageTime stages[] = {
+        { "parse",           parsePpm,        NULL },
+        { "rgb_to_cv",       rgbToCv,         NULL },
+        { "dct_quantize",    dctQuantize,     NULL },
+        { "pack",            packWords,       NULL },
+        { "write",           writeCompressed, swapBack },
+        { "encode_fused",    encodeFused,     NULL },
+        { "read",            readCompressed,  NULL },
+        { "unpack",          unpackWords,     NULL },
+        { "dequantize_idct", dequantizeIdct,  NULL },
+        { "cv_to_rgb",       cvToRgb,         NULL },
+        { "write_ppm",       writePpm,        NULL },
+        { "decode_fused",    decodeFused,     NULL },
+};
+
+/* Parses a positive count such as the N in "-r N", or exits */
+static unsigned parseCount(const char *progname, const char *arg)
+{
+        char *end;
+        long count = strtol(arg, &end, 10);
+
+        if (*arg == '\0' || *end != '\0' || count < 1 || count > 1000) {
+                fprintf(stderr, "%s: bad count '%s'\n", progname, arg);
+                exit(1);
+        }
+        return count;
+}
+
+int main(int argc, char *argv[])
+{
+        unsigned repeats = 5;
+        int exact = 0;
+
+        for (int i = 1; i < argc; i++) {
+                if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+                        repeats = parseCount(argv[0], argv[++i]);
+                } else if (strcmp(argv[i], "--exact") == 0) {
+                        exact = 1;
+                } else {
+                        fprintf(stderr, "Usage: %s [-r repeats] [--exact]\n",
+                                argv[0]);
+                        exit(1);
+                }
+        }
+        encodeSetEngine(exact ? ENCODE_EXACT : ENCODE_FIXED);
+        decodeSetEngine(exact ? DECODE_EXACT : DECODE_TABLES);
+
+        unsigned nkinds = sizeof(kinds) / sizeof(kinds[0]);
+        unsigned nsizes = sizeof(sizes) / sizeof(sizes[0]);
+        unsigned nstages = sizeof(stages) / sizeof(stages[0]);
+
+        printf("{\n  \"engine\": \"%s\",\n  \"repeats\": %u,\n"
+               "  \"results\": [\n", exact ? "exact" : "fixed", repeats);
+        for (unsigned s = 0; s < nsizes; s++) {
+                for (unsigned k = 0; k < nkinds; k++) {
+                        struct Bench bench;
+                        PackedImage image = PackedImage_new(sizes[s][0],
+                                                            sizes[s][1]);
+                        makeImage(image, kinds[k]);
+                        setUp(&bench, image);
+
+                        printf("    { \"image\": \"%s\", \"width\": %u, "
+                               "\"height\": %u, \"blocks\": %zu,\n"
+                               "      \"stages\": {\n", kinds[k],
+                               sizes[s][0], sizes[s][1], bench.count);
+                        for (unsigned i = 0; i < nstages; i++) {
+                                double ns = bestOf(&bench, &stages[i],
+                                                   repeats);
+                                printStage(&bench, stages[i].name, ns,
+                                           i + 1 == nstages);
+                        }
+                        printf("      } }%s\n",
+                               s + 1 == nsizes && k + 1 == nkinds ? "" : ",");
+                        fflush(stdout);
+
+                        tearDown(&bench);
+                }
+        }
+        printf("  ]\n}\n");
+
+        return EXIT_SUCCESS;
+}
+
+/********** makeImage ********
+ * 
+ * Fills an image with one kind of synthetic content
+ *
+ * Parameters:
+ *      PackedImage image: The image to fill
+ *      const char *kind:  "noise" for uniform random bytes, "gradient" for
+ *                         smooth ramps in each channel, "flat" for one
+ *                         colour, or "photo" for smooth shapes with edges
+ *                         and a little grain
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - the same kind and size always give the same pixels
+ *      
+ **********************************/
+static void makeImage(PackedImage image, const char *kind)
+{
+        unsigned width = image->width, height = image->height;
+        uint32_t state = 2463534242u;
+
+        for (unsigned y = 0; y < height; y++) {
+                unsigned char *pixel = image->pixels + y * image->stride;
+
+                for (unsigned x = 0; x < width; x++, pixel += 3) {
+                        state ^= state << 13;
+                        state ^= state >> 17;
+                        state ^= state << 5;
+                        float u = (float)x / width, v = (float)y / height;
+                        float rgb[3];
+
+                        if (strcmp(kind, "noise") == 0) {
+                                rgb[0] = state & 0xff;
+                                rgb[1] = (state >> 8) & 0xff;
+                                rgb[2] = (state >> 16) & 0xff;
+                        } else if (strcmp(kind, "gradient") == 0) {
+                                rgb[0] = 255 * u;
+                                rgb[1] = 255 * v;
+                                rgb[2] = 255 * (1 - (u + v) / 2);
+                        } else if (strcmp(kind, "flat") == 0) {
+                                rgb[0] = 200;
+                                rgb[1] = 120;
+                                rgb[2] = 60;
+                        } else {
+                                float dx = u - 0.6f, dy = v - 0.4f;
+                                float shade = 0.5f + 0.25f * sinf(9 * u) *
+                                              cosf(7 * v);
+                                if (dx * dx + dy * dy < 0.04f) {
+                                        shade += 0.25f;
+                                }
+                                float grain = (int)(state & 0xf) - 8;
+                                rgb[0] = 255 * shade + grain;
+                                rgb[1] = 230 * shade * (1 - v / 2) + grain;
+                                rgb[2] = 180 * shade * (0.5f + u) + grain;
+                        }
+                        for (int c = 0; c < 3; c++) {
+                                float value = rgb[c] < 0 ? 0 : rgb[c];
+                                pixel[c] = value > 255 ? 255 : value;
+                        }
+                }
+        }
+}
+
+/********** setUp ********
+ * 
+ * Prepares the buffers for benchmarking one image and runs every stage
+ * once, so each has its input
+ *
+ * Parameters:
+ *      struct Bench *bench: The benchmark to set up
+ *      PackedImage image:   The image, which bench now owns
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if the image's width or height is odd
+ *      - the compressed file is the fused encoder's output, as 40image -c
+ *        would write it with --saturate
+ *      
+ **********************************/
+static void setUp(struct Bench *bench, PackedImage image)
+{
+        assert(image->width % 2 == 0 && image->height % 2 == 0);
+
+        bench->image = image;
+        bench->blocks = image->width / 2;
+        bench->blockRows = image->height / 2;
+        bench->count = (size_t)bench->blocks * bench->blockRows;
+        bench->cv = ALLOC(bench->count * sizeof(*bench->cv));
+        bench->comps = ALLOC(bench->count * sizeof(*bench->comps));
+        bench->words = ALLOC(bench->count * sizeof(*bench->words));
+        bench->decoded = PackedImage_new(image->width, image->height);
+
+        FILE *file = open_memstream(&bench->ppm, &bench->ppmSize);
+        assert(file != NULL);
+        PackedImage_write(file, image);
+        fclose(file);
+
+        encodeFused(bench);
+        file = open_memstream(&bench->compressed, &bench->compressedSize);
+        assert(file != NULL);
+        writeCompressedHeader(file, image->width, image->height);
+        Codewords_write(file, bench->words, bench->count);
+        fclose(file);
+        swapBack(bench);
+
+        bench->outSize = bench->ppmSize + bench->compressedSize;
+        bench->out = ALLOC(bench->outSize);
+        for (unsigned i = 0; i < sizeof(stages) / sizeof(stages[0]); i++) {
+                stages[i].run(bench);
+                if (stages[i].reset != NULL) {
+                        stages[i].reset(bench);
+                }
+        }
+}
+
+/********** tearDown ********
+ * 
+ * Frees everything setUp made
+ *
+ * Parameters:
+ *      struct Bench *bench: The benchmark
+ * 
+ * Return: none
+ *
+ * Notes: none
+ *      
+ **********************************/
+static void tearDown(struct Bench *bench)
+{
+        PackedImage_free(&bench->image);
+        PackedImage_free(&bench->decoded);
+        free(bench->ppm);               /* from open_memstream */
+        free(bench->compressed);
+        FREE(bench->out);
+        FREE(bench->cv);
+        FREE(bench->comps);
+        FREE(bench->words);
+}
+
+/********** bestOf ********
+ * 
+ * Times a stage over several runs
+ *
+ * Parameters:
+ *      struct Bench *bench:            The benchmark, set up
+ *      const struct StageTime *stage:  The stage
+ *      unsigned repeats:               How many runs to time
+ * 
+ * Return: the fastest run's time in nanoseconds
+ *
+ * Notes:
+ *      - the fastest run is the one least disturbed by the rest of the
+ *        machine, so it varies least between runs of the benchmark
+ *      
+ **********************************/
+static double bestOf(struct Bench *bench, const struct StageTime *stage,
+                     unsigned repeats)
+{
+        double best = INFINITY;
+
+        for (unsigned r = 0; r < repeats; r++) {
+                struct timespec start, end;
+
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                stage->run(bench);
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                if (stage->reset != NULL) {
+                        stage->reset(bench);
+                }
+
+                double ns = (end.tv_sec - start.tv_sec) * 1e9 +
+                            (end.tv_nsec - start.tv_nsec);
+                if (ns < best) {
+                        best = ns;
+                }
+        }
+
+        return best;
+}
+
+/********** printStage ********
+ * 
+ * Prints one stage's result as a JSON member
+ *
+ * Parameters:
+ *      const struct Bench *bench: The benchmark
+ *      const char *name:          The stage's name
+ *      double ns:                 Its time in nanoseconds
+ *      int last:                  Whether it is the image's last stage
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - MB/s counts the image's pixel bytes, width * height * 3, for
+ *        every stage, so the stages of one image compare directly
+ *      
+ **********************************/
+static void printStage(const struct Bench *bench, const char *name,
+                       double ns, int last)
+{
+        double bytes = bench->count * 12.0;
+
+        printf("        \"%s\": { \"ms\": %.3f, \"mb_per_s\": %.1f, "
+               "\"ns_per_block\": %.2f }%s\n", name, ns / 1e6,
+               ns > 0 ? bytes * 1e3 / ns : 0, ns / bench->count,
+               last ? "" : ",");
+}
+
+/*
+ * The stages. Each reads what the stage before it left in bench; the
+ * read and write stages use the files in memory so that the disk does not
+ * count.
+ */
+
+static void parsePpm(struct Bench *bench)
+{
+        FILE *input = fmemopen(bench->ppm, bench->ppmSize, "rb");
+        assert(input != NULL);
+
+        PackedImage image = PackedImage_read(input, 1);
+        fclose(input);
+        PackedImage_free(&image);
+}
+
+static void rgbToCv(struct Bench *bench)
+{
+        PackedImage image = bench->image;
+        struct rgbQuad quad;
+
+        for (unsigned row = 0; row < bench->blockRows; row++) {
+                unsigned char *top = image->pixels + 2 * row * image->stride;
+                struct CompVidQuad *cv = bench->cv +
+                                         (size_t)row * bench->blocks;
+
+                for (unsigned col = 0; col < bench->blocks; col++) {
+                        packedToRgbQuad(top + 6 * col,
+                                        top + image->stride + 6 * col, &quad);
+                        rgbQuadToCvQuad(&quad, &cv[col]);
+                }
+        }
+}
+
+static void dctQuantize(struct Bench *bench)
+{
+        for (size_t i = 0; i < bench->count; i++) {
+                bench->comps[i] = DCTval(&bench->cv[i]);
+        }
+}
+
+static void packWords(struct Bench *bench)
+{
+        Codeword_packBatch(bench->comps, bench->words, bench->count,
+                           BITPACK_SATURATE);
+}
+
+static void writeCompressed(struct Bench *bench)
+{
+        FILE *output = fmemopen(bench->out, bench->outSize, "wb");
+        assert(output != NULL);
+
+        writeCompressedHeader(output, bench->image->width,
+                              bench->image->height);
+        Codewords_write(output, bench->words, bench->count);
+        fclose(output);
+}
+
+/* Codewords_write leaves the words in file order; puts them back */
+static void swapBack(struct Bench *bench)
+{
+        Codewords_swap(bench->words, bench->count);
+}
+
+static void encodeFused(struct Bench *bench)
+{
+        PackedImage image = bench->image;
+
+        for (unsigned row = 0; row < bench->blockRows; row++) {
+                unsigned char *top = image->pixels + 2 * row * image->stride;
+                size_t first = (size_t)row * bench->blocks;
+
+                encodeBlockRow(top, top + image->stride, bench->blocks,
+                               bench->comps + first);
+                Codeword_packBatch(bench->comps + first, bench->words + first,
+                                   bench->blocks, BITPACK_SATURATE);
+        }
+}
+
+static void readCompressed(struct Bench *bench)
+{
+        FILE *input = fmemopen(bench->compressed, bench->compressedSize,
+                               "rb");
+        assert(input != NULL);
+        unsigned width, height;
+
+        readCompressedHeader(input, &width, &height);
+        Codewords_read(input, bench->words, bench->count);
+        fclose(input);
+}
+
+static void unpackWords(struct Bench *bench)
+{
+        Codeword_unpackBatch(bench->words, bench->comps, bench->count);
+}
+
+static void dequantizeIdct(struct Bench *bench)
+{
+        for (size_t i = 0; i < bench->count; i++) {
+                CompressedToCvQuad(bench->comps[i], &bench->cv[i]);
+        }
+}
+
+static void cvToRgb(struct Bench *bench)
+{
+        PackedImage image = bench->decoded;
+        struct rgbQuad quad;
+
+        for (unsigned row = 0; row < bench->blockRows; row++) {
+                unsigned char *top = image->pixels + 2 * row * image->stride;
+                struct CompVidQuad *cv = bench->cv +
+                                         (size_t)row * bench->blocks;
+
+                for (unsigned col = 0; col < bench->blocks; col++) {
+                        CvQuadToRgbQuad(&cv[col], &quad);
+                        rgbQuadToPacked(&quad, top + 6 * col,
+                                        top + image->stride + 6 * col);
+                }
+        }
+}
+
+static void writePpm(struct Bench *bench)
+{
+        FILE *output = fmemopen(bench->out, bench->outSize, "wb");
+        assert(output != NULL);
+
+        PackedImage_write(output, bench->decoded);
+        fclose(output);
+}
+
+static void decodeFused(struct Bench *bench)
+{
+        PackedImage image = bench->decoded;
+
+        for (unsigned row = 0; row < bench->blockRows; row++) {
+                unsigned char *top = image->pixels + 2 * row * image->stride;
+
+                decodeBlockRow(bench->words + (size_t)row * bench->blocks,
+                               bench->blocks, top, top + image->stride);
+        }
+}
@@ -0,0 +1,215 @@
+/**************************************************************
+ *
+ *                     bitpackInline.h
+ *
+ *     Assignment: arith
+ *     Authors: Anh Hoang, Emilio Aleman
+ *     Date:  3/8/2024
+ *
+ *    This file contains a header-only version of Bitpack for 32-bit 
+ *    codewords, the codeword field layout, and batch functions that pack
+ *    and unpack whole arrays of Compressed values. Unlike bitpack.c,
+ *    nothing here asserts or raises per field: widths and lsbs are
+ *    compile-time constants, and overflow is either checked once per
+ *    batch or saturated away.
+ *
+ **************************************************************/
+#ifndef BITPACKINLINE_INCLUDED
+#define BITPACKINLINE_INCLUDED
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "except.h"
+#include "bitpack.h"
+#include "helpers.h"
+
+/* Where each field of a Compressed value lives in a codeword */
+enum {
+        CODEWORD_A_WIDTH = 6,  CODEWORD_A_LSB = 26,
+        CODEWORD_B_WIDTH = 6,  CODEWORD_B_LSB = 20,
+        CODEWORD_C_WIDTH = 6,  CODEWORD_C_LSB = 14,
+        CODEWORD_D_WIDTH = 6,  CODEWORD_D_LSB = 8,
+        CODEWORD_PB_WIDTH = 4, CODEWORD_PB_LSB = 4,
+        CODEWORD_PR_WIDTH = 4, CODEWORD_PR_LSB = 0
+};
+
+/* 
+ * What a batch does with a field that does not fit: BITPACK_CHECKED
+ * raises Bitpack_Overflow once the batch is packed, BITPACK_SATURATE
+ * clamps the field to the nearest value that fits.
+ */
+typedef enum { BITPACK_CHECKED, BITPACK_SATURATE } Bitpack_mode;
+
+/* Field access for widths 1 to 31; fields must lie inside the word */
+static inline uint32_t Bitpack_mask32(unsigned width)
+{
+        return (UINT32_C(1) << width) - 1;
+}
+
+static inline uint32_t Bitpack_putu32(uint32_t value, unsigned width, 
+                                      unsigned lsb)
+{
+        return (value & Bitpack_mask32(width)) << lsb;
+}
+
+static inline uint32_t Bitpack_puts32(int32_t value, unsigned width, 
+                                      unsigned lsb)
+{
+        return ((uint32_t)value & Bitpack_mask32(width)) << lsb;
+}
+
+static inline uint32_t Bitpack_getu32(uint32_t word, unsigned width, 
+                                      unsigned lsb)
+{
+        return (word >> lsb) & Bitpack_mask32(width);
+}
+
+static inline int32_t Bitpack_gets32(uint32_t word, unsigned width, 
+                                     unsigned lsb)
+{
+        return (int32_t)(word << (32 - width - lsb)) >> (32 - width);
+}
+
+/* Nonzero when value does not fit in width bits */
+static inline uint32_t Bitpack_overu32(uint32_t value, unsigned width)
+{
+        return value >> width;
+}
+
+static inline uint32_t Bitpack_overs32(int32_t value, unsigned width)
+{
+        return ((uint32_t)value + (UINT32_C(1) << (width - 1))) >> width;
+}
+
+/* The nearest value that fits in width bits */
+static inline uint32_t Bitpack_clampu32(uint32_t value, unsigned width)
+{
+        uint32_t max = Bitpack_mask32(width);
+        return value > max ? max : value;
+}
+
+static inline int32_t Bitpack_clamps32(int32_t value, unsigned width)
+{
+        int32_t max = (int32_t)Bitpack_mask32(width - 1);
+        int32_t min = -max - 1;
+        return value > max ? max : (value < min ? min : value);
+}
+
+/* Packs one Compressed value; fields that do not fit are truncated */
+static inline uint32_t Codeword_pack(struct Compressed comp)
+{
+        return Bitpack_putu32(comp.a, CODEWORD_A_WIDTH, CODEWORD_A_LSB) |
+               Bitpack_puts32(comp.b, CODEWORD_B_WIDTH, CODEWORD_B_LSB) |
+               Bitpack_puts32(comp.c, CODEWORD_C_WIDTH, CODEWORD_C_LSB) |
+               Bitpack_puts32(comp.d, CODEWORD_D_WIDTH, CODEWORD_D_LSB) |
+               Bitpack_putu32(comp.pb_avg, CODEWORD_PB_WIDTH, 
+                              CODEWORD_PB_LSB) |
+               Bitpack_putu32(comp.pr_avg, CODEWORD_PR_WIDTH, 
+                              CODEWORD_PR_LSB);
+}
+
+/* Unpacks one codeword */
+static inline struct Compressed Codeword_unpack(uint32_t word)
+{
+        struct Compressed comp;
+
+        comp.a = Bitpack_getu32(word, CODEWORD_A_WIDTH, CODEWORD_A_LSB);
+        comp.b = Bitpack_gets32(word, CODEWORD_B_WIDTH, CODEWORD_B_LSB);
+        comp.c = Bitpack_gets32(word, CODEWORD_C_WIDTH, CODEWORD_C_LSB);
+        comp.d = Bitpack_gets32(word, CODEWORD_D_WIDTH, CODEWORD_D_LSB);
+        comp.pb_avg = Bitpack_getu32(word, CODEWORD_PB_WIDTH, 
+                                     CODEWORD_PB_LSB);
+        comp.pr_avg = Bitpack_getu32(word, CODEWORD_PR_WIDTH, 
+                                     CODEWORD_PR_LSB);
+
+        return comp;
+}
+
+/* Nonzero when some field of comp does not fit in the layout */
+static inline uint32_t Codeword_overflow(struct Compressed comp)
+{
+        return Bitpack_overu32(comp.a, CODEWORD_A_WIDTH) |
+               Bitpack_overs32(comp.b, CODEWORD_B_WIDTH) |
+               Bitpack_overs32(comp.c, CODEWORD_C_WIDTH) |
+               Bitpack_overs32(comp.d, CODEWORD_D_WIDTH) |
+               Bitpack_overu32(comp.pb_avg, CODEWORD_PB_WIDTH) |
+               Bitpack_overu32(comp.pr_avg, CODEWORD_PR_WIDTH);
+}
+
+/* comp with every field clamped to the layout */
+static inline struct Compressed Codeword_saturate(struct Compressed comp)
+{
+        comp.a = Bitpack_clampu32(comp.a, CODEWORD_A_WIDTH);
+        comp.b = Bitpack_clamps32(comp.b, CODEWORD_B_WIDTH);
+        comp.c = Bitpack_clamps32(comp.c, CODEWORD_C_WIDTH);
+        comp.d = Bitpack_clamps32(comp.d, CODEWORD_D_WIDTH);
+        comp.pb_avg = Bitpack_clampu32(comp.pb_avg, CODEWORD_PB_WIDTH);
+        comp.pr_avg = Bitpack_clampu32(comp.pr_avg, CODEWORD_PR_WIDTH);
+
+        return comp;
+}
+
+/********** Codeword_packBatch ********
+ * 
+ * Packs an array of Compressed values into codewords
+ *
+ * Parameters:
+ *      const struct Compressed *comps: The values to pack
+ *      uint32_t *words:                One codeword per value, in host
+ *                                      order
+ *      size_t count:                   How many values there are
+ *      Bitpack_mode mode:              What to do with fields that do 
+ *                                      not fit
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - in BITPACK_CHECKED mode, raises Bitpack_Overflow after the 
+ *        whole batch is packed if any field did not fit
+ *      
+ **********************************/
+static inline void Codeword_packBatch(const struct Compressed *comps, 
+                                      uint32_t *words, size_t count,
+                                      Bitpack_mode mode)
+{
+        if (mode == BITPACK_SATURATE) {
+                for (size_t i = 0; i < count; i++) {
+                        words[i] = Codeword_pack(Codeword_saturate(comps[i]));
+                }
+                return;
+        }
+
+        uint32_t over = 0;
+        for (size_t i = 0; i < count; i++) {
+                over |= Codeword_overflow(comps[i]);
+                words[i] = Codeword_pack(comps[i]);
+        }
+        if (over != 0) {
+                RAISE(Bitpack_Overflow);
+        }
+}
+
+/********** Codeword_unpackBatch ********
+ * 
+ * Unpacks an array of codewords into Compressed values
+ *
+ * Parameters:
+ *      const uint32_t *words:    The codewords, in host order
+ *      struct Compressed *comps: One value per codeword
+ *      size_t count:             How many codewords there are
+ * 
+ * Return: none
+ *
+ * Notes: every codeword unpacks, so nothing is checked
+ *      
+ **********************************/
+static inline void Codeword_unpackBatch(const uint32_t *words, 
+                                        struct Compressed *comps, 
+                                        size_t count)
+{
+        for (size_t i = 0; i < count; i++) {
+                comps[i] = Codeword_unpack(words[i]);
+        }
+}
+
+#endif
@@ -2,12 +2,26 @@
 #include <stdlib.h>
 #include <assert.h>
 #include "bitpack.h"
+#include "bitpackInline.h"
 
 void print_binary(uint64_t n);
 void print_binary_signed(int64_t n);
+int test_codeword_pack(void);
+int test_codeword_saturate(void);
+int test_codeword_batch(void);
 
 int main()
 {
+    /* Run first, since the Bitpack_news example below raises */
+    printf("/////// TEST CODEWORDS ///////\n");
+    int failed = test_codeword_pack() + test_codeword_saturate() +
+                 test_codeword_batch();
+    printf("codeword tests failed: %d\n", failed);
+    fflush(stdout);
+    if (failed != 0) {
+        return failed;
+    }
+
     int64_t n = -23;
     int64_t shiftu = n >> 4;
     // print_binary(n);
@@ -52,3 +66,106 @@ int main()
 
     return 0;
 }
+
+/* Every combination of the smallest, largest and near-zero values of
+ * each field, packed by bitpackInline.h and by Bitpack_newu/news */
+int test_codeword_pack(void)
+{
+    unsigned us6[] = { 0, 1, 62, 63 };
+    signed ss6[] = { -32, -31, -1, 0, 1, 31 };
+    unsigned us4[] = { 0, 1, 14, 15 };
+    int wrong = 0;
+
+    for (int a = 0; a < 4; a++)
+    for (int b = 0; b < 6; b++)
+    for (int c = 0; c < 6; c++)
+    for (int d = 0; d < 6; d++)
+    for (int pb = 0; pb < 4; pb++)
+    for (int pr = 0; pr < 4; pr++) {
+        struct Compressed comp = { us4[pb], us4[pr], us6[a],
+                                   ss6[b], ss6[c], ss6[d] };
+        uint64_t word = 0;
+        word = Bitpack_newu(word, 6, 26, comp.a);
+        word = Bitpack_news(word, 6, 20, comp.b);
+        word = Bitpack_news(word, 6, 14, comp.c);
+        word = Bitpack_news(word, 6, 8, comp.d);
+        word = Bitpack_newu(word, 4, 4, comp.pb_avg);
+        word = Bitpack_newu(word, 4, 0, comp.pr_avg);
+
+        struct Compressed back = Codeword_unpack((uint32_t)word);
+        if (Codeword_pack(comp) != word || Codeword_overflow(comp) != 0 ||
+            back.a != comp.a || back.b != comp.b || back.c != comp.c ||
+            back.d != comp.d || back.pb_avg != comp.pb_avg ||
+            back.pr_avg != comp.pr_avg) {
+            wrong++;
+        }
+    }
+
+    printf("pack/unpack: %s\n", wrong == 0 ? "pass" : "FAIL");
+    return wrong != 0;
+}
+
+/* Fields just out of range clamp to the nearest end, and fields in
+ * range are left alone */
+int test_codeword_saturate(void)
+{
+    struct Compressed over = { 16, 1000, 64, -33, 32, 1000 };
+    struct Compressed fits = { 15, 0, 63, -32, 31, 0 };
+    struct Compressed top = Codeword_saturate(over);
+    struct Compressed same = Codeword_saturate(fits);
+    int wrong = 0;
+
+    wrong += top.pb_avg != 15 || top.pr_avg != 15 || top.a != 63;
+    wrong += top.b != -32 || top.c != 31 || top.d != 31;
+    wrong += Codeword_overflow(over) == 0 || Codeword_overflow(top) != 0;
+    wrong += Codeword_pack(same) != Codeword_pack(fits);
+
+    over.b = -1000;
+    wrong += Codeword_saturate(over).b != -32;
+
+    printf("saturate: %s\n", wrong == 0 ? "pass" : "FAIL");
+    return wrong != 0;
+}
+
+/* A batch with one field out of range raises in BITPACK_CHECKED mode
+ * and clamps in BITPACK_SATURATE mode */
+int test_codeword_batch(void)
+{
+    struct Compressed comps[3] = { { 1, 2, 3, -4, 5, -6 },
+                                   { 1, 2, 3, -4, 40, -6 },
+                                   { 15, 15, 63, 31, -32, 0 } };
+    uint32_t words[3];
+    volatile int raised = 0;
+    int wrong = 0;
+
+    TRY
+        Codeword_packBatch(comps, words, 3, BITPACK_CHECKED);
+    EXCEPT(Bitpack_Overflow)
+        raised = 1;
+    END_TRY;
+    wrong += !raised;
+    wrong += words[2] != Codeword_pack(comps[2]);
+
+    raised = 0;
+    TRY
+        Codeword_packBatch(comps, words, 3, BITPACK_SATURATE);
+    EXCEPT(Bitpack_Overflow)
+        raised = 1;
+    END_TRY;
+    wrong += raised;
+    for (int i = 0; i < 3; i++) {
+        wrong += words[i] != Codeword_pack(Codeword_saturate(comps[i]));
+    }
+    wrong += Codeword_unpack(words[1]).c != 31;
+
+    raised = 0;
+    TRY
+        Codeword_packBatch(comps + 2, words, 1, BITPACK_CHECKED);
+    EXCEPT(Bitpack_Overflow)
+        raised = 1;
+    END_TRY;
+    wrong += raised || words[0] != Codeword_pack(comps[2]);
+
+    printf("packBatch: %s\n", wrong == 0 ? "pass" : "FAIL");
+    return wrong != 0;
+}
@@ -0,0 +1,180 @@
+/**************************************************************
+ *
+ *                     chromaIndex.c
+ *
+ *     Assignment: arith
+ *     Authors: Anh Hoang, Emilio Aleman
+ *     Date:  3/8/2024
+ *
+ *    This file contains the implementation of the constant-time chroma
+ *    quantizer. Arith40_index_of_chroma picks the nearest of 16 sorted
+ *    levels, so its index never decreases as the value grows. For each
+ *    index k from 1 to 15 the least float whose index is at least k is
+ *    found once, by bisecting over the floats in order, and the index of
+ *    any value is then the number of thresholds it reaches. This gives
+ *    the library's answer for every float in [-1, 1], which holds any Pb
+ *    or Pr of an 8-bit pixel, without searching the levels.
+ *
+ **************************************************************/
+#include <math.h>
+#include <string.h>
+#include <pthread.h>
+#include "assert.h"
+#include "arith40.h"
+#include "chromaIndex.h"
+
+static void buildThresholds(void);
+
+static float thresholds[CHROMA_THRESHOLDS];
+static pthread_once_t buildOnce = PTHREAD_ONCE_INIT;
+
+/********** ChromaIndex_of ********
+ * 
+ * Quantizes a chroma value to a 4-bit index
+ *
+ * Parameters:
+ *      float value: The Pb or Pr value
+ * 
+ * Return: the index Arith40_index_of_chroma gives the value
+ *
+ * Notes:
+ *      - values below -1 give 0 and values above 1 give the index of 1
+ *      - the thresholds are found on the first call
+ *      - safe to call from several threads at once
+ *      
+ **********************************/
+unsigned ChromaIndex_of(float value)
+{
+        pthread_once(&buildOnce, buildThresholds);
+
+        unsigned index = 0;
+        for (unsigned k = 0; k < CHROMA_THRESHOLDS; k++) {
+                index += value >= thresholds[k];
+        }
+
+        return index;
+}
+
+/********** ChromaIndex_thresholds ********
+ * 
+ * Gives the thresholds, for callers that count them several values at a
+ * time
+ *
+ * Parameters: none
+ * 
+ * Return: an array of CHROMA_THRESHOLDS floats, where element k - 1 is
+ *         the least value whose index is at least k
+ *
+ * Notes:
+ *      - the array must not be changed
+ *      
+ **********************************/
+const float *ChromaIndex_thresholds(void)
+{
+        pthread_once(&buildOnce, buildThresholds);
+        return thresholds;
+}
+
+/********** ChromaIndex_fixedThresholds ********
+ * 
+ * Finds thresholds for chroma values held as fixed-point integers
+ *
+ * Parameters:
+ *      float scale:          The value of one unit; an integer s stands
+ *                            for (float)s * scale
+ *      int32_t fixed[]:      Set so that element k - 1 is the least s
+ *                            whose value's index is at least k
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if fixed is NULL
+ *      - counting the thresholds an integer reaches gives the same index
+ *        as ChromaIndex_of((float)s * scale)
+ *      
+ **********************************/
+void ChromaIndex_fixedThresholds(float scale,
+                                 int32_t fixed[CHROMA_THRESHOLDS])
+{
+        assert(fixed != NULL);
+
+        for (unsigned k = 1; k <= CHROMA_THRESHOLDS; k++) {
+                int64_t lo = INT32_MIN, hi = INT32_MAX;
+
+                while (lo < hi) {
+                        int64_t mid = lo + (hi - lo) / 2;
+                        if (ChromaIndex_of((float)mid * scale) >= k) {
+                                hi = mid;
+                        } else {
+                                lo = mid + 1;
+                        }
+                }
+                fixed[k - 1] = lo;
+        }
+}
+
+/********** keyOfFloat / floatOfKey ********
+ * 
+ * Map floats to integers in the same order, and back
+ *
+ * Parameters:
+ *      float value: A float that is not a NaN
+ *      int64_t key: A key from keyOfFloat
+ * 
+ * Return: the key, or the float
+ *
+ * Notes:
+ *      - both zeros have key 0, which maps back to +0
+ *      
+ **********************************/
+static int64_t keyOfFloat(float value)
+{
+        int32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+
+        return bits < 0 ? (int64_t)INT32_MIN - bits : bits;
+}
+
+static float floatOfKey(int64_t key)
+{
+        int32_t bits = key < 0 ? (int64_t)INT32_MIN - key : key;
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+
+        return value;
+}
+
+/********** buildThresholds ********
+ * 
+ * Finds the least float in [-1, 1] reaching each index by bisection
+ *
+ * Parameters: none
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - runs once, through pthread_once
+ *      - an index that 1 does not reach gets a threshold of infinity
+ *      
+ **********************************/
+static void buildThresholds(void)
+{
+        for (unsigned k = 1; k <= CHROMA_THRESHOLDS; k++) {
+                int64_t lo = keyOfFloat(-1.0f);
+                int64_t hi = keyOfFloat(1.0f);
+
+                while (lo < hi) {
+                        int64_t mid = lo + (hi - lo) / 2;
+                        if (Arith40_index_of_chroma(floatOfKey(mid)) >= k) {
+                                hi = mid;
+                        } else {
+                                lo = mid + 1;
+                        }
+                }
+                thresholds[k - 1] = floatOfKey(lo);
+
+                if (Arith40_index_of_chroma(thresholds[k - 1]) < k) {
+                        thresholds[k - 1] = INFINITY;
+                }
+        }
+}
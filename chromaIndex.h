@@ -0,0 +1,27 @@
+/**************************************************************
+ *
+ *                     chromaIndex.h
+ *
+ *     Assignment: arith
+ *     Authors: Anh Hoang, Emilio Aleman
+ *     Date:  3/8/2024
+ *
+ *    This file contains the declaration of a constant-time chroma
+ *    quantizer that gives the same 4-bit index as Arith40_index_of_chroma
+ *    by counting how many of 15 thresholds a value reaches.
+ *
+ **************************************************************/
+#ifndef CHROMAINDEX_INCLUDED
+#define CHROMAINDEX_INCLUDED
+
+#include <stdint.h>
+
+/* One threshold between each pair of neighbouring indices */
+#define CHROMA_THRESHOLDS 15
+
+unsigned ChromaIndex_of(float value);
+const float *ChromaIndex_thresholds(void);
+void ChromaIndex_fixedThresholds(float scale,
+                                 int32_t fixed[CHROMA_THRESHOLDS]);
+
+#endif
@@ -0,0 +1,969 @@
+/**************************************************************
+ *
+ *                     chunked.c
+ *
+ *     Assignment: arith
+ *     Authors: Anh Hoang, Emilio Aleman
+ *     Date:  3/8/2024
+ *
+ *    This file contains the implementation of compressed image format 3.
+ *    A block is coded as six symbols, one per codeword field: a as its
+ *    difference (mod 64) from the a of the block to its left, since
+ *    neighbouring blocks are usually about as bright, and b, c, d, pb and
+ *    pr as they are. Each field has a canonical Huffman code of at most
+ *    MAX_BITS bits built from the chunk's own symbol counts. A chunk is
+ *    the six tables of code lengths, four bits per symbol, followed by
+ *    the codes of its blocks in order, packed least significant bit
+ *    first. Flat areas, where b, c and d are zero and a, pb and pr rarely
+ *    change, come down to about a bit per field.
+ *
+ **************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "assert.h"
+#include "mem.h"
+#include "bitpackInline.h"
+#include "threadPool.h"
+#include "stats.h"
+#include "mappedFile.h"
+#include "chunked.h"
+
+/* The writer makes chunks of whole block rows of about this many blocks */
+#define CHUNK_BLOCKS 16384
+
+/* The longest code, so a decoding table has 1 << MAX_BITS entries */
+#define MAX_BITS 12
+
+/* Fields per codeword, and the most symbols any field has */
+#define FIELDS 6
+#define MAX_SYMBOLS 64
+
+static const unsigned fieldWidths[FIELDS] = {
+        CODEWORD_A_WIDTH, CODEWORD_B_WIDTH, CODEWORD_C_WIDTH,
+        CODEWORD_D_WIDTH, CODEWORD_PB_WIDTH, CODEWORD_PR_WIDTH
+};
+static const unsigned fieldLsbs[FIELDS] = {
+        CODEWORD_A_LSB, CODEWORD_B_LSB, CODEWORD_C_LSB,
+        CODEWORD_D_LSB, CODEWORD_PB_LSB, CODEWORD_PR_LSB
+};
+
+/* Bytes of code lengths at the start of every chunk */
+#define TABLE_BYTES ((4 * 64 + 2 * 16) / 2)
+
+struct ChunkedReader
+{
+        FILE *input;
+        off_t base;             /* where chunk data starts, or -1 */
+        unsigned blocks, blockRows, rowsPerChunk, chunks;
+        uint64_t *offsets;      /* chunks + 1 of them */
+        unsigned char *body;    /* every chunk, once loaded or mapped */
+        MappedFile mapped;      /* the file, when it could be mapped */
+        uint64_t position;      /* how far a stream has been read */
+        unsigned char *bytes;   /* one chunk, for reading in order */
+        uint32_t *rows;         /* its decoded rows */
+        unsigned chunk;         /* which chunk rows holds, or chunks */
+        unsigned row;           /* the row ChunkedReader_nextRow gives */
+};
+
+/* A compression, one task per chunk */
+struct EncodeChunks
+{
+        const uint32_t *words;
+        unsigned blocks, blockRows, rowsPerChunk;
+        unsigned char **chunks;
+        size_t *sizes;
+};
+
+static void encodeChunkTask(unsigned chunk, unsigned worker, void *cl);
+static size_t encodeChunk(const uint32_t *words, unsigned blocks,
+                          unsigned rows, unsigned char *out);
+static void decodeChunk(const unsigned char *bytes, size_t size,
+                        unsigned blocks, unsigned rows, uint32_t *words);
+static void codeLengths(const uint32_t *counts, unsigned symbols,
+                        uint8_t *lengths);
+static void canonicalCodes(const uint8_t *lengths, unsigned symbols,
+                           uint16_t *codes);
+static void buildTable(const uint8_t *lengths, unsigned symbols,
+                       uint16_t *table);
+static const unsigned char *chunkBytes(ChunkedReader reader,
+                                       unsigned chunk,
+                                       unsigned char *scratch);
+static unsigned chunkRows(ChunkedReader reader, unsigned chunk);
+static int readIndex(ChunkedReader reader);
+
+/********** Chunked_write ********
+ * 
+ * Writes an image's codewords in format 3, header and index included
+ *
+ * Parameters:
+ *      FILE *output:          The stream to write to
+ *      const uint32_t *words: The codewords, in host order, row by row
+ *      unsigned width:        The (even) width of the image
+ *      unsigned height:       The (even) height of the image
+ *      unsigned threads:      How many threads may code chunks
+ * 
+ * Return: the number of bytes written
+ *
+ * Notes:
+ *      - CRE if output or words is NULL
+ *      - the output does not depend on threads
+ *      
+ **********************************/
+size_t Chunked_write(FILE *output, const uint32_t *words, unsigned width,
+                     unsigned height, unsigned threads)
+{
+        assert(output != NULL && words != NULL);
+
+        struct EncodeChunks job;
+        job.words = words;
+        job.blocks = width / 2;
+        job.blockRows = height / 2;
+        job.rowsPerChunk = job.blocks > 0 && job.blocks < CHUNK_BLOCKS
+                           ? CHUNK_BLOCKS / job.blocks : 1;
+
+        unsigned chunks = job.blocks == 0 ? 0 : (job.blockRows +
+                          job.rowsPerChunk - 1) / job.rowsPerChunk;
+        job.chunks = ALLOC((chunks + 1) * sizeof(*job.chunks));
+        job.sizes = ALLOC((chunks + 1) * sizeof(*job.sizes));
+        ThreadPool_run(threads, chunks, encodeChunkTask, &job);
+
+        struct Stats_timer timer;
+        Stats_start(&timer);
+        int header = fprintf(output, "COMP40 Compressed image format 3\n"
+                             "%u %u\n%u %u\n", width, height,
+                             job.rowsPerChunk, chunks);
+        assert(header > 0);
+        size_t total = header + (size_t)(chunks + 1) * 8;
+
+        uint64_t offset = 0;
+        for (unsigned i = 0; i <= chunks; i++) {
+                for (int shift = 56; shift >= 0; shift -= 8) {
+                        putc((offset >> shift) & 0xff, output);
+                }
+                if (i < chunks) {
+                        offset += job.sizes[i];
+                }
+        }
+        for (unsigned i = 0; i < chunks; i++) {
+                fwrite(job.chunks[i], 1, job.sizes[i], output);
+                FREE(job.chunks[i]);
+        }
+        Stats_stop(STATS_WRITE, &timer);
+
+        FREE(job.chunks);
+        FREE(job.sizes);
+        return total + offset;
+}
+
+/********** ChunkedReader_open ********
+ * 
+ * Reads the rest of a format 3 header and the chunk index
+ *
+ * Parameters:
+ *      FILE *input:     The stream, positioned after the width and height
+ *      unsigned width:  The width of the image
+ *      unsigned height: The height of the image
+ * 
+ * Return: a reader for the image's chunks
+ *
+ * Notes:
+ *      - CRE if the header or index is badly formatted or cut short, or
+ *        a regular file is too short for its chunks
+ *      - see ChunkedReader_tryOpen
+ *      
+ **********************************/
+ChunkedReader ChunkedReader_open(FILE *input, unsigned width,
+                                 unsigned height)
+{
+        ChunkedReader reader = ChunkedReader_tryOpen(input, width, height);
+        assert(reader != NULL);
+
+        return reader;
+}
+
+/********** ChunkedReader_tryOpen ********
+ * 
+ * Reads the rest of a format 3 header and the chunk index, without
+ * raising on a bad input
+ *
+ * Parameters: see ChunkedReader_open
+ * 
+ * Return: a reader for the image's chunks, or NULL if the header or
+ *         index is badly formatted or cut short, or a regular file is
+ *         too short for its chunks
+ *
+ * Notes:
+ *      - CRE if input is NULL
+ *      - a regular file is mapped, or failing that read with pread, so
+ *        any chunk can be read at any time; any other stream is read in
+ *        order
+ *      - the reader must be closed with ChunkedReader_close
+ *      
+ **********************************/
+ChunkedReader ChunkedReader_tryOpen(FILE *input, unsigned width,
+                                    unsigned height)
+{
+        assert(input != NULL);
+
+        ChunkedReader reader;
+        NEW(reader);
+        reader->input = input;
+        reader->blocks = width / 2;
+        reader->blockRows = height / 2;
+        reader->offsets = NULL;
+        if (!readIndex(reader)) {
+                FREE(reader->offsets);
+                FREE(reader);
+                return NULL;
+        }
+        unsigned chunks = reader->chunks;
+
+        struct stat info;
+        reader->base = -1;
+        if (fstat(fileno(input), &info) == 0 && S_ISREG(info.st_mode)) {
+                reader->base = ftell(input);
+                assert(reader->base >= 0);
+                if ((uint64_t)reader->base + reader->offsets[chunks] >
+                    (uint64_t)info.st_size) {
+                        FREE(reader->offsets);
+                        FREE(reader);
+                        return NULL;
+                }
+        }
+
+        reader->body = NULL;
+        reader->mapped = reader->base >= 0 ? MappedFile_input(input) : NULL;
+        if (reader->mapped != NULL) {
+                uint64_t size = reader->offsets[chunks];
+                assert(reader->base + size <= reader->mapped->size);
+                reader->body = reader->mapped->bytes + reader->base;
+        }
+        reader->position = 0;
+        reader->bytes = ALLOC(ChunkedReader_maxChunkBytes(reader) + 1);
+        reader->rows = ALLOC((size_t)reader->rowsPerChunk *
+                             reader->blocks * sizeof(uint32_t) + 1);
+        reader->chunk = chunks;
+        reader->row = 0;
+
+        return reader;
+}
+
+/********** ChunkedReader_close ********
+ * 
+ * Frees a reader; the stream stays open
+ *
+ * Parameters:
+ *      ChunkedReader *reader: Pointer to the reader
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if reader or *reader is NULL; *reader is set to NULL
+ *      
+ **********************************/
+void ChunkedReader_close(ChunkedReader *reader)
+{
+        assert(reader != NULL && *reader != NULL);
+
+        if ((*reader)->mapped != NULL) {
+                MappedFile_close(&(*reader)->mapped);
+        } else if ((*reader)->body != NULL) {
+                FREE((*reader)->body);
+        }
+        FREE((*reader)->bytes);
+        FREE((*reader)->rows);
+        FREE((*reader)->offsets);
+        FREE(*reader);
+}
+
+/********** ChunkedReader_chunks / _rowsPerChunk / _maxChunkBytes ********
+ * 
+ * Describe the chunks of an image
+ *
+ * Parameters:
+ *      ChunkedReader reader: The reader
+ * 
+ * Return: the number of chunks, the block rows in every chunk but
+ *         perhaps the last, and the size of the largest chunk in bytes
+ *
+ * Notes:
+ *      - CRE if reader is NULL
+ *      
+ **********************************/
+unsigned ChunkedReader_chunks(ChunkedReader reader)
+{
+        assert(reader != NULL);
+        return reader->chunks;
+}
+
+unsigned ChunkedReader_rowsPerChunk(ChunkedReader reader)
+{
+        assert(reader != NULL);
+        return reader->rowsPerChunk;
+}
+
+size_t ChunkedReader_maxChunkBytes(ChunkedReader reader)
+{
+        assert(reader != NULL);
+        uint64_t largest = 0;
+
+        for (unsigned i = 0; i < reader->chunks; i++) {
+                uint64_t size = reader->offsets[i + 1] - reader->offsets[i];
+                largest = size > largest ? size : largest;
+        }
+        return largest;
+}
+
+/********** ChunkedReader_load ********
+ * 
+ * Reads every chunk of a stream that is not a regular file into memory,
+ * so that its chunks can be decoded in any order
+ *
+ * Parameters:
+ *      ChunkedReader reader: The reader, not yet read from
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if reader is NULL or the stream ends first
+ *      - does nothing for a regular file, which pread reads in any order
+ *      
+ **********************************/
+void ChunkedReader_load(ChunkedReader reader)
+{
+        assert(reader != NULL);
+        if (reader->base >= 0 || reader->body != NULL) {
+                return;
+        }
+        assert(reader->position == 0);
+
+        size_t size = reader->offsets[reader->chunks];
+        struct Stats_timer timer;
+        reader->body = ALLOC(size + 1);
+        Stats_start(&timer);
+        size_t read = fread(reader->body, 1, size, reader->input);
+        Stats_stop(STATS_READ, &timer);
+        assert(read == size);
+        Stats_count(STATS_BYTES_IN, size);
+        reader->position = size;
+}
+
+/********** ChunkedReader_decodeChunk ********
+ * 
+ * Decodes one chunk into its rows of codewords
+ *
+ * Parameters:
+ *      ChunkedReader reader:   The reader
+ *      unsigned chunk:         Which chunk
+ *      unsigned char *scratch: Room for ChunkedReader_maxChunkBytes bytes
+ *      uint32_t *words:        Where the chunk's codewords go, in host
+ *                              order, rowsPerChunk rows of width / 2
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if chunk is out of range, or its bytes are cut short or do
+ *        not decode
+ *      - safe from several threads at once, each with its own scratch,
+ *        when the input is a regular file or has been loaded
+ *      
+ **********************************/
+void ChunkedReader_decodeChunk(ChunkedReader reader, unsigned chunk,
+                               unsigned char *scratch, uint32_t *words)
+{
+        assert(reader != NULL && chunk < reader->chunks);
+        assert(scratch != NULL && words != NULL);
+
+        const unsigned char *bytes = chunkBytes(reader, chunk, scratch);
+        struct Stats_timer timer;
+
+        Stats_start(&timer);
+        decodeChunk(bytes, reader->offsets[chunk + 1] -
+                    reader->offsets[chunk], reader->blocks,
+                    chunkRows(reader, chunk), words);
+        Stats_stop(STATS_ENTROPY, &timer);
+}
+
+/********** ChunkedReader_seekRow ********
+ * 
+ * Makes a block row the next one ChunkedReader_nextRow gives
+ *
+ * Parameters:
+ *      ChunkedReader reader: The reader
+ *      unsigned row:         The block row
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if row is out of range, or a stream would have to go back
+ *      - decodes the row's chunk, reading only that chunk from a regular
+ *        file
+ *      
+ **********************************/
+void ChunkedReader_seekRow(ChunkedReader reader, unsigned row)
+{
+        assert(reader != NULL && row < reader->blockRows);
+        unsigned chunk = row / reader->rowsPerChunk;
+
+        if (chunk != reader->chunk) {
+                ChunkedReader_decodeChunk(reader, chunk, reader->bytes,
+                                          reader->rows);
+                reader->chunk = chunk;
+        }
+        reader->row = row;
+}
+
+/********** ChunkedReader_nextRow ********
+ * 
+ * Gives the next block row of codewords, in order from the first
+ *
+ * Parameters:
+ *      ChunkedReader reader: The reader
+ *      uint32_t *words:      Where the row's width / 2 codewords go, in
+ *                            host order
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if there are no rows left
+ *      - decodes a chunk at a time, so memory is one chunk's worth
+ *      
+ **********************************/
+void ChunkedReader_nextRow(ChunkedReader reader, uint32_t *words)
+{
+        assert(reader != NULL && words != NULL);
+
+        ChunkedReader_seekRow(reader, reader->row);
+        memcpy(words, reader->rows + (size_t)(reader->row %
+               reader->rowsPerChunk) * reader->blocks,
+               (size_t)reader->blocks * sizeof(*words));
+        reader->row++;
+}
+
+/********** encodeChunkTask ********
+ * 
+ * Codes one chunk of a compression into its own buffer
+ *
+ * Parameters:
+ *      unsigned chunk:  Which chunk
+ *      unsigned worker: The thread running the task (unused)
+ *      void *cl:        The struct EncodeChunks
+ * 
+ * Return: none
+ *
+ * Notes: none
+ *      
+ **********************************/
+static void encodeChunkTask(unsigned chunk, unsigned worker, void *cl)
+{
+        struct EncodeChunks *job = cl;
+        (void)worker;
+
+        unsigned first = chunk * job->rowsPerChunk;
+        unsigned rows = job->blockRows - first < job->rowsPerChunk
+                        ? job->blockRows - first : job->rowsPerChunk;
+        size_t blocks = (size_t)rows * job->blocks;
+        struct Stats_timer timer;
+
+        /* No code is longer than MAX_BITS */
+        job->chunks[chunk] = ALLOC(TABLE_BYTES +
+                                   (blocks * FIELDS * MAX_BITS + 7) / 8 + 1);
+        Stats_start(&timer);
+        job->sizes[chunk] = encodeChunk(job->words + (size_t)first *
+                                        job->blocks, job->blocks, rows,
+                                        job->chunks[chunk]);
+        Stats_stop(STATS_ENTROPY, &timer);
+}
+
+/********** toSymbols ********
+ * 
+ * Splits a codeword into the symbols that code it
+ *
+ * Parameters:
+ *      uint32_t word:             The codeword
+ *      unsigned *left:            The a of the block to the left, or 0
+ *                                 at the start of a row; set to this a
+ *      unsigned symbols[FIELDS]:  Set to the symbols
+ * 
+ * Return: none
+ *
+ * Notes: none
+ *      
+ **********************************/
+static inline void toSymbols(uint32_t word, unsigned *left,
+                             unsigned symbols[FIELDS])
+{
+        for (unsigned f = 0; f < FIELDS; f++) {
+                symbols[f] = Bitpack_getu32(word, fieldWidths[f],
+                                            fieldLsbs[f]);
+        }
+
+        unsigned a = symbols[0];
+        symbols[0] = (a - *left) & Bitpack_mask32(CODEWORD_A_WIDTH);
+        *left = a;
+}
+
+/********** encodeChunk ********
+ * 
+ * Codes the codewords of a chunk
+ *
+ * Parameters:
+ *      const uint32_t *words: The chunk's codewords, in host order
+ *      unsigned blocks:       Blocks per row
+ *      unsigned rows:         Rows in the chunk
+ *      unsigned char *out:    Where the chunk goes, with room for the
+ *                             tables and MAX_BITS per symbol
+ * 
+ * Return: the chunk's size in bytes
+ *
+ * Notes: none
+ *      
+ **********************************/
+static size_t encodeChunk(const uint32_t *words, unsigned blocks,
+                          unsigned rows, unsigned char *out)
+{
+        uint32_t counts[FIELDS][MAX_SYMBOLS];
+        uint8_t lengths[FIELDS][MAX_SYMBOLS];
+        uint16_t codes[FIELDS][MAX_SYMBOLS];
+        unsigned symbols[FIELDS];
+        size_t count = (size_t)blocks * rows;
+
+        unsigned left = 0;
+        memset(counts, 0, sizeof(counts));
+        for (size_t i = 0; i < count; i++) {
+                if (i % blocks == 0) {
+                        left = 0;
+                }
+                toSymbols(words[i], &left, symbols);
+                for (unsigned f = 0; f < FIELDS; f++) {
+                        counts[f][symbols[f]]++;
+                }
+        }
+
+        unsigned char *start = out;
+        for (unsigned f = 0; f < FIELDS; f++) {
+                unsigned n = 1u << fieldWidths[f];
+
+                codeLengths(counts[f], n, lengths[f]);
+                canonicalCodes(lengths[f], n, codes[f]);
+                for (unsigned s = 0; s < n; s += 2) {
+                        *out++ = lengths[f][s] | lengths[f][s + 1] << 4;
+                }
+        }
+
+        uint64_t acc = 0;
+        unsigned bits = 0;
+        for (size_t i = 0; i < count; i++) {
+                if (i % blocks == 0) {
+                        left = 0;
+                }
+                toSymbols(words[i], &left, symbols);
+                /* Flushing after every code keeps bits under 8 + MAX_BITS,
+                 * well inside the accumulator */
+                for (unsigned f = 0; f < FIELDS; f++) {
+                        acc |= (uint64_t)codes[f][symbols[f]] << bits;
+                        bits += lengths[f][symbols[f]];
+                        while (bits >= 8) {
+                                *out++ = acc;
+                                acc >>= 8;
+                                bits -= 8;
+                        }
+                }
+        }
+        if (bits > 0) {
+                *out++ = acc;
+        }
+
+        return out - start;
+}
+
+/********** decodeChunk ********
+ * 
+ * Decodes the codewords of a chunk
+ *
+ * Parameters:
+ *      const unsigned char *bytes: The chunk
+ *      size_t size:                Its size in bytes
+ *      unsigned blocks:            Blocks per row
+ *      unsigned rows:              Rows in the chunk
+ *      uint32_t *words:            Where the codewords go, in host order
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if the tables are not a prefix code, a code is not in its
+ *        table, or the codes run past the end of the chunk
+ *      
+ **********************************/
+static void decodeChunk(const unsigned char *bytes, size_t size,
+                        unsigned blocks, unsigned rows, uint32_t *words)
+{
+        static __thread uint16_t tables[FIELDS][1 << MAX_BITS];
+        uint8_t lengths[MAX_SYMBOLS];
+        assert(size >= TABLE_BYTES);
+
+        const unsigned char *pos = bytes;
+        for (unsigned f = 0; f < FIELDS; f++) {
+                unsigned n = 1u << fieldWidths[f];
+
+                for (unsigned s = 0; s < n; s += 2) {
+                        lengths[s] = *pos & 0xf;
+                        lengths[s + 1] = *pos++ >> 4;
+                }
+                buildTable(lengths, n, tables[f]);
+        }
+
+        const unsigned char *end = bytes + size, *data = pos;
+        uint64_t acc = 0;
+        unsigned bits = 0;
+        size_t count = (size_t)blocks * rows;
+        unsigned left = 0;
+
+        for (size_t i = 0; i < count; i++) {
+                uint32_t word = 0;
+
+                if (i % blocks == 0) {
+                        left = 0;
+                }
+                for (unsigned f = 0; f < FIELDS; f++) {
+                        /* Past the end the stream reads as zeros; the
+                         * check after the loop catches any use of them */
+                        while (bits <= 56) {
+                                acc |= (uint64_t)(pos < end ? *pos : 0)
+                                       << bits;
+                                pos++;
+                                bits += 8;
+                        }
+
+                        uint16_t entry = tables[f][acc &
+                                         ((1u << MAX_BITS) - 1)];
+                        assert(entry != 0);
+                        acc >>= entry & 0xf;
+                        bits -= entry & 0xf;
+
+                        unsigned symbol = entry >> 4;
+                        if (f == 0) {
+                                symbol = (symbol + left) &
+                                         Bitpack_mask32(CODEWORD_A_WIDTH);
+                                left = symbol;
+                        }
+                        word |= Bitpack_putu32(symbol, fieldWidths[f],
+                                               fieldLsbs[f]);
+                }
+                words[i] = word;
+        }
+
+        assert((uint64_t)(pos - data) * 8 - bits <=
+               (uint64_t)(end - data) * 8);
+}
+
+/********** codeLengths ********
+ * 
+ * Finds the lengths of a Huffman code for a field's symbol counts
+ *
+ * Parameters:
+ *      const uint32_t *counts: How often each symbol occurs
+ *      unsigned symbols:       How many symbols the field has
+ *      uint8_t *lengths:       Set to each symbol's code length, 0 for
+ *                              symbols that do not occur
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - a lone symbol gets a one-bit code
+ *      - while the longest code is over MAX_BITS, the counts are halved
+ *        (keeping every symbol that occurs) and the code rebuilt, which
+ *        flattens it; with at most 64 symbols this ends by six bits
+ *      
+ **********************************/
+static void codeLengths(const uint32_t *counts, unsigned symbols,
+                        uint8_t *lengths)
+{
+        uint64_t weights[2 * MAX_SYMBOLS];
+        int parents[2 * MAX_SYMBOLS];
+        int alive[2 * MAX_SYMBOLS];
+        unsigned leaves[MAX_SYMBOLS];
+        uint32_t scaled[MAX_SYMBOLS];
+
+        memcpy(scaled, counts, symbols * sizeof(*scaled));
+        memset(lengths, 0, symbols);
+
+        for (;;) {
+                unsigned n = 0;
+                for (unsigned s = 0; s < symbols; s++) {
+                        if (scaled[s] > 0) {
+                                weights[n] = scaled[s];
+                                parents[n] = -1;
+                                alive[n] = 1;
+                                leaves[n++] = s;
+                        }
+                }
+                if (n <= 1) {
+                        if (n == 1) {
+                                lengths[leaves[0]] = 1;
+                        }
+                        return;
+                }
+
+                /* Join the two lightest live nodes until one is left */
+                for (unsigned node = n; node < 2 * n - 1; node++) {
+                        int lightest[2] = { -1, -1 };
+                        for (unsigned i = 0; i < node; i++) {
+                                if (!alive[i]) {
+                                        continue;
+                                }
+                                if (lightest[0] < 0 ||
+                                    weights[i] < weights[lightest[0]]) {
+                                        lightest[1] = lightest[0];
+                                        lightest[0] = i;
+                                } else if (lightest[1] < 0 ||
+                                           weights[i] <
+                                           weights[lightest[1]]) {
+                                        lightest[1] = i;
+                                }
+                        }
+                        weights[node] = weights[lightest[0]] +
+                                        weights[lightest[1]];
+                        parents[node] = -1;
+                        alive[node] = 1;
+                        for (int k = 0; k < 2; k++) {
+                                parents[lightest[k]] = node;
+                                alive[lightest[k]] = 0;
+                        }
+                }
+
+                unsigned longest = 0;
+                for (unsigned i = 0; i < n; i++) {
+                        unsigned depth = 0;
+                        for (int p = parents[i]; p >= 0; p = parents[p]) {
+                                depth++;
+                        }
+                        lengths[leaves[i]] = depth;
+                        longest = depth > longest ? depth : longest;
+                }
+                if (longest <= MAX_BITS) {
+                        return;
+                }
+
+                for (unsigned s = 0; s < symbols; s++) {
+                        scaled[s] = (scaled[s] + 1) / 2;
+                }
+        }
+}
+
+/********** canonicalCodes ********
+ * 
+ * Assigns the canonical code for a set of code lengths
+ *
+ * Parameters:
+ *      const uint8_t *lengths: Each symbol's code length, 0 for none
+ *      unsigned symbols:       How many symbols there are
+ *      uint16_t *codes:        Set to each symbol's code, bit-reversed so
+ *                              that it can be written least significant
+ *                              bit first
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - shorter codes come first, and codes of one length go in symbol
+ *        order, so the lengths alone determine the codes
+ *      
+ **********************************/
+static void canonicalCodes(const uint8_t *lengths, unsigned symbols,
+                           uint16_t *codes)
+{
+        unsigned counts[MAX_BITS + 1] = { 0 };
+        unsigned next[MAX_BITS + 1];
+
+        for (unsigned s = 0; s < symbols; s++) {
+                counts[lengths[s]]++;
+        }
+        counts[0] = 0;
+
+        unsigned code = 0;
+        for (unsigned bits = 1; bits <= MAX_BITS; bits++) {
+                code = (code + counts[bits - 1]) << 1;
+                next[bits] = code;
+        }
+
+        for (unsigned s = 0; s < symbols; s++) {
+                unsigned length = lengths[s], reversed = 0;
+                if (length == 0) {
+                        continue;
+                }
+                code = next[length]++;
+                for (unsigned b = 0; b < length; b++) {
+                        reversed = reversed << 1 | ((code >> b) & 1);
+                }
+                codes[s] = reversed;
+        }
+}
+
+/********** buildTable ********
+ * 
+ * Builds the decoding table of a field's code
+ *
+ * Parameters:
+ *      const uint8_t *lengths: Each symbol's code length, 0 for none
+ *      unsigned symbols:       How many symbols there are
+ *      uint16_t *table:        Set, for every MAX_BITS bits of input, to
+ *                              the symbol they start with shifted left 4
+ *                              and the length of its code, or 0 if no
+ *                              code matches
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if a length is over MAX_BITS or the lengths do not form a
+ *        prefix code
+ *      
+ **********************************/
+static void buildTable(const uint8_t *lengths, unsigned symbols,
+                       uint16_t *table)
+{
+        uint16_t codes[MAX_SYMBOLS];
+        uint32_t space = 0;
+
+        for (unsigned s = 0; s < symbols; s++) {
+                assert(lengths[s] <= MAX_BITS);
+                if (lengths[s] > 0) {
+                        space += 1u << (MAX_BITS - lengths[s]);
+                }
+        }
+        assert(space <= 1u << MAX_BITS);
+
+        canonicalCodes(lengths, symbols, codes);
+        memset(table, 0, sizeof(*table) << MAX_BITS);
+        for (unsigned s = 0; s < symbols; s++) {
+                unsigned length = lengths[s];
+                if (length == 0) {
+                        continue;
+                }
+                for (unsigned k = codes[s]; k < 1u << MAX_BITS;
+                     k += 1u << length) {
+                        table[k] = s << 4 | length;
+                }
+        }
+}
+
+/********** chunkBytes ********
+ * 
+ * Gets the bytes of a chunk
+ *
+ * Parameters:
+ *      ChunkedReader reader:   The reader
+ *      unsigned chunk:         Which chunk
+ *      unsigned char *scratch: Room for the chunk, if it must be read
+ * 
+ * Return: the chunk's bytes, in the loaded body or in scratch
+ *
+ * Notes:
+ *      - CRE if the input ends first, or a stream would have to go back
+ *      - a stream skips any chunks before this one
+ *      - counts the bytes read for --stats
+ *      
+ **********************************/
+static const unsigned char *chunkBytes(ChunkedReader reader,
+                                       unsigned chunk,
+                                       unsigned char *scratch)
+{
+        uint64_t from = reader->offsets[chunk];
+        size_t size = reader->offsets[chunk + 1] - from;
+
+        /* A loaded body was counted when it was read; a mapped one is
+         * counted a chunk at a time, as it is touched */
+        if (reader->body != NULL) {
+                if (reader->mapped != NULL) {
+                        Stats_count(STATS_BYTES_IN, size);
+                }
+                return reader->body + from;
+        }
+
+        struct Stats_timer timer;
+        Stats_start(&timer);
+        if (reader->base >= 0) {
+                size_t got = 0;
+                while (got < size) {
+                        ssize_t n = pread(fileno(reader->input),
+                                          scratch + got, size - got,
+                                          reader->base + from + got);
+                        assert(n > 0);
+                        got += n;
+                }
+        } else {
+                assert(from >= reader->position);
+                for (; reader->position < from; reader->position++) {
+                        int c = getc(reader->input);
+                        assert(c != EOF);
+                }
+                size_t read = fread(scratch, 1, size, reader->input);
+                assert(read == size);
+                reader->position += size;
+        }
+        Stats_stop(STATS_READ, &timer);
+        Stats_count(STATS_BYTES_IN, size);
+
+        return scratch;
+}
+
+/* The number of block rows in a chunk; only the last may be short */
+static unsigned chunkRows(ChunkedReader reader, unsigned chunk)
+{
+        unsigned first = chunk * reader->rowsPerChunk;
+        unsigned rows = reader->blockRows - first;
+
+        return rows < reader->rowsPerChunk ? rows : reader->rowsPerChunk;
+}
+
+/********** readIndex ********
+ * 
+ * Reads the chunk counts line of a format 3 header and the chunk index
+ *
+ * Parameters:
+ *      ChunkedReader reader: The reader being opened, with its blocks
+ *                            and blockRows set
+ * 
+ * Return: 1 if they were read, 0 if they are badly formatted, cut short
+ *         or do not match the image
+ *
+ * Notes:
+ *      - sets rowsPerChunk, chunks and offsets; offsets may be set even
+ *        when 0 is returned
+ *      
+ **********************************/
+static int readIndex(ChunkedReader reader)
+{
+        FILE *input = reader->input;
+        int read = fscanf(input, "%u %u", &reader->rowsPerChunk,
+                          &reader->chunks);
+        if (read != 2 || getc(input) != '\n' || reader->rowsPerChunk == 0) {
+                return 0;
+        }
+        unsigned chunks = reader->blocks == 0 ? 0 : (reader->blockRows +
+                          reader->rowsPerChunk - 1) / reader->rowsPerChunk;
+        if (reader->chunks != chunks) {
+                return 0;
+        }
+
+        reader->offsets = ALLOC((chunks + 1) * sizeof(*reader->offsets));
+        for (unsigned i = 0; i <= chunks; i++) {
+                uint64_t offset = 0;
+                for (int byte = 0; byte < 8; byte++) {
+                        int c = getc(input);
+                        if (c == EOF) {
+                                return 0;
+                        }
+                        offset = offset << 8 | c;
+                }
+                reader->offsets[i] = offset;
+                if (i == 0 ? offset != 0 : offset < reader->offsets[i - 1]) {
+                        return 0;
+                }
+        }
+
+        return 1;
+}
@@ -0,0 +1,48 @@
+/**************************************************************
+ *
+ *                     chunked.h
+ *
+ *     Assignment: arith
+ *     Authors: Anh Hoang, Emilio Aleman
+ *     Date:  3/8/2024
+ *
+ *    This file contains the declaration of compressed image format 3,
+ *    which stores the codewords Huffman-coded field by field in chunks of
+ *    block rows. Every chunk carries its own code tables, and an index of
+ *    chunk offsets follows the header, so chunks can be decoded in any
+ *    order and on any thread.
+ *
+ *    After the first header line, "COMP40 Compressed image format 3",
+ *    come the width and height, then the block rows per chunk and the
+ *    number of chunks, each line ending in a newline. The index is one
+ *    more offset than there are chunks, eight bytes each, big-endian,
+ *    counted from the end of the index; chunk i runs from offset i to
+ *    offset i + 1.
+ *
+ **************************************************************/
+#ifndef CHUNKED_INCLUDED
+#define CHUNKED_INCLUDED
+
+#include <stdio.h>
+#include <stdint.h>
+
+typedef struct ChunkedReader *ChunkedReader;
+
+size_t Chunked_write(FILE *output, const uint32_t *words, unsigned width,
+                     unsigned height, unsigned threads);
+
+ChunkedReader ChunkedReader_open(FILE *input, unsigned width,
+                                 unsigned height);
+ChunkedReader ChunkedReader_tryOpen(FILE *input, unsigned width,
+                                    unsigned height);
+void ChunkedReader_close(ChunkedReader *reader);
+unsigned ChunkedReader_chunks(ChunkedReader reader);
+unsigned ChunkedReader_rowsPerChunk(ChunkedReader reader);
+size_t ChunkedReader_maxChunkBytes(ChunkedReader reader);
+void ChunkedReader_load(ChunkedReader reader);
+void ChunkedReader_decodeChunk(ChunkedReader reader, unsigned chunk,
+                               unsigned char *scratch, uint32_t *words);
+void ChunkedReader_seekRow(ChunkedReader reader, unsigned row);
+void ChunkedReader_nextRow(ChunkedReader reader, uint32_t *words);
+
+#endif
@@ -0,0 +1,252 @@
+/**************************************************************
+ *
+ *                     chunked_test.c
+ *
+ *     Assignment: arith
+ *     Authors: Anh Hoang, Emilio Aleman
+ *     Date:  3/8/2024
+ *
+ *    Round-trip tests for compressed image format 3. Each case writes
+ *    codewords with Chunked_write to a temporary file, reads them back
+ *    row by row and chunk by chunk, and prints whether they match. The
+ *    exit status is the number of failed cases.
+ *
+ **************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "assert.h"
+#include "except.h"
+#include "mem.h"
+#include "bitpackInline.h"
+#include "chunked.h"
+
+static int roundTrip(const char *name, const uint32_t *words,
+                     unsigned width, unsigned height,
+                     unsigned expectChunks);
+static int corruptTable(void);
+static ChunkedReader openChunked(FILE *file, unsigned *width,
+                                 unsigned *height);
+static uint32_t sameSymbols(unsigned symbol);
+
+int main()
+{
+        int failed = 0;
+
+        /* 609 one-block rows whose 13 symbols have Fibonacci counts, so
+         * the rarest symbol of every field gets a MAX_BITS code */
+        uint32_t *fib = ALLOC(609 * sizeof(*fib));
+        unsigned count[13] = { 1, 1 }, at = 0;
+        for (unsigned s = 2; s < 13; s++) {
+                count[s] = count[s - 1] + count[s - 2];
+        }
+        for (unsigned s = 0; s < 13; s++) {
+                for (unsigned k = 0; k < count[s]; k++) {
+                        fib[at++] = sameSymbols(s);
+                }
+        }
+        failed += roundTrip("longest codes", fib, 2, 2 * 609, 1);
+        FREE(fib);
+
+        /* Every field of the one chunk has a single symbol */
+        uint32_t *flat = ALLOC(64 * 64 * sizeof(*flat));
+        for (unsigned i = 0; i < 64 * 64; i++) {
+                flat[i] = sameSymbols(5);
+        }
+        failed += roundTrip("one symbol", flat, 128, 128, 1);
+        FREE(flat);
+
+        /* 5000 blocks a row gives 3 rows a chunk, so 10 rows are three
+         * full chunks and a chunk of one row */
+        uint32_t *wide = ALLOC(5000 * 10 * sizeof(*wide));
+        srand(40);
+        for (unsigned i = 0; i < 5000 * 10; i++) {
+                wide[i] = (uint32_t)rand() << 16 ^ (uint32_t)rand();
+        }
+        failed += roundTrip("short last chunk", wide, 10000, 20, 4);
+        FREE(wide);
+
+        uint32_t none = 0;
+        failed += roundTrip("width 0", &none, 0, 8, 0);
+        failed += roundTrip("height 0", &none, 8, 0, 0);
+
+        failed += corruptTable();
+
+        printf("%d failed\n", failed);
+        return failed;
+}
+
+/********** roundTrip ********
+ *
+ * Writes codewords in format 3 and checks that both ways of reading
+ * them back give the same codewords
+ *
+ * Parameters:
+ *      const char *name:      The case, for the report
+ *      const uint32_t *words: The codewords, row by row
+ *      unsigned width:        The width of the image
+ *      unsigned height:       The height of the image
+ *      unsigned expectChunks: How many chunks the file should have
+ *
+ * Return: 0 if the case passed, 1 if not
+ *
+ * Notes: prints a line for the case
+ *
+ **********************************/
+static int roundTrip(const char *name, const uint32_t *words,
+                     unsigned width, unsigned height,
+                     unsigned expectChunks)
+{
+        FILE *file = tmpfile();
+        assert(file != NULL);
+        Chunked_write(file, words, width, height, 2);
+        rewind(file);
+
+        ChunkedReader reader = openChunked(file, &width, &height);
+        unsigned blocks = width / 2, blockRows = height / 2;
+        unsigned chunks = ChunkedReader_chunks(reader);
+        unsigned wrong = 0;
+
+        uint32_t *row = ALLOC((blocks + 1) * sizeof(*row));
+        for (unsigned r = 0; r < blockRows && chunks > 0; r++) {
+                ChunkedReader_nextRow(reader, row);
+                wrong += memcmp(row, words + (size_t)r * blocks,
+                                blocks * sizeof(*row)) != 0;
+        }
+        FREE(row);
+
+        /* Backwards, to read each chunk on its own */
+        unsigned rowsPerChunk = ChunkedReader_rowsPerChunk(reader);
+        unsigned char *scratch = ALLOC(ChunkedReader_maxChunkBytes(reader) +
+                                       1);
+        uint32_t *chunkWords = ALLOC(((size_t)rowsPerChunk * blocks + 1) *
+                                     sizeof(*chunkWords));
+        for (unsigned c = chunks; c-- > 0; ) {
+                unsigned first = c * rowsPerChunk;
+                unsigned rows = blockRows - first < rowsPerChunk
+                                ? blockRows - first : rowsPerChunk;
+
+                ChunkedReader_decodeChunk(reader, c, scratch, chunkWords);
+                wrong += memcmp(chunkWords, words + (size_t)first * blocks,
+                                (size_t)rows * blocks *
+                                sizeof(*chunkWords)) != 0;
+        }
+        FREE(chunkWords);
+        FREE(scratch);
+
+        ChunkedReader_close(&reader);
+        fclose(file);
+
+        int failed = wrong > 0 || chunks != expectChunks;
+        printf("%s: %s (%u chunks, %u wrong)\n", name,
+               failed ? "FAIL" : "pass", chunks, wrong);
+        return failed;
+}
+
+/********** corruptTable ********
+ *
+ * Checks that a chunk whose code lengths are not a prefix code is
+ * refused rather than decoded
+ *
+ * Parameters: none
+ *
+ * Return: 0 if the case passed, 1 if not
+ *
+ * Notes:
+ *      - gives every symbol of the first field a one-bit code, which
+ *        buildTable must reject with an assertion
+ *
+ **********************************/
+static int corruptTable(void)
+{
+        uint32_t words[16];
+        for (unsigned i = 0; i < 16; i++) {
+                words[i] = sameSymbols(i % 4);
+        }
+
+        FILE *file = tmpfile();
+        assert(file != NULL);
+        Chunked_write(file, words, 8, 8, 1);
+        rewind(file);
+
+        unsigned width, height;
+        ChunkedReader reader = openChunked(file, &width, &height);
+        long chunk = ftell(file);
+        ChunkedReader_close(&reader);
+
+        /* The reader stops at the end of the index, where chunk 0 and
+         * field a's 64 lengths, its first 32 bytes, begin */
+        fseek(file, chunk, SEEK_SET);
+        for (unsigned i = 0; i < 32; i++) {
+                putc(0x11, file);
+        }
+        rewind(file);
+
+        reader = openChunked(file, &width, &height);
+        unsigned char *scratch = ALLOC(ChunkedReader_maxChunkBytes(reader) +
+                                       1);
+        uint32_t decoded[16];
+        volatile int caught = 0;
+        TRY
+                ChunkedReader_decodeChunk(reader, 0, scratch, decoded);
+        EXCEPT(Assert_Failed)
+                caught = 1;
+        END_TRY;
+        FREE(scratch);
+        ChunkedReader_close(&reader);
+        fclose(file);
+
+        printf("corrupt table: %s\n", caught ? "pass" : "FAIL");
+        return !caught;
+}
+
+/********** openChunked ********
+ *
+ * Reads the first two header lines of a format 3 file and opens a
+ * reader on the rest
+ *
+ * Parameters:
+ *      FILE *file:       The file, at its start
+ *      unsigned *width:  Set to the width of the image
+ *      unsigned *height: Set to the height of the image
+ *
+ * Return: the reader
+ *
+ * Notes:
+ *      - CRE if the header is not format 3
+ *
+ **********************************/
+static ChunkedReader openChunked(FILE *file, unsigned *width,
+                                 unsigned *height)
+{
+        int read = fscanf(file, "COMP40 Compressed image format 3\n%u %u",
+                          width, height);
+        int c = getc(file);
+        assert(read == 2 && c == '\n');
+
+        return ChunkedReader_open(file, *width, *height);
+}
+
+/********** sameSymbols ********
+ *
+ * Makes a codeword whose every field codes as the same symbol
+ *
+ * Parameters:
+ *      unsigned symbol: The symbol, under 16
+ *
+ * Return: the codeword
+ *
+ * Notes:
+ *      - a is coded against the block to its left, so a row of such
+ *        codewords codes a as symbol only in its first block
+ *
+ **********************************/
+static uint32_t sameSymbols(unsigned symbol)
+{
+        return Bitpack_putu32(symbol, CODEWORD_A_WIDTH, CODEWORD_A_LSB) |
+               Bitpack_putu32(symbol, CODEWORD_B_WIDTH, CODEWORD_B_LSB) |
+               Bitpack_putu32(symbol, CODEWORD_C_WIDTH, CODEWORD_C_LSB) |
+               Bitpack_putu32(symbol, CODEWORD_D_WIDTH, CODEWORD_D_LSB) |
+               Bitpack_putu32(symbol, CODEWORD_PB_WIDTH, CODEWORD_PB_LSB) |
+               Bitpack_putu32(symbol, CODEWORD_PR_WIDTH, CODEWORD_PR_LSB);
+}
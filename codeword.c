@@ -13,6 +13,36 @@
  **************************************************************/
 #include "codeword.h"
 
+/********** packWord ********
+ *
+ * Creates a 64-bit word by packing the components of a Compressed value.
+ *
+ * Parameters:
+ *      struct Compressed comp: The components (a, b, c, d, pb_avg, pr_avg)
+ *
+ * Return:
+ *      uint64_t: The resulting 64-bit word
+ *
+ * Expects:
+ *      - every component fits in its field, else Bitpack_Overflow is raised
+ * 
+ ************************/
+uint64_t packWord(struct Compressed comp)
+{
+        uint64_t word = 0;
+
+        word = Bitpack_newu(word, CODEWORD_A_WIDTH, CODEWORD_A_LSB, comp.a);
+        word = Bitpack_news(word, CODEWORD_B_WIDTH, CODEWORD_B_LSB, comp.b);
+        word = Bitpack_news(word, CODEWORD_C_WIDTH, CODEWORD_C_LSB, comp.c);
+        word = Bitpack_news(word, CODEWORD_D_WIDTH, CODEWORD_D_LSB, comp.d);
+        word = Bitpack_newu(word, CODEWORD_PB_WIDTH, CODEWORD_PB_LSB, 
+                            comp.pb_avg);
+        word = Bitpack_newu(word, CODEWORD_PR_WIDTH, CODEWORD_PR_LSB, 
+                            comp.pr_avg);
+
+        return word;
+}
+
 /********** codeWord ********
  *
  * Creates a 64-bit word by packing components from a Compressed struct.
@@ -32,14 +62,8 @@
 uint64_t codeWord(Compressed comp)
 {
         assert(comp != NULL);
-        uint64_t word = 0;
 
-        word = Bitpack_newu(word, 6, 26, comp->a);
-        word = Bitpack_news(word, 6, 20, comp->b);
-        word = Bitpack_news(word, 6, 14, comp->c);
-        word = Bitpack_news(word, 6, 8, comp->d);
-        word = Bitpack_newu(word, 4, 4, comp->pb_avg);
-        word = Bitpack_newu(word, 4, 0, comp->pr_avg);
+        uint64_t word = packWord(*comp);
 
         FREE(comp);
 
@@ -74,7 +98,38 @@ uint64_t getCodeword(FILE *input)
         return word;
 }
 
-/********** getCodeWord ********
+/********** unpackWord ********
+ * 
+ * Decodes a 64-bit word into a Compressed value
+ *
+ * Parameters:
+ *      uint64_t word: The 64-bit word to decode
+ *
+ * Return:
+ *      struct Compressed: the decoded values
+ *
+ * Notes:
+ *      does not allocate
+ * 
+ *********************************/
+struct Compressed unpackWord(uint64_t word)
+{
+        struct Compressed comp;
+
+        /* Extracts specific bit fields from the word using 
+         * Bitpack functions and assign to fields in the Compressed struct
+         */
+        comp.a = Bitpack_getu(word, CODEWORD_A_WIDTH, CODEWORD_A_LSB);
+        comp.b = Bitpack_gets(word, CODEWORD_B_WIDTH, CODEWORD_B_LSB);
+        comp.c = Bitpack_gets(word, CODEWORD_C_WIDTH, CODEWORD_C_LSB);
+        comp.d = Bitpack_gets(word, CODEWORD_D_WIDTH, CODEWORD_D_LSB);
+        comp.pb_avg = Bitpack_getu(word, CODEWORD_PB_WIDTH, CODEWORD_PB_LSB);
+        comp.pr_avg = Bitpack_getu(word, CODEWORD_PR_WIDTH, CODEWORD_PR_LSB);
+
+        return comp;
+}
+
+/********** decodeWord ********
  * 
  * Decodes a 64-bit word into a Compressed struct
  *
@@ -85,7 +140,8 @@ uint64_t getCodeword(FILE *input)
  *      Compressed: A Compressed struct containing the decoded values
  *
  * Notes:
- *      none
+ *      - the Compressed struct must be freed by the caller
+ *      - thin wrapper around unpackWord
  * 
  *********************************/
 Compressed decodeWord(uint64_t word)
@@ -93,15 +149,7 @@ Compressed decodeWord(uint64_t word)
         Compressed comp;
         NEW(comp);
 
-        /* Extracts specific bit fields from the word using 
-         * Bitpack functions and assign to fields in the Compressed struct
-         */
-        comp->a = Bitpack_getu(word, 6, 26);
-        comp->b = Bitpack_gets(word, 6, 20);
-        comp->c = Bitpack_gets(word, 6, 14);
-        comp->d = Bitpack_gets(word, 6, 8);
-        comp->pb_avg = Bitpack_getu(word, 4, 4);
-        comp->pr_avg = Bitpack_getu(word, 4, 0);
+        *comp = unpackWord(word);
 
         return comp;
 }
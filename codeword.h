@@ -23,8 +23,12 @@
 #include "except.h"
 #include "pnm.h"
 #include "bitpack.h"
+#include "bitpackInline.h"
 #include "helpers.h"
 
+uint64_t packWord(struct Compressed comp);
+struct Compressed unpackWord(uint64_t word);
+
 uint64_t codeWord(Compressed comp);
 uint64_t getCodeword(FILE *input);
 Compressed decodeWord(uint64_t word);
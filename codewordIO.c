@@ -0,0 +1,209 @@
+/**************************************************************
+ *
+ *                     codewordIO.c
+ *
+ *     Assignment: arith
+ *     Authors: Anh Hoang, Emilio Aleman
+ *     Date:  3/8/2024
+ *
+ *    This file contains the implementation of bulk codeword I/O. Each
+ *    array goes to or from the file in one fread or fwrite, and the
+ *    conversion to or from big-endian order is a byte swap over the whole
+ *    array, done 32 bytes at a time when the CPU supports AVX2.
+ *
+ **************************************************************/
+#include <string.h>
+#include <pthread.h>
+#include "assert.h"
+#include "codewordIO.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SWAP_AVX2 1
+#include <immintrin.h>
+#endif
+
+typedef void SwapFun(uint32_t *words, size_t count);
+
+static SwapFun swapScalar;
+static void pickKernel(void);
+
+static SwapFun *swapWords = swapScalar;
+static pthread_once_t pickOnce = PTHREAD_ONCE_INIT;
+
+/********** Codewords_swap ********
+ * 
+ * Converts an array of codewords between host order and the big-endian
+ * order of the file format, in place
+ *
+ * Parameters:
+ *      uint32_t *words: The codewords
+ *      size_t count:    How many there are
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if words is NULL
+ *      - does nothing on a big-endian host
+ *      
+ **********************************/
+void Codewords_swap(uint32_t *words, size_t count)
+{
+        assert(words != NULL);
+
+        if (__BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__) {
+                return;
+        }
+
+        pthread_once(&pickOnce, pickKernel);
+        swapWords(words, count);
+}
+
+/********** Codewords_write ********
+ * 
+ * Writes an array of codewords to a compressed file in one call
+ *
+ * Parameters:
+ *      FILE *output:    The stream to write to
+ *      uint32_t *words: The codewords, in host order
+ *      size_t count:    How many there are
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if output or words is NULL
+ *      - the words are left in big-endian order
+ *      
+ **********************************/
+void Codewords_write(FILE *output, uint32_t *words, size_t count)
+{
+        assert(output != NULL && words != NULL);
+
+        Codewords_swap(words, count);
+        fwrite(words, sizeof(*words), count, output);
+}
+
+/********** Codewords_read ********
+ * 
+ * Reads an array of codewords from a compressed file in one call
+ *
+ * Parameters:
+ *      FILE *input:     The stream to read from
+ *      uint32_t *words: Where the codewords go, in host order
+ *      size_t count:    How many to read
+ * 
+ * Return: the number of whole codewords that were in the file
+ *
+ * Notes:
+ *      - CRE if input or words is NULL
+ *      - bytes past the end of the file read as 0xff, as they did when
+ *        getCodeword read them one getc at a time
+ *      
+ **********************************/
+size_t Codewords_read(FILE *input, uint32_t *words, size_t count)
+{
+        assert(input != NULL && words != NULL);
+
+        size_t bytes = fread(words, 1, count * sizeof(*words), input);
+        if (bytes < count * sizeof(*words)) {
+                memset((unsigned char *)words + bytes, 0xff, 
+                       count * sizeof(*words) - bytes);
+        }
+
+        Codewords_swap(words, count);
+        return bytes / sizeof(*words);
+}
+
+/********** Codewords_load ********
+ * 
+ * Loads an array of codewords stored in memory in big-endian order
+ *
+ * Parameters:
+ *      const unsigned char *bytes: The stored codewords
+ *      size_t count:               How many there are
+ *      uint32_t *words:            Where the codewords go, in host order
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if bytes or words is NULL
+ *      
+ **********************************/
+void Codewords_load(const unsigned char *bytes, size_t count, 
+                    uint32_t *words)
+{
+        assert(bytes != NULL && words != NULL);
+
+        memcpy(words, bytes, count * sizeof(*words));
+        Codewords_swap(words, count);
+}
+
+/********** swapScalar ********
+ * 
+ * Reverses the bytes of each codeword one at a time
+ *
+ * Parameters: see Codewords_swap
+ * 
+ * Return: none
+ *
+ * Notes: none
+ *      
+ **********************************/
+static void swapScalar(uint32_t *words, size_t count)
+{
+        for (size_t i = 0; i < count; i++) {
+                words[i] = __builtin_bswap32(words[i]);
+        }
+}
+
+#ifdef SWAP_AVX2
+
+/********** swapAvx2 ********
+ * 
+ * Reverses the bytes of eight codewords at a time with AVX2
+ *
+ * Parameters: see Codewords_swap
+ * 
+ * Return: none
+ *
+ * Notes: none
+ *      
+ **********************************/
+__attribute__((target("avx2")))
+static void swapAvx2(uint32_t *words, size_t count)
+{
+        const __m256i reverse = _mm256_setr_epi8(
+                3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+        size_t i = 0;
+
+        for (; i + 8 <= count; i += 8) {
+                __m256i *at = (__m256i *)(words + i);
+                _mm256_storeu_si256(at, _mm256_shuffle_epi8(
+                        _mm256_loadu_si256(at), reverse));
+        }
+
+        swapScalar(words + i, count - i);
+}
+
+#endif
+
+/********** pickKernel ********
+ * 
+ * Picks the fastest byte swap the CPU supports
+ *
+ * Parameters: none
+ * 
+ * Return: none
+ *
+ * Notes: runs once, through pthread_once
+ *      
+ **********************************/
+static void pickKernel(void)
+{
+#ifdef SWAP_AVX2
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+                swapWords = swapAvx2;
+        }
+#endif
+}
@@ -0,0 +1,27 @@
+/**************************************************************
+ *
+ *                     codewordIO.h
+ *
+ *     Assignment: arith
+ *     Authors: Anh Hoang, Emilio Aleman
+ *     Date:  3/8/2024
+ *
+ *    This file contains the declaration of functions that move whole
+ *    arrays of 32-bit codewords between memory and a compressed file,
+ *    where they are stored in big-endian order.
+ *
+ **************************************************************/
+#ifndef CODEWORDIO_INCLUDED
+#define CODEWORDIO_INCLUDED
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+void Codewords_swap(uint32_t *words, size_t count);
+void Codewords_write(FILE *output, uint32_t *words, size_t count);
+size_t Codewords_read(FILE *input, uint32_t *words, size_t count);
+void Codewords_load(const unsigned char *bytes, size_t count, 
+                    uint32_t *words);
+
+#endif
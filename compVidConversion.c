@@ -12,6 +12,56 @@
  *
  **************************************************************/
 #include "compVidConversion.h"
+#include "chromaIndex.h"
+
+/********** RGBtoCompVidVal **********
+ * 
+ * Converts an RGB value to its Component Video representation
+ *
+ * Parameters:
+ *      struct RGB rgb: The RGB pixel to convert
+ *
+ * Return:
+ *      The ComponentVideo value for the pixel
+ *
+ * Notes:
+ *      - does not allocate
+ * 
+ *********************************/
+struct ComponentVideo RGBtoCompVidVal(struct RGB rgb)
+{
+        struct ComponentVideo cv;
+
+        cv.y = 0.299 * rgb.r + 0.587 * rgb.g + 0.114 * rgb.b;
+        cv.pb = -0.168736 * rgb.r - 0.331264 * rgb.g + 0.5 * rgb.b;
+        cv.pr = 0.5 * rgb.r - 0.418688 * rgb.g - 0.081312 * rgb.b;
+
+        return cv;
+}
+
+/********** rgbQuadToCvQuad **********
+ * 
+ * Converts the four pixels of an RGB quad to Component Video
+ *
+ * Parameters:
+ *      const struct rgbQuad *quad:  The RGB pixels of a 2x2 block
+ *      struct CompVidQuad *cvQuad:  Caller-owned storage for the result
+ *
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if quad or cvQuad is NULL
+ * 
+ *********************************/
+void rgbQuadToCvQuad(const struct rgbQuad *quad, struct CompVidQuad *cvQuad)
+{
+        assert(quad != NULL && cvQuad != NULL);
+
+        cvQuad->cv1 = RGBtoCompVidVal(quad->rgb1);
+        cvQuad->cv2 = RGBtoCompVidVal(quad->rgb2);
+        cvQuad->cv3 = RGBtoCompVidVal(quad->rgb3);
+        cvQuad->cv4 = RGBtoCompVidVal(quad->rgb4);
+}
 
 /********** RGBtoCompVid **********
  * 
@@ -26,6 +76,7 @@
  * Notes:
  *      - CRE if RGB is NULL
  *      - cv will be freed by user
+ *      - thin wrapper around RGBtoCompVidVal
  * 
  *********************************/
 ComponentVideo RGBtoCompVid(RGB rgb) 
@@ -34,9 +85,7 @@ ComponentVideo RGBtoCompVid(RGB rgb)
         ComponentVideo cv;
         NEW(cv);
         
-        cv->y = 0.299 * rgb->r + 0.587 * rgb->g + 0.114 * rgb->b;
-        cv->pb = -0.168736 * rgb->r - 0.331264 * rgb->g + 0.5 * rgb->b;
-        cv->pr = 0.5 * rgb->r - 0.418688 * rgb->g - 0.081312 * rgb->b;
+        *cv = RGBtoCompVidVal(*rgb);
         
         return cv;
 }
@@ -70,6 +119,53 @@ CompVidBlock rgbBlockToCvBlock(rgbBlock rgbBlock)
         return cvBlock;
 }
 
+/********************* DCTval *************************
+ * 
+ * Applies the Discrete Cosine Transform (DCT) to the four Component Video
+ * values of a 2x2 block and quantizes the result.
+ *
+ * Parameters:
+ *      const struct CompVidQuad *cvQuad: The Component Video block
+ *
+ * Return:
+ *      The quantized Compressed values for the block
+ *
+ * Notes:
+ *      - CRE if cvQuad is NULL
+ * 
+ **************************************************/
+struct Compressed DCTval(const struct CompVidQuad *cvQuad)
+{
+        assert(cvQuad != NULL);
+        const struct ComponentVideo *cv1 = &cvQuad->cv1;
+        const struct ComponentVideo *cv2 = &cvQuad->cv2;
+        const struct ComponentVideo *cv3 = &cvQuad->cv3;
+        const struct ComponentVideo *cv4 = &cvQuad->cv4;
+
+        /* Calculates the average Pb and Pr values */
+        float pb_avg = (cv1->pb + cv2->pb + cv3->pb + cv4->pb) / 4.0;
+        float pr_avg = (cv1->pr + cv2->pr + cv3->pr + cv4->pr) / 4.0;
+
+        /* Computes DCT coefficients (a, b, c, d) based on the Y values */
+        float a = (cv4->y + cv3->y + cv2->y + cv1->y) / 4.0;
+        float b = (cv4->y + cv3->y - cv2->y - cv1->y) / 4.0;
+        float c = (cv4->y - cv3->y + cv2->y - cv1->y) / 4.0;
+        float d = (cv4->y - cv3->y - cv2->y + cv1->y) / 4.0;
+
+        struct Compressed comp;
+        
+        /* Quantize the coefficients */
+        comp.pb_avg = ChromaIndex_of(pb_avg);
+        comp.pr_avg = ChromaIndex_of(pr_avg);
+
+        comp.a = round(inRange(a, 0, 1) * 511);
+        comp.b = quantize(b);
+        comp.c = quantize(c);
+        comp.d = quantize(d);
+
+        return comp;  
+}
+
 /********************* DCT *************************
  * 
  * Applies the Discrete Cosine Transform (DCT) to a set 
@@ -85,6 +181,7 @@ CompVidBlock rgbBlockToCvBlock(rgbBlock rgbBlock)
  * Notes:
  *      - CRE if any of the ComponentVideos is NULL
  *      - comp will be manually freed outside where the function is called
+ *      - thin wrapper around DCTval
  * 
  **************************************************/
 Compressed DCT(ComponentVideo cv1, ComponentVideo cv2, 
@@ -92,31 +189,61 @@ Compressed DCT(ComponentVideo cv1, ComponentVideo cv2,
 {
         assert(cv1 != NULL && cv2 != NULL && cv3 != NULL && cv4 != NULL);
 
-        /* Calculates the average Pb and Pr values */
-        float pb_avg = (cv1->pb + cv2->pb + cv3->pb + cv4->pb) / 4.0;
-        float pr_avg = (cv1->pr + cv2->pr + cv3->pr + cv4->pr) / 4.0;
-
-        /* Computes DCT coefficients (a, b, c, d) based on the Y values */
-        float a = (cv4->y + cv3->y + cv2->y + cv1->y) / 4.0;
-        float b = (cv4->y + cv3->y - cv2->y - cv1->y) / 4.0;
-        float c = (cv4->y - cv3->y + cv2->y - cv1->y) / 4.0;
-        float d = (cv4->y - cv3->y - cv2->y + cv1->y) / 4.0;
+        struct CompVidQuad cvQuad = { *cv1, *cv2, *cv3, *cv4 };
 
         Compressed comp;
         NEW(comp);
-        
-        /* Quantize the coefficients */
-        comp->pb_avg = Arith40_index_of_chroma(pb_avg);
-        comp->pr_avg = Arith40_index_of_chroma(pr_avg);
-
-        comp->a = round(inRange(a, 0, 1) * 511);
-        comp->b = quantize(b);
-        comp->c = quantize(c);
-        comp->d = quantize(d);
+        *comp = DCTval(&cvQuad);
 
         return comp;  
 }
 
+/************* CompressedToCvQuad **************
+ * 
+ * Converts a Compressed block to the four Component Video values of
+ * its 2x2 block.
+ *
+ * Parameters:
+ *      struct Compressed comp:      The quantized block
+ *      struct CompVidQuad *cvQuad:  Caller-owned storage for the result
+ *
+ * Returns: none
+ *
+ * Notes:
+ *      - CRE if cvQuad is NULL
+ * 
+ *************************************/
+void CompressedToCvQuad(struct Compressed comp, struct CompVidQuad *cvQuad)
+{
+        assert(cvQuad != NULL);
+
+        float a = (float)comp.a / 511.0;
+
+        float b = dequantize((float)comp.b);
+        float c = dequantize((float)comp.c);
+        float d = dequantize((float)comp.d);
+
+        float pb_avg = Arith40_chroma_of_index(comp.pb_avg);
+        float pr_avg = Arith40_chroma_of_index(comp.pr_avg);
+
+        /* Apply dequantization */
+        cvQuad->cv1.y = a - b - c + d;
+        cvQuad->cv1.pb = pb_avg;
+        cvQuad->cv1.pr = pr_avg;
+
+        cvQuad->cv2.y = a - b + c - d;
+        cvQuad->cv2.pb = pb_avg;
+        cvQuad->cv2.pr = pr_avg;
+
+        cvQuad->cv3.y = a + b - c - d;
+        cvQuad->cv3.pb = pb_avg;
+        cvQuad->cv3.pr = pr_avg;
+
+        cvQuad->cv4.y = a + b + c + d;
+        cvQuad->cv4.pb = pb_avg;
+        cvQuad->cv4.pr = pr_avg;
+}
+
 /************* CompressedtoCvBlock **************
  * 
  * Converts a Compressed block to a ComponentVideo block.
@@ -130,20 +257,15 @@ Compressed DCT(ComponentVideo cv1, ComponentVideo cv2,
  * Notes:
  *      - CRE if comp is NULL
  *      - cv1-cv4 will be freed manually with cvBlock outside the function
+ *      - thin wrapper around CompressedToCvQuad
  * 
  *************************************/
 CompVidBlock CompressedtoCvBlock(Compressed comp)
 {
         assert(comp != NULL);
 
-        float a = (float)comp->a / 511.0;
-
-        float b = dequantize((float)comp->b);
-        float c = dequantize((float)comp->c);
-        float d = dequantize((float)comp->d);
-
-        float pb_avg = Arith40_chroma_of_index(comp->pb_avg);
-        float pr_avg = Arith40_chroma_of_index(comp->pr_avg);
+        struct CompVidQuad cvQuad;
+        CompressedToCvQuad(*comp, &cvQuad);
 
         ComponentVideo cv1, cv2, cv3, cv4;
         NEW(cv1);
@@ -151,22 +273,10 @@ CompVidBlock CompressedtoCvBlock(Compressed comp)
         NEW(cv3);
         NEW(cv4);
 
-        /* Apply dequantization */
-        cv1->y = a - b - c + d;
-        cv1->pb = pb_avg;
-        cv1->pr = pr_avg;
-
-        cv2->y = a - b + c - d;
-        cv2->pb = pb_avg;
-        cv2->pr = pr_avg;
-
-        cv3->y = a + b - c - d;
-        cv3->pb = pb_avg;
-        cv3->pr = pr_avg;
-
-        cv4->y = a + b + c + d;
-        cv4->pb = pb_avg;
-        cv4->pr = pr_avg;
+        *cv1 = cvQuad.cv1;
+        *cv2 = cvQuad.cv2;
+        *cv3 = cvQuad.cv3;
+        *cv4 = cvQuad.cv4;
 
         return CompVidToBlock(cv1, cv2, cv3, cv4);
 }
@@ -24,6 +24,11 @@
 #include "arith40.h"
 #include "helpers.h"
 
+struct ComponentVideo RGBtoCompVidVal(struct RGB rgb);
+void rgbQuadToCvQuad(const struct rgbQuad *quad, struct CompVidQuad *cvQuad);
+struct Compressed DCTval(const struct CompVidQuad *cvQuad);
+void CompressedToCvQuad(struct Compressed comp, struct CompVidQuad *cvQuad);
+
 ComponentVideo RGBtoCompVid(RGB rgb);
 CompVidBlock rgbBlockToCvBlock(rgbBlock rgbBlock);
 Compressed DCT(ComponentVideo cv1, ComponentVideo cv2,
@@ -13,6 +13,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include "assert.h"
 #include "except.h"
 #include "mem.h"
@@ -26,9 +29,142 @@
 #include "rgbConversion.h"
 #include "codeword.h"
 #include "compVidConversion.h"
+#include "packedImage.h"
+#include "encodeKernel.h"
+#include "decodeKernel.h"
+#include "threadPool.h"
+#include "codewordIO.h"
+#include "stats.h"
+#include "chunked.h"
+#include "mappedFile.h"
+#include "pipeline.h"
 #include "compress40.h"
 #include "helpers.h"
 
+struct Compress40Options compress40Options = { 1, 0, 0, 0, 0, 0, 0, 0, 1, 
+                                               { 0, 0, 0, 0 } };
+
+/* Each thread is given about this many bands to balance the load */
+#define BANDS_PER_THREAD 8
+
+/* With --pipeline, an image moves through STRIP_SLOTS buffers of 
+ * STRIP_ROWS block rows each */
+#define STRIP_ROWS 16
+#define STRIP_SLOTS 4
+
+/* A compression split into bands of block rows, one task per band. 
+ * The codewords are left in file order when fileOrder is set, else in
+ * host order. */
+struct EncodeBands
+{
+        PackedImage image;
+        unsigned blocks, blockRows, rowsPerBand;
+        int fileOrder;
+        struct Compressed **scratch;
+        uint32_t *out;
+};
+
+static Bitpack_mode packMode(void);
+static void encodeImageRow(PackedImage image, unsigned blockRow, 
+                           unsigned blocks, struct Compressed *comps);
+static void decodeImageRow(const uint32_t *words, unsigned blocks,
+                           PackedImage pixmap, unsigned blockRow);
+static void encodeStream(FILE *input);
+static void encodeSerial(PackedImage image, unsigned width, 
+                         unsigned height);
+static void encodeParallel(PackedImage image, unsigned width, 
+                           unsigned height, unsigned threads);
+static void encodeChunked(PackedImage image, unsigned width, 
+                          unsigned height, unsigned threads);
+static void encodeBands(struct EncodeBands *bands, PackedImage image, 
+                        unsigned width, unsigned height, unsigned threads);
+static void encodeBand(unsigned band, unsigned worker, void *cl);
+
+/* A decompression split into bands of block rows, one task per band.
+ * The codewords come from body when the input is mapped or had to be 
+ * read whole, otherwise each band preads them from fd at offset. */
+struct DecodeBands
+{
+        PackedImage pixmap;
+        unsigned blocks, blockRows, rowsPerBand;
+        int fd;
+        off_t offset;
+        const unsigned char *body;
+        unsigned char **bytes;
+        uint32_t **words;
+};
+
+/* Where a decompression's codewords come from: input itself in format 2,
+ * read from mapped at next when input is a mapped file, or the chunks of
+ * format 3 when chunked is not NULL */
+struct Source
+{
+        FILE *input;
+        ChunkedReader chunked;
+        MappedFile mapped;
+        const unsigned char *next;
+};
+
+/* A decompression of format 3, one task per chunk */
+struct DecodeChunks
+{
+        PackedImage pixmap;
+        ChunkedReader chunked;
+        unsigned char **bytes;
+        uint32_t **words;
+};
+
+/* A compression or decompression streamed through Pipeline_run in strips
+ * of block rows. Each slot holds a strip's pixels and its codewords; 
+ * source is set when decompressing, and input and header when 
+ * compressing. slot is the strip being computed. */
+struct Strips
+{
+        struct Source *source;
+        FILE *input;
+        struct PpmHeader header;
+        unsigned width, blocks, blockRows;
+        PackedImage *pixels;
+        uint32_t **words;
+        struct Compressed **scratch;
+        unsigned threads, slot;
+};
+
+static void encodePipelined(FILE *input);
+static void readPixelStrip(unsigned strip, unsigned slot, void *cl);
+static void encodeStrip(unsigned strip, unsigned slot, void *cl);
+static void encodeStripRow(unsigned row, unsigned worker, void *cl);
+static void writeWordStrip(unsigned strip, unsigned slot, void *cl);
+static void decodePipelined(struct Source *source, unsigned width, 
+                            unsigned height);
+static void readWordStrip(unsigned strip, unsigned slot, void *cl);
+static void decodeStrip(unsigned strip, unsigned slot, void *cl);
+static void decodeStripRow(unsigned row, unsigned worker, void *cl);
+static void writePixelStrip(unsigned strip, unsigned slot, void *cl);
+static void newStrips(struct Strips *strips, unsigned width, 
+                      unsigned pixelWidth, unsigned height);
+static void freeStrips(struct Strips *strips);
+static unsigned stripRows(struct Strips *strips, unsigned strip);
+
+static void decodeStream(struct Source *source, unsigned width, 
+                         unsigned height);
+static void decodeSerial(struct Source *source, PackedImage pixmap);
+static void decodeParallel(struct Source *source, PackedImage pixmap, 
+                           unsigned threads);
+static void decodeBand(unsigned band, unsigned worker, void *cl);
+static void decodeChunks(ChunkedReader chunked, PackedImage pixmap, 
+                         unsigned threads);
+static void decodeChunk(unsigned chunk, unsigned worker, void *cl);
+static void decodeCrop(struct Source *source, unsigned width, 
+                       unsigned height);
+static void decodeScaled(struct Source *source, unsigned width, 
+                         unsigned height);
+static void readRow(struct Source *source, uint32_t *words, 
+                    unsigned blocks);
+static void countRead(struct Source *source, uint64_t words);
+static off_t bodyOffset(FILE *input);
+static void readAt(int fd, unsigned char *dest, size_t want, off_t at);
+
 /********** compress40 ********
  * 
  * Compresses a PPM image given from the input file
@@ -44,32 +180,67 @@
  **********************************/
 extern void compress40(FILE *input)
 {
-        A2Methods_T methods = uarray2_methods_plain;
-        assert(methods != NULL);
-        Pnm_ppm image = Pnm_ppmread(input, methods);
+        encodeSetEngine(compress40Options.exact ? ENCODE_EXACT 
+                                                : ENCODE_FIXED);
+
+        if (compress40Options.stream) {
+                encodeStream(input);
+                return;
+        }
+        if (compress40Options.pipeline) {
+                encodePipelined(input);
+                return;
+        }
+
+        /* A raw PPM in a regular file is compressed where it lies, unless
+         * it is to be tiled */
+        struct Stats_timer timer;
+        Stats_start(&timer);
+        PackedImage image = NULL;
+        unsigned fullWidth = 0, fullHeight = 0;
+        if (compress40Options.tiled) {
+                image = PackedImage_readTiled(input, 
+                                              compress40Options.threads,
+                                              &fullWidth, &fullHeight);
+        } else {
+                image = PackedImage_map(input);
+        }
+        if (image == NULL) {
+                image = PackedImage_read(input, 
+                                         compress40Options.threads);
+        }
+        Stats_stop(STATS_READ, &timer);
+
+        /* A tiled image is trimmed already, so the size read is the
+         * header's */
+        if (!compress40Options.tiled) {
+                fullWidth = image->width;
+                fullHeight = image->height;
+        }
         
         /* Calculates and trim the width and height of the compressed image */
         int height = image->height - (1 & image->height);
         int width = image->width - (1 & image->width);
 
-        fprintf(stdout, "COMP40 Compressed image format 2\n%u %u\n", 
-                width, height);
+        Stats_count(STATS_BYTES_IN, (uint64_t)fullWidth * fullHeight * 3);
+        if (compress40Options.entropy) {
+                encodeChunked(image, width, height, 
+                              compress40Options.threads);
+                PackedImage_free(&image);
+                return;
+        }
 
-        /* Processes each 2x2 block of pixels in the image */
-        for (int row = 0; row < height; row += 2) {
-                for (int col = 0; col < width; col += 2) {
-                        rgbBlock rgbBlock = imageToRgbBlock(image, col, row);
-                        CompVidBlock cvBlock = rgbBlockToCvBlock(rgbBlock);
-                        Compressed comp = DCT(cvBlock->cv1, cvBlock->cv2, 
-                                              cvBlock->cv3, cvBlock->cv4);
-                        uint64_t word = codeWord(comp);
-                        writeCompressed(word);
+        writeCompressedHeader(stdout, width, height);
+        Stats_count(STATS_BYTES_OUT, (uint64_t)width * height);
 
-                        freeCompression(rgbBlock, cvBlock);    
-                }
+        if (compress40Options.threads > 1) {
+                encodeParallel(image, width, height, 
+                               compress40Options.threads);
+        } else {
+                encodeSerial(image, width, height);
         }
 
-        Pnm_ppmfree(&image);
+        PackedImage_free(&image);
 }
 
 /********** decompress40 ********
@@ -82,37 +253,1412 @@ extern void compress40(FILE *input)
  * 
  * Return: none
  *
- * Notes:  none
+ * Notes:
+ *      - reads format 2 or format 3, whatever the options say
  *      
  **********************************/
 extern void decompress40(FILE *input)
 {
-        Pnm_ppm pixmap = readHeader(input);
+        unsigned width, height;
+        int format = readCompressedHeader(input, &width, &height);
+        assert(width % 2 == 0 && height % 2 == 0);
+
+        decodeSetEngine(compress40Options.exact ? DECODE_EXACT 
+                                                : DECODE_TABLES);
+        PackedImage_setFormat(compress40Options.plain ? PPM_PLAIN : PPM_RAW);
+
+        struct Source source = { input, NULL, NULL, NULL };
+        if (format == 3) {
+                source.chunked = ChunkedReader_open(input, width, height);
+        } else if (compress40Options.crop.width == 0) {
+                source.mapped = MappedFile_input(input);
+        }
+        /* A file cut short is read through the stream, where missing
+         * codewords read as 0xff */
+        if (source.mapped != NULL) {
+                size_t bytes = (size_t)width * height;
+                long body = ftell(input);
+
+                assert(body >= 0);
+                if ((size_t)body + bytes <= source.mapped->size) {
+                        source.next = source.mapped->bytes + body;
+                } else {
+                        MappedFile_close(&source.mapped);
+                }
+        }
+
+        if (compress40Options.crop.width > 0) {
+                decodeCrop(&source, width, height);
+        } else if (compress40Options.scale > 1) {
+                decodeScaled(&source, width, height);
+        } else if (compress40Options.stream) {
+                decodeStream(&source, width, height);
+        } else if (compress40Options.pipeline) {
+                decodePipelined(&source, width, height);
+        } else {
+                /* Into a regular file, the pixels are decoded in place,
+                 * unless they are tiled */
+                PackedImage pixmap = NULL;
+                if (compress40Options.tiled) {
+                        pixmap = PackedImage_newTiled(width, height);
+                } else {
+                        pixmap = PackedImage_mapOutput(stdout, width, 
+                                                       height);
+                }
+                if (pixmap == NULL) {
+                        pixmap = PackedImage_new(width, height);
+                }
+
+                if (compress40Options.threads > 1) {
+                        decodeParallel(&source, pixmap, 
+                                       compress40Options.threads);
+                } else {
+                        decodeSerial(&source, pixmap);
+                }
+
+                struct Stats_timer timer;
+                Stats_start(&timer);
+                if (pixmap->mapped == NULL) {
+                        PackedImage_write(stdout, pixmap);
+                }
+                PackedImage_free(&pixmap);
+                Stats_stop(STATS_WRITE, &timer);
+                countRead(&source, (uint64_t)width * height / 4);
+                Stats_count(STATS_BYTES_OUT, (uint64_t)width * height * 3);
+        }
+
+        if (source.chunked != NULL) {
+                ChunkedReader_close(&source.chunked);
+        }
+        if (source.mapped != NULL) {
+                MappedFile_close(&source.mapped);
+        }
+}
+
+/********** decodeStream ********
+ * 
+ * Decodes a compressed image one row of codewords at a time, writing
+ * each pair of decoded rows as soon as it is ready
+ *
+ * Parameters:
+ *      struct Source *source: Where the codewords come from
+ *      unsigned width:        The width of the image
+ *      unsigned height:       The height of the image
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - the PPM header goes out before any codeword is read
+ *      - uses memory for one row of blocks and two rows of pixels, 
+ *        however tall the image is, plus one chunk in format 3
+ *      
+ **********************************/
+static void decodeStream(struct Source *source, unsigned width, 
+                         unsigned height)
+{
+        PackedImage_writeHeader(stdout, width, height);
+        fflush(stdout);
+
+        PackedImage strip = PackedImage_new(width, 2);
+        unsigned blocks = width / 2;
+        uint32_t *words = ALLOC((blocks + 1) * sizeof(*words));
+
+        struct Stats_timer timer;
+        for (unsigned row = 0; row < height; row += 2) {
+                readRow(source, words, blocks);
+
+                Stats_start(&timer);
+                decodeBlockRow(words, blocks, strip->pixels, 
+                               strip->pixels + strip->stride);
+                Stats_stop(STATS_DECODE, &timer);
+                Stats_decoded(words, blocks);
+
+                Stats_start(&timer);
+                PackedImage_writeRows(stdout, strip->pixels, strip->stride,
+                                      width, 2);
+                Stats_stop(STATS_WRITE, &timer);
+        }
+        countRead(source, (uint64_t)width * height / 4);
+        Stats_count(STATS_BYTES_OUT, (uint64_t)width * height * 3);
+
+        FREE(words);
+        PackedImage_free(&strip);
+}
+
+/********** decodePipelined ********
+ * 
+ * Decodes a compressed image in strips of block rows while a reader 
+ * thread reads the codewords of later strips and a writer thread writes
+ * the pixels of earlier ones
+ *
+ * Parameters:
+ *      struct Source *source: Where the codewords come from
+ *      unsigned width:        The width of the image
+ *      unsigned height:       The height of the image
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - the PPM header goes out before any codeword is read
+ *      - uses memory for STRIP_SLOTS strips, however tall the image is,
+ *        plus one chunk in format 3
+ *      - each strip's block rows are decoded on compress40Options.threads
+ *        threads
+ *      
+ **********************************/
+static void decodePipelined(struct Source *source, unsigned width, 
+                            unsigned height)
+{
+        PackedImage_writeHeader(stdout, width, height);
+        fflush(stdout);
+
+        struct Strips strips;
+        strips.source = source;
+        newStrips(&strips, width, width, height);
+
+        unsigned count = (strips.blockRows + STRIP_ROWS - 1) / STRIP_ROWS;
+        Pipeline_run(count, STRIP_SLOTS, readWordStrip, decodeStrip, 
+                     writePixelStrip, &strips);
+        countRead(source, (uint64_t)width * height / 4);
+        Stats_count(STATS_BYTES_OUT, (uint64_t)width * height * 3);
+
+        freeStrips(&strips);
+}
+
+/********** readWordStrip ********
+ * 
+ * Reads the codewords of one strip, on the pipeline's reader thread
+ *
+ * Parameters:
+ *      unsigned strip: Which strip to read
+ *      unsigned slot:  Which slot it goes in
+ *      void *cl:       The struct Strips being decompressed
+ * 
+ * Return: none
+ *
+ * Notes: none
+ *      
+ **********************************/
+static void readWordStrip(unsigned strip, unsigned slot, void *cl)
+{
+        struct Strips *strips = cl;
+        unsigned rows = stripRows(strips, strip);
+
+        for (unsigned row = 0; row < rows; row++) {
+                readRow(strips->source, strips->words[slot] + 
+                                        (size_t)row * strips->blocks,
+                        strips->blocks);
+        }
+}
+
+/********** decodeStrip ********
+ * 
+ * Decodes the codewords of one strip into its pixels
+ *
+ * Parameters:
+ *      unsigned strip: Which strip to decode
+ *      unsigned slot:  Which slot holds it
+ *      void *cl:       The struct Strips being decompressed
+ * 
+ * Return: none
+ *
+ * Notes: none
+ *      
+ **********************************/
+static void decodeStrip(unsigned strip, unsigned slot, void *cl)
+{
+        struct Strips *strips = cl;
+
+        strips->slot = slot;
+        ThreadPool_run(strips->threads, stripRows(strips, strip), 
+                       decodeStripRow, strips);
+}
+
+/********** decodeStripRow ********
+ * 
+ * Decodes one block row of the strip being computed
+ *
+ * Parameters:
+ *      unsigned row:    Which block row of the strip
+ *      unsigned worker: Which thread is running (unused)
+ *      void *cl:        The struct Strips being decompressed
+ * 
+ * Return: none
+ *
+ * Notes: none
+ *      
+ **********************************/
+static void decodeStripRow(unsigned row, unsigned worker, void *cl)
+{
+        struct Strips *strips = cl;
+        PackedImage pixels = strips->pixels[strips->slot];
+        const uint32_t *words = strips->words[strips->slot] + 
+                                (size_t)row * strips->blocks;
+        unsigned char *top = pixels->pixels + 2 * row * pixels->stride;
+        struct Stats_timer timer;
+        (void)worker;
+
+        Stats_start(&timer);
+        decodeBlockRow(words, strips->blocks, top, top + pixels->stride);
+        Stats_stop(STATS_DECODE, &timer);
+        Stats_decoded(words, strips->blocks);
+}
+
+/********** writePixelStrip ********
+ * 
+ * Writes the pixels of one strip, on the pipeline's writer thread
+ *
+ * Parameters:
+ *      unsigned strip: Which strip to write
+ *      unsigned slot:  Which slot holds it
+ *      void *cl:       The struct Strips being decompressed
+ * 
+ * Return: none
+ *
+ * Notes: none
+ *      
+ **********************************/
+static void writePixelStrip(unsigned strip, unsigned slot, void *cl)
+{
+        struct Strips *strips = cl;
+        PackedImage pixels = strips->pixels[slot];
+        struct Stats_timer timer;
+
+        Stats_start(&timer);
+        PackedImage_writeRows(stdout, pixels->pixels, pixels->stride,
+                              strips->width, 2 * stripRows(strips, strip));
+        Stats_stop(STATS_WRITE, &timer);
+}
+
+/********** newStrips ********
+ * 
+ * Sets up the slots of a pipelined compression or decompression
+ *
+ * Parameters:
+ *      struct Strips *strips: The strips, with source or input and 
+ *                             header already set
+ *      unsigned width:        The trimmed (even) width of the image
+ *      unsigned pixelWidth:   The width of a row of pixels as read or
+ *                             written, which may be one more
+ *      unsigned height:       The trimmed (even) height of the image
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - scratch is set up for compressing, with one row of Compressed 
+ *        values a thread
+ *      
+ **********************************/
+static void newStrips(struct Strips *strips, unsigned width, 
+                      unsigned pixelWidth, unsigned height)
+{
+        unsigned threads = compress40Options.threads;
+
+        strips->width = width;
+        strips->blocks = width / 2;
+        strips->blockRows = height / 2;
+        strips->threads = threads;
+        strips->pixels = ALLOC(STRIP_SLOTS * sizeof(*strips->pixels));
+        strips->words = ALLOC(STRIP_SLOTS * sizeof(*strips->words));
+        for (unsigned i = 0; i < STRIP_SLOTS; i++) {
+                strips->pixels[i] = PackedImage_new(pixelWidth, 
+                                                    2 * STRIP_ROWS);
+                strips->words[i] = ALLOC(((size_t)strips->blocks * 
+                                          STRIP_ROWS + 1) * 
+                                         sizeof(*strips->words[i]));
+        }
+        strips->scratch = ALLOC(threads * sizeof(*strips->scratch));
+        for (unsigned i = 0; i < threads; i++) {
+                strips->scratch[i] = ALLOC((strips->blocks + 1) * 
+                                           sizeof(struct Compressed));
+        }
+}
+
+/********** freeStrips ********
+ * 
+ * Frees the slots of a pipelined compression or decompression
+ *
+ * Parameters:
+ *      struct Strips *strips: The strips set up by newStrips
+ * 
+ * Return: none
+ *
+ * Notes: none
+ *      
+ **********************************/
+static void freeStrips(struct Strips *strips)
+{
+        for (unsigned i = 0; i < strips->threads; i++) {
+                FREE(strips->scratch[i]);
+        }
+        for (unsigned i = 0; i < STRIP_SLOTS; i++) {
+                FREE(strips->words[i]);
+                PackedImage_free(&strips->pixels[i]);
+        }
+        FREE(strips->scratch);
+        FREE(strips->words);
+        FREE(strips->pixels);
+}
+
+/********** stripRows ********
+ * 
+ * Counts the block rows in a strip
+ *
+ * Parameters:
+ *      struct Strips *strips: The strips
+ *      unsigned strip:        Which strip
+ * 
+ * Return: STRIP_ROWS, or fewer for the last strip
+ *
+ * Notes: none
+ *      
+ **********************************/
+static unsigned stripRows(struct Strips *strips, unsigned strip)
+{
+        unsigned left = strips->blockRows - strip * STRIP_ROWS;
+        return left < STRIP_ROWS ? left : STRIP_ROWS;
+}
+
+/********** decodeSerial ********
+ * 
+ * Reads codewords in order and decodes them one block row at a time
+ *
+ * Parameters:
+ *      struct Source *source: Where the codewords come from
+ *      PackedImage pixmap:    The image to fill
+ * 
+ * Return: none
+ *
+ * Notes: none
+ *      
+ **********************************/
+static void decodeSerial(struct Source *source, PackedImage pixmap)
+{
         uint64_t countBlocks = 0;
 
+        unsigned blocks = pixmap->width / 2;
+        uint32_t *words = ALLOC((blocks + 1) * sizeof(*words));
+
+        struct Stats_timer timer;
         for (unsigned row = 0; row < pixmap->height; row += 2) {
-                for (unsigned col = 0; col < pixmap->width; col += 2) {
-                        uint64_t word = getCodeword(input);
-                        Compressed comp = decodeWord(word);
-                        CompVidBlock cvBlock = CompressedtoCvBlock(comp);
-                        rgbBlock rgbBlock = CompVidBlockToRgbBlock(cvBlock);
-                        RGBtoImage(pixmap, rgbBlock->rgb1, col, row);
-                        RGBtoImage(pixmap, rgbBlock->rgb2, col + 1, row);
-                        RGBtoImage(pixmap, rgbBlock->rgb3, col, row + 1);
-                        RGBtoImage(pixmap, rgbBlock->rgb4, col + 1, row + 1);
-
-                        countBlocks++;
-
-                        freeDecompression(comp, cvBlock, rgbBlock);
-                }
+                readRow(source, words, blocks);
+
+                Stats_start(&timer);
+                decodeImageRow(words, blocks, pixmap, row / 2);
+                Stats_stop(STATS_DECODE, &timer);
+                Stats_decoded(words, blocks);
+
+                countBlocks += blocks;
         }
 
+        FREE(words);
+
         /* Count blocks to make sure that the amount of pixels fit the
          * dimensions of the image */
         if (countBlocks < ((pixmap->width * pixmap->height) / 4)) {
                 exit(EXIT_FAILURE);
         }
-        
-        Pnm_ppmwrite(stdout, pixmap);
-        Pnm_ppmfree(&pixmap);
+}
+
+/********** decodeParallel ********
+ * 
+ * Decodes the codewords of an image on several threads
+ *
+ * Parameters:
+ *      struct Source *source: Where the codewords come from
+ *      PackedImage pixmap:    The image to fill
+ *      unsigned threads:      The number of threads to use
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if the input holds fewer codewords than the header says
+ *      - a mapped file is decoded in place; otherwise a regular file is
+ *        read with pread, each band fetching only its own codewords, and
+ *        any other stream is read whole first
+ *      - format 3 is decoded a chunk per task instead
+ *      
+ **********************************/
+static void decodeParallel(struct Source *source, PackedImage pixmap, 
+                           unsigned threads)
+{
+        if (source->chunked != NULL) {
+                decodeChunks(source->chunked, pixmap, threads);
+                return;
+        }
+
+        FILE *input = source->input;
+        struct DecodeBands bands;
+        bands.pixmap = pixmap;
+        bands.blocks = pixmap->width / 2;
+        bands.blockRows = pixmap->height / 2;
+        bands.rowsPerBand = bands.blockRows / (threads * BANDS_PER_THREAD);
+        if (bands.rowsPerBand == 0) {
+                bands.rowsPerBand = 1;
+        }
+
+        size_t rowBytes = (size_t)bands.blocks * 4;
+        unsigned char *buffer = NULL;
+        bands.fd = fileno(input);
+        bands.body = source->next;
+        bands.offset = bodyOffset(input);
+        if (bands.body == NULL && bands.offset < 0) {
+                size_t bodyBytes = rowBytes * bands.blockRows;
+                struct Stats_timer timer;
+                buffer = ALLOC(bodyBytes + 1);
+                Stats_start(&timer);
+                size_t read = fread(buffer, 1, bodyBytes, input);
+                Stats_stop(STATS_READ, &timer);
+                assert(read == bodyBytes);
+                bands.body = buffer;
+        }
+
+        bands.bytes = ALLOC(threads * sizeof(*bands.bytes));
+        bands.words = ALLOC(threads * sizeof(*bands.words));
+        for (unsigned i = 0; i < threads; i++) {
+                bands.bytes[i] = ALLOC(rowBytes * bands.rowsPerBand + 1);
+                bands.words[i] = ALLOC((bands.blocks + 1) * 
+                                       sizeof(uint32_t));
+        }
+
+        unsigned count = (bands.blockRows + bands.rowsPerBand - 1) / 
+                         bands.rowsPerBand;
+        ThreadPool_run(threads, count, decodeBand, &bands);
+
+        for (unsigned i = 0; i < threads; i++) {
+                FREE(bands.bytes[i]);
+                FREE(bands.words[i]);
+        }
+        FREE(bands.bytes);
+        FREE(bands.words);
+        if (buffer != NULL) {
+                FREE(buffer);
+        }
+}
+
+/********** decodeBand ********
+ * 
+ * Decodes one band of block rows into its rows of the image
+ *
+ * Parameters:
+ *      unsigned band:   Which band to decode
+ *      unsigned worker: Which thread is running, to pick scratch storage
+ *      void *cl:        The struct DecodeBands being decoded
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if the band's codewords cannot be read in full
+ *      
+ **********************************/
+static void decodeBand(unsigned band, unsigned worker, void *cl)
+{
+        struct DecodeBands *bands = cl;
+        PackedImage pixmap = bands->pixmap;
+        uint32_t *words = bands->words[worker];
+        size_t rowBytes = (size_t)bands->blocks * 4;
+
+        unsigned first = band * bands->rowsPerBand;
+        unsigned last = first + bands->rowsPerBand;
+        if (last > bands->blockRows) {
+                last = bands->blockRows;
+        }
+
+        const unsigned char *bytes;
+        struct Stats_timer timer;
+        if (bands->body != NULL) {
+                bytes = bands->body + first * rowBytes;
+        } else {
+                Stats_start(&timer);
+                readAt(bands->fd, bands->bytes[worker], 
+                       (last - first) * rowBytes, 
+                       bands->offset + (off_t)first * rowBytes);
+                Stats_stop(STATS_READ, &timer);
+                bytes = bands->bytes[worker];
+        }
+
+        for (unsigned blockRow = first; blockRow < last; blockRow++) {
+                Stats_start(&timer);
+                Codewords_load(bytes, bands->blocks, words);
+                decodeImageRow(words, bands->blocks, pixmap, blockRow);
+                Stats_stop(STATS_DECODE, &timer);
+                Stats_decoded(words, bands->blocks);
+                bytes += rowBytes;
+        }
+}
+
+/********** decodeChunks ********
+ * 
+ * Decodes the chunks of a format 3 image on several threads
+ *
+ * Parameters:
+ *      ChunkedReader chunked: The image's chunks, none read yet
+ *      PackedImage pixmap:    The image to fill
+ *      unsigned threads:      The number of threads to use
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - a regular file is read with pread, each chunk fetching only its
+ *        own bytes; any other stream is read whole first
+ *      
+ **********************************/
+static void decodeChunks(ChunkedReader chunked, PackedImage pixmap, 
+                         unsigned threads)
+{
+        struct DecodeChunks job;
+        job.pixmap = pixmap;
+        job.chunked = chunked;
+        ChunkedReader_load(chunked);
+
+        size_t chunkBytes = ChunkedReader_maxChunkBytes(chunked);
+        size_t chunkWords = (size_t)ChunkedReader_rowsPerChunk(chunked) * 
+                            (pixmap->width / 2);
+        job.bytes = ALLOC(threads * sizeof(*job.bytes));
+        job.words = ALLOC(threads * sizeof(*job.words));
+        for (unsigned i = 0; i < threads; i++) {
+                job.bytes[i] = ALLOC(chunkBytes + 1);
+                job.words[i] = ALLOC((chunkWords + 1) * sizeof(uint32_t));
+        }
+
+        ThreadPool_run(threads, ChunkedReader_chunks(chunked), decodeChunk,
+                       &job);
+
+        for (unsigned i = 0; i < threads; i++) {
+                FREE(job.bytes[i]);
+                FREE(job.words[i]);
+        }
+        FREE(job.bytes);
+        FREE(job.words);
+}
+
+/********** decodeChunk ********
+ * 
+ * Decodes one chunk of a format 3 image into its rows of the image
+ *
+ * Parameters:
+ *      unsigned chunk:  Which chunk to decode
+ *      unsigned worker: Which thread is running, to pick scratch storage
+ *      void *cl:        The struct DecodeChunks being decoded
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if the chunk cannot be read in full or does not decode
+ *      
+ **********************************/
+static void decodeChunk(unsigned chunk, unsigned worker, void *cl)
+{
+        struct DecodeChunks *job = cl;
+        PackedImage pixmap = job->pixmap;
+        unsigned blocks = pixmap->width / 2;
+        unsigned rowsPerChunk = ChunkedReader_rowsPerChunk(job->chunked);
+        const uint32_t *words = job->words[worker];
+
+        unsigned first = chunk * rowsPerChunk;
+        unsigned last = first + rowsPerChunk;
+        if (last > pixmap->height / 2) {
+                last = pixmap->height / 2;
+        }
+
+        ChunkedReader_decodeChunk(job->chunked, chunk, job->bytes[worker],
+                                  job->words[worker]);
+
+        struct Stats_timer timer;
+        for (unsigned blockRow = first; blockRow < last; blockRow++) {
+                Stats_start(&timer);
+                decodeImageRow(words, blocks, pixmap, blockRow);
+                Stats_stop(STATS_DECODE, &timer);
+                Stats_decoded(words, blocks);
+                words += blocks;
+        }
+}
+
+/********** decodeCrop ********
+ * 
+ * Decodes only the blocks covering a rectangle of the image and writes
+ * that rectangle as the output image
+ *
+ * Parameters:
+ *      struct Source *source: Where the codewords come from
+ *      unsigned width:        The width of the whole image
+ *      unsigned height:       The height of the whole image
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if the rectangle in compress40Options.crop is not inside 
+ *        the image, or a regular file ends before its last codeword
+ *      - a regular file is read with pread, fetching only the codewords
+ *        under the rectangle, or in format 3 only the chunks under it;
+ *        any other stream is read up to the last block row the 
+ *        rectangle touches
+ *      - decodes serially, in memory proportional to the crop's width
+ *        (or a chunk's size in format 3)
+ *      
+ **********************************/
+static void decodeCrop(struct Source *source, unsigned width, 
+                       unsigned height)
+{
+        FILE *input = source->input;
+        unsigned x = compress40Options.crop.x;
+        unsigned y = compress40Options.crop.y;
+        unsigned w = compress40Options.crop.width;
+        unsigned h = compress40Options.crop.height;
+        assert(x < width && y < height);
+        assert(w > 0 && w <= width - x && h > 0 && h <= height - y);
+
+        unsigned blocks = width / 2;
+        unsigned firstBlock = x / 2;
+        unsigned span = (x + w + 1) / 2 - firstBlock;
+        unsigned firstRow = y / 2;
+        unsigned lastRow = (y + h + 1) / 2;
+
+        PackedImage strip = PackedImage_new(2 * span, 2);
+        uint32_t *words = ALLOC((blocks + 1) * sizeof(*words));
+        unsigned char *bytes = ALLOC(span * 4 + 1);
+        const unsigned char *left = strip->pixels + 3 * (x - 2 * firstBlock);
+
+        off_t body = source->chunked != NULL ? -1 : bodyOffset(input);
+        if (source->chunked != NULL) {
+                ChunkedReader_seekRow(source->chunked, firstRow);
+        } else if (body < 0) {
+                for (unsigned row = 0; row < firstRow; row++) {
+                        Codewords_read(input, words, blocks);
+                }
+        }
+
+        struct Stats_timer timer;
+        PackedImage_writeHeader(stdout, w, h);
+        for (unsigned blockRow = firstRow; blockRow < lastRow; blockRow++) {
+                const uint32_t *slice = words;
+
+                if (body >= 0) {
+                        Stats_start(&timer);
+                        readAt(fileno(input), bytes, span * 4, body + 
+                               ((off_t)blockRow * blocks + firstBlock) * 4);
+                        Codewords_load(bytes, span, words);
+                        Stats_stop(STATS_READ, &timer);
+                } else {
+                        readRow(source, words, blocks);
+                        slice += firstBlock;
+                }
+
+                Stats_start(&timer);
+                decodeBlockRow(slice, span, strip->pixels, 
+                               strip->pixels + strip->stride);
+                Stats_stop(STATS_DECODE, &timer);
+                Stats_decoded(slice, span);
+
+                /* The first and last block rows may stick out of the crop */
+                Stats_start(&timer);
+                for (unsigned half = 0; half < 2; half++) {
+                        unsigned row = 2 * blockRow + half;
+                        if (row >= y && row < y + h) {
+                                PackedImage_writeRows(stdout, left + 
+                                        half * strip->stride, 
+                                        strip->stride, w, 1);
+                        }
+                }
+                Stats_stop(STATS_WRITE, &timer);
+        }
+        if (source->chunked == NULL) {
+                Stats_count(STATS_BYTES_IN, (uint64_t)(lastRow - firstRow) *
+                                            (body >= 0 ? span : blocks) * 4);
+        }
+        Stats_count(STATS_BYTES_OUT, (uint64_t)w * h * 3);
+
+        FREE(bytes);
+        FREE(words);
+        PackedImage_free(&strip);
+}
+
+/********** decodeScaled ********
+ * 
+ * Decodes a thumbnail of the image from the mean colour of each block
+ *
+ * Parameters:
+ *      struct Source *source: Where the codewords come from
+ *      unsigned width:        The width of the whole image
+ *      unsigned height:       The height of the whole image
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if compress40Options.scale is not 2, 4 or 8
+ *      - at 1/2 each codeword is one pixel; at 1/4 and 1/8 a pixel is the
+ *        rounded average of the 2x2 or 4x4 codewords' pixels, or of the 
+ *        part of that square inside the image at the right and bottom
+ *      - decodes serially, one row of codewords at a time
+ *      - --stats counts the clamps a full decode of each codeword
+ *        would make, as in the other modes
+ *      
+ **********************************/
+static void decodeScaled(struct Source *source, unsigned width, 
+                         unsigned height)
+{
+        unsigned scale = compress40Options.scale;
+        assert(scale == 2 || scale == 4 || scale == 8);
+
+        unsigned group = scale / 2;
+        unsigned blocks = width / 2;
+        unsigned blockRows = height / 2;
+        unsigned outWidth = (blocks + group - 1) / group;
+        unsigned outHeight = (blockRows + group - 1) / group;
+
+        uint32_t *words = ALLOC((blocks + 1) * sizeof(*words));
+        unsigned char *means = ALLOC((size_t)blocks * 3 + 1);
+        unsigned char *row = ALLOC((size_t)outWidth * 3 + 1);
+        unsigned *sums = CALLOC((size_t)outWidth * 3 + 1, sizeof(*sums));
+
+        struct Stats_timer timer;
+        PackedImage_writeHeader(stdout, outWidth, outHeight);
+        countRead(source, (uint64_t)blocks * blockRows);
+        Stats_count(STATS_BYTES_OUT, (uint64_t)outWidth * outHeight * 3);
+        for (unsigned blockRow = 0; blockRow < blockRows; blockRow++) {
+                readRow(source, words, blocks);
+
+                Stats_start(&timer);
+                decodeMeanRow(words, blocks, means);
+                Stats_stop(STATS_DECODE, &timer);
+                Stats_decoded(words, blocks);
+
+                if (group == 1) {
+                        Stats_start(&timer);
+                        PackedImage_writeRows(stdout, means, 0, blocks, 1);
+                        Stats_stop(STATS_WRITE, &timer);
+                        continue;
+                }
+
+                for (unsigned block = 0; block < blocks; block++) {
+                        unsigned *sum = sums + block / group * 3;
+                        const unsigned char *mean = means + 3 * block;
+
+                        sum[0] += mean[0];
+                        sum[1] += mean[1];
+                        sum[2] += mean[2];
+                }
+                if (blockRow % group != group - 1 && 
+                    blockRow != blockRows - 1) {
+                        continue;
+                }
+
+                unsigned tall = blockRow % group + 1;
+                for (size_t i = 0; i < (size_t)outWidth * 3; i++) {
+                        unsigned wide = blocks - (i / 3) * group;
+                        unsigned count = tall * (wide < group ? wide 
+                                                              : group);
+                        row[i] = (sums[i] + count / 2) / count;
+                        sums[i] = 0;
+                }
+                Stats_start(&timer);
+                PackedImage_writeRows(stdout, row, 0, outWidth, 1);
+                Stats_stop(STATS_WRITE, &timer);
+        }
+
+        FREE(sums);
+        FREE(row);
+        FREE(means);
+        FREE(words);
+}
+
+/********** readRow ********
+ * 
+ * Reads the next block row of codewords, in order from the first
+ *
+ * Parameters:
+ *      struct Source *source: Where the codewords come from
+ *      uint32_t *words:       Where the codewords go, in host order
+ *      unsigned blocks:       The number of codewords in a row
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if the input ends first
+ *      - a mapped file's bounds were checked when it was mapped
+ *      
+ **********************************/
+static void readRow(struct Source *source, uint32_t *words, 
+                    unsigned blocks)
+{
+        if (source->chunked != NULL) {
+                ChunkedReader_nextRow(source->chunked, words);
+                return;
+        }
+
+        struct Stats_timer timer;
+        Stats_start(&timer);
+        if (source->next != NULL) {
+                Codewords_load(source->next, blocks, words);
+                source->next += (size_t)blocks * 4;
+        } else {
+                Codewords_read(source->input, words, blocks);
+        }
+        Stats_stop(STATS_READ, &timer);
+}
+
+/********** countRead ********
+ * 
+ * Counts the bytes of codewords read from a source, for --stats
+ *
+ * Parameters:
+ *      struct Source *source: Where the codewords came from
+ *      uint64_t words:        How many codewords were read
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - counts four bytes a codeword in format 2; in format 3 the
+ *        reader counts each chunk as it reads it, so this does nothing
+ *      
+ **********************************/
+static void countRead(struct Source *source, uint64_t words)
+{
+        if (source->chunked == NULL) {
+                Stats_count(STATS_BYTES_IN, words * 4);
+        }
+}
+
+/********** bodyOffset ********
+ * 
+ * Finds where the codewords start when they can be read with pread
+ *
+ * Parameters:
+ *      FILE *input: The stream positioned after the header
+ * 
+ * Return: the offset of the first codeword in the file, or -1 if input
+ *         is not a regular file
+ *
+ * Notes: none
+ *      
+ **********************************/
+static off_t bodyOffset(FILE *input)
+{
+        struct stat info;
+
+        if (fstat(fileno(input), &info) != 0 || !S_ISREG(info.st_mode)) {
+                return -1;
+        }
+
+        off_t offset = ftell(input);
+        assert(offset >= 0);
+        return offset;
+}
+
+/********** readAt ********
+ * 
+ * Reads bytes from a given offset of a file with pread
+ *
+ * Parameters:
+ *      int fd:              The file
+ *      unsigned char *dest: Where the bytes go
+ *      size_t want:         How many bytes to read
+ *      off_t at:            The offset of the first byte
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if the file ends first
+ *      - safe to call from several threads at once
+ *      
+ **********************************/
+static void readAt(int fd, unsigned char *dest, size_t want, off_t at)
+{
+        size_t got = 0;
+
+        while (got < want) {
+                ssize_t n = pread(fd, dest + got, want - got, at + got);
+                assert(n > 0);
+                got += n;
+        }
+}
+
+/********** packMode ********
+ * 
+ * Returns how codewords are packed under the current options
+ *
+ * Parameters: none
+ * 
+ * Return: BITPACK_SATURATE with --saturate, else BITPACK_CHECKED
+ *
+ * Notes: none
+ *      
+ **********************************/
+static Bitpack_mode packMode(void)
+{
+        return compress40Options.saturate ? BITPACK_SATURATE 
+                                          : BITPACK_CHECKED;
+}
+
+/********** encodeImageRow ********
+ * 
+ * Encodes one block row of an image, in rows or tiles
+ *
+ * Parameters:
+ *      PackedImage image:        The image
+ *      unsigned blockRow:        Which block row
+ *      unsigned blocks:          How many blocks of it to encode
+ *      struct Compressed *comps: Storage for one value per block
+ * 
+ * Return: none
+ *
+ * Notes: none
+ *      
+ **********************************/
+static void encodeImageRow(PackedImage image, unsigned blockRow, 
+                           unsigned blocks, struct Compressed *comps)
+{
+        const unsigned char *top = image->pixels + 
+                                   2 * blockRow * image->stride;
+
+        if (image->tiled) {
+                encodeTileRow(top, blocks, comps);
+        } else {
+                encodeBlockRow(top, top + image->stride, blocks, comps);
+        }
+}
+
+/********** decodeImageRow ********
+ * 
+ * Decodes one block row of an image, in rows or tiles
+ *
+ * Parameters:
+ *      const uint32_t *words: One codeword per block
+ *      unsigned blocks:       The number of blocks in the row
+ *      PackedImage pixmap:    The image
+ *      unsigned blockRow:     Which block row
+ * 
+ * Return: none
+ *
+ * Notes: none
+ *      
+ **********************************/
+static void decodeImageRow(const uint32_t *words, unsigned blocks,
+                           PackedImage pixmap, unsigned blockRow)
+{
+        unsigned char *top = pixmap->pixels + 2 * blockRow * pixmap->stride;
+
+        if (pixmap->tiled) {
+                decodeTileRow(words, blocks, top);
+        } else {
+                decodeBlockRow(words, blocks, top, top + pixmap->stride);
+        }
+}
+
+/********** encodeStream ********
+ * 
+ * Compresses a PPM image two rows at a time as it is read, writing each
+ * row of codewords before reading the next two rows
+ *
+ * Parameters:
+ *      FILE *input: The stream containing the PPM image
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - uses memory for two rows of pixels and one row of blocks, however
+ *        tall the image is
+ *      - the last row of an image with an odd height is never read
+ *      
+ **********************************/
+static void encodeStream(FILE *input)
+{
+        struct PpmHeader header;
+        PackedImage_readHeader(input, &header);
+
+        unsigned width = header.width - (1 & header.width);
+        unsigned height = header.height - (1 & header.height);
+        writeCompressedHeader(stdout, width, height);
+
+        PackedImage strip = PackedImage_new(header.width, 2);
+        unsigned blocks = width / 2;
+        struct Compressed *comps = ALLOC((blocks + 1) * sizeof(*comps));
+        uint32_t *words = ALLOC((blocks + 1) * sizeof(*words));
+
+        Stats_count(STATS_BYTES_IN, (uint64_t)header.width * height * 3);
+        Stats_count(STATS_BYTES_OUT, (uint64_t)width * height);
+        struct Stats_timer timer;
+        for (unsigned row = 0; row < height; row += 2) {
+                Stats_start(&timer);
+                PackedImage_readRows(input, &header, strip->pixels, 
+                                     strip->stride, 2);
+                Stats_stop(STATS_READ, &timer);
+
+                Stats_start(&timer);
+                encodeBlockRow(strip->pixels, strip->pixels + strip->stride,
+                               blocks, comps);
+                Stats_stop(STATS_ENCODE, &timer);
+                Stats_encoded(comps, blocks);
+
+                Stats_start(&timer);
+                Codeword_packBatch(comps, words, blocks, packMode());
+                Stats_stop(STATS_PACK, &timer);
+
+                Stats_start(&timer);
+                Codewords_write(stdout, words, blocks);
+                Stats_stop(STATS_WRITE, &timer);
+        }
+
+        FREE(words);
+        FREE(comps);
+        PackedImage_free(&strip);
+}
+
+/********** encodePipelined ********
+ * 
+ * Compresses a PPM image in strips of block rows while a reader thread
+ * reads the pixels of later strips and a writer thread writes the 
+ * codewords of earlier ones
+ *
+ * Parameters:
+ *      FILE *input: The stream containing the PPM image
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - uses memory for STRIP_SLOTS strips, however tall the image is
+ *      - each strip's block rows are compressed on 
+ *        compress40Options.threads threads
+ *      - the last row of an image with an odd height is never read
+ *      
+ **********************************/
+static void encodePipelined(FILE *input)
+{
+        struct Strips strips;
+        strips.input = input;
+        PackedImage_readHeader(input, &strips.header);
+
+        unsigned width = strips.header.width - (1 & strips.header.width);
+        unsigned height = strips.header.height - (1 & strips.header.height);
+        writeCompressedHeader(stdout, width, height);
+        newStrips(&strips, width, strips.header.width, height);
+
+        Stats_count(STATS_BYTES_IN, (uint64_t)strips.header.width * height *
+                                    3);
+        Stats_count(STATS_BYTES_OUT, (uint64_t)width * height);
+        unsigned count = (strips.blockRows + STRIP_ROWS - 1) / STRIP_ROWS;
+        Pipeline_run(count, STRIP_SLOTS, readPixelStrip, encodeStrip, 
+                     writeWordStrip, &strips);
+
+        freeStrips(&strips);
+}
+
+/********** readPixelStrip ********
+ * 
+ * Reads the pixels of one strip, on the pipeline's reader thread
+ *
+ * Parameters:
+ *      unsigned strip: Which strip to read
+ *      unsigned slot:  Which slot it goes in
+ *      void *cl:       The struct Strips being compressed
+ * 
+ * Return: none
+ *
+ * Notes: none
+ *      
+ **********************************/
+static void readPixelStrip(unsigned strip, unsigned slot, void *cl)
+{
+        struct Strips *strips = cl;
+        PackedImage pixels = strips->pixels[slot];
+        struct Stats_timer timer;
+
+        Stats_start(&timer);
+        PackedImage_readRows(strips->input, &strips->header, 
+                             pixels->pixels, pixels->stride, 
+                             2 * stripRows(strips, strip));
+        Stats_stop(STATS_READ, &timer);
+}
+
+/********** encodeStrip ********
+ * 
+ * Compresses the pixels of one strip into its codewords
+ *
+ * Parameters:
+ *      unsigned strip: Which strip to compress
+ *      unsigned slot:  Which slot holds it
+ *      void *cl:       The struct Strips being compressed
+ * 
+ * Return: none
+ *
+ * Notes: none
+ *      
+ **********************************/
+static void encodeStrip(unsigned strip, unsigned slot, void *cl)
+{
+        struct Strips *strips = cl;
+
+        strips->slot = slot;
+        ThreadPool_run(strips->threads, stripRows(strips, strip), 
+                       encodeStripRow, strips);
+}
+
+/********** encodeStripRow ********
+ * 
+ * Compresses one block row of the strip being computed
+ *
+ * Parameters:
+ *      unsigned row:    Which block row of the strip
+ *      unsigned worker: Which thread is running, to pick scratch storage
+ *      void *cl:        The struct Strips being compressed
+ * 
+ * Return: none
+ *
+ * Notes: none
+ *      
+ **********************************/
+static void encodeStripRow(unsigned row, unsigned worker, void *cl)
+{
+        struct Strips *strips = cl;
+        PackedImage pixels = strips->pixels[strips->slot];
+        struct Compressed *comps = strips->scratch[worker];
+        const unsigned char *top = pixels->pixels + 
+                                   2 * row * pixels->stride;
+        uint32_t *words = strips->words[strips->slot] + 
+                          (size_t)row * strips->blocks;
+        struct Stats_timer timer;
+
+        Stats_start(&timer);
+        encodeBlockRow(top, top + pixels->stride, strips->blocks, comps);
+        Stats_stop(STATS_ENCODE, &timer);
+        Stats_encoded(comps, strips->blocks);
+
+        Stats_start(&timer);
+        Codeword_packBatch(comps, words, strips->blocks, packMode());
+        Stats_stop(STATS_PACK, &timer);
+}
+
+/********** writeWordStrip ********
+ * 
+ * Writes the codewords of one strip, on the pipeline's writer thread
+ *
+ * Parameters:
+ *      unsigned strip: Which strip to write
+ *      unsigned slot:  Which slot holds it
+ *      void *cl:       The struct Strips being compressed
+ * 
+ * Return: none
+ *
+ * Notes: none
+ *      
+ **********************************/
+static void writeWordStrip(unsigned strip, unsigned slot, void *cl)
+{
+        struct Strips *strips = cl;
+        struct Stats_timer timer;
+
+        Stats_start(&timer);
+        Codewords_write(stdout, strips->words[slot], 
+                        (size_t)strips->blocks * stripRows(strips, strip));
+        Stats_stop(STATS_WRITE, &timer);
+}
+
+/********** encodeSerial ********
+ * 
+ * Compresses the blocks of an image one block row at a time and writes 
+ * the codewords to stdout
+ *
+ * Parameters:
+ *      PackedImage image: The image to compress
+ *      unsigned width:    The trimmed (even) width to compress
+ *      unsigned height:   The trimmed (even) height to compress
+ * 
+ * Return: none
+ *
+ * Notes: none
+ *      
+ **********************************/
+static void encodeSerial(PackedImage image, unsigned width, unsigned height)
+{
+        /* One row of Compressed values is reused for every block row, so
+         * the loop never touches the heap */
+        unsigned blocks = width / 2;
+        struct Compressed *comps = ALLOC((blocks + 1) * sizeof(*comps));
+        uint32_t *words = ALLOC((blocks + 1) * sizeof(*words));
+
+        /* Processes each row of 2x2 blocks in the image */
+        struct Stats_timer timer;
+        for (unsigned row = 0; row < height; row += 2) {
+                Stats_start(&timer);
+                encodeImageRow(image, row / 2, blocks, comps);
+                Stats_stop(STATS_ENCODE, &timer);
+                Stats_encoded(comps, blocks);
+
+                Stats_start(&timer);
+                Codeword_packBatch(comps, words, blocks, packMode());
+                Stats_stop(STATS_PACK, &timer);
+
+                Stats_start(&timer);
+                Codewords_write(stdout, words, blocks);
+                Stats_stop(STATS_WRITE, &timer);
+        }
+
+        FREE(words);
+        FREE(comps);
+}
+
+/********** encodeParallel ********
+ * 
+ * Compresses the blocks of an image on several threads and writes the
+ * codewords to stdout
+ *
+ * Parameters:
+ *      PackedImage image: The image to compress
+ *      unsigned width:    The trimmed (even) width to compress
+ *      unsigned height:   The trimmed (even) height to compress
+ *      unsigned threads:  The number of threads to use
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - every codeword is four bytes, so each band knows where its output
+ *        goes and the result is the same as the serial loop's
+ *      - bands leave their codewords in big-endian order, ready for a
+ *        single fwrite
+ *      
+ **********************************/
+static void encodeParallel(PackedImage image, unsigned width, 
+                           unsigned height, unsigned threads)
+{
+        struct EncodeBands bands;
+        bands.fileOrder = 1;
+        encodeBands(&bands, image, width, height, threads);
+
+        struct Stats_timer timer;
+        Stats_start(&timer);
+        fwrite(bands.out, sizeof(*bands.out), 
+               (size_t)bands.blocks * bands.blockRows, stdout);
+        Stats_stop(STATS_WRITE, &timer);
+
+        FREE(bands.out);
+}
+
+/********** encodeChunked ********
+ * 
+ * Compresses the blocks of an image and writes them to stdout in 
+ * format 3, header included
+ *
+ * Parameters:
+ *      PackedImage image: The image to compress
+ *      unsigned width:    The trimmed (even) width to compress
+ *      unsigned height:   The trimmed (even) height to compress
+ *      unsigned threads:  The number of threads to use
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - the output is the same for any number of threads
+ *      
+ **********************************/
+static void encodeChunked(PackedImage image, unsigned width, 
+                          unsigned height, unsigned threads)
+{
+        struct EncodeBands bands;
+        bands.fileOrder = 0;
+        encodeBands(&bands, image, width, height, threads);
+
+        size_t written = Chunked_write(stdout, bands.out, width, height, 
+                                       threads);
+        Stats_count(STATS_BYTES_OUT, written);
+
+        FREE(bands.out);
+}
+
+/********** encodeBands ********
+ * 
+ * Compresses the blocks of an image on several threads into memory
+ *
+ * Parameters:
+ *      struct EncodeBands *bands: Set up for the image, with fileOrder
+ *                                 already set; bands->out is set to the 
+ *                                 codewords, which the caller frees
+ *      PackedImage image:         The image to compress
+ *      unsigned width:            The trimmed (even) width to compress
+ *      unsigned height:           The trimmed (even) height to compress
+ *      unsigned threads:          The number of threads to use
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - one thread compresses the bands in order without a pool
+ *      
+ **********************************/
+static void encodeBands(struct EncodeBands *bands, PackedImage image, 
+                        unsigned width, unsigned height, unsigned threads)
+{
+        bands->image = image;
+        bands->blocks = width / 2;
+        bands->blockRows = height / 2;
+        bands->rowsPerBand = bands->blockRows / 
+                             (threads * BANDS_PER_THREAD);
+        if (bands->rowsPerBand == 0) {
+                bands->rowsPerBand = 1;
+        }
+
+        size_t outWords = (size_t)bands->blocks * bands->blockRows;
+        bands->out = ALLOC((outWords + 1) * sizeof(*bands->out));
+        bands->scratch = ALLOC(threads * sizeof(*bands->scratch));
+        for (unsigned i = 0; i < threads; i++) {
+                bands->scratch[i] = ALLOC((bands->blocks + 1) * 
+                                          sizeof(struct Compressed));
+        }
+
+        unsigned count = (bands->blockRows + bands->rowsPerBand - 1) / 
+                         bands->rowsPerBand;
+        ThreadPool_run(threads, count, encodeBand, bands);
+
+        for (unsigned i = 0; i < threads; i++) {
+                FREE(bands->scratch[i]);
+        }
+        FREE(bands->scratch);
+}
+
+/********** encodeBand ********
+ * 
+ * Compresses one band of block rows into its slice of the output
+ *
+ * Parameters:
+ *      unsigned band:   Which band to compress
+ *      unsigned worker: Which thread is running, to pick scratch storage
+ *      void *cl:        The struct EncodeBands being compressed
+ * 
+ * Return: none
+ *
+ * Notes: none
+ *      
+ **********************************/
+static void encodeBand(unsigned band, unsigned worker, void *cl)
+{
+        struct EncodeBands *bands = cl;
+        struct Compressed *comps = bands->scratch[worker];
+        PackedImage image = bands->image;
+        struct Stats_timer timer;
+
+        unsigned first = band * bands->rowsPerBand;
+        unsigned last = first + bands->rowsPerBand;
+        if (last > bands->blockRows) {
+                last = bands->blockRows;
+        }
+
+        for (unsigned blockRow = first; blockRow < last; blockRow++) {
+                uint32_t *out = bands->out + 
+                                (size_t)blockRow * bands->blocks;
+
+                Stats_start(&timer);
+                encodeImageRow(image, blockRow, bands->blocks, comps);
+                Stats_stop(STATS_ENCODE, &timer);
+                Stats_encoded(comps, bands->blocks);
+
+                Stats_start(&timer);
+                Codeword_packBatch(comps, out, bands->blocks, packMode());
+                Stats_stop(STATS_PACK, &timer);
+        }
+
+        /* Putting the words in file order is part of writing them */
+        if (bands->fileOrder) {
+                Stats_start(&timer);
+                Codewords_swap(bands->out + (size_t)first * bands->blocks,
+                               (size_t)(last - first) * bands->blocks);
+                Stats_stop(STATS_WRITE, &timer);
+        }
 }
@@ -29,6 +29,53 @@
 #include "rgbConversion.h"
 #include "codeword.h"
 #include "compVidConversion.h"
+#include "packedImage.h"
+
+/*
+ * Options for the two functions below, set before calling them.
+ *      threads: how many threads may share the work (1 runs serially)
+ *      stream:  compress two rows at a time as the image is read, or
+ *               write each pair of rows as soon as it is decompressed,
+ *               in memory proportional to the width (serial only)
+ *      pipeline: stream in strips of block rows, reading the next strip
+ *                and writing the last one on their own threads while 
+ *                this one is worked on by threads threads
+ *      saturate: clamp fields that do not fit in a codeword instead of
+ *                raising Bitpack_Overflow
+ *      exact:    go through the floating-point pipeline rather than the
+ *                fixed-point encoder or the decoder's lookup tables, 
+ *                either of which may be one step off
+ *      entropy:  compress to format 3, Huffman-coded in chunks of block
+ *                rows (see chunked.h), rather than plain codewords; 
+ *                decompression reads either format whatever this is
+ *      tiled:    hold the whole image with each 2x2 block's pixels 
+ *                together (see packedImage.h), tiling as it is read and
+ *                untiling as it is written (not with stream, pipeline,
+ *                crop or scale, which work on a few rows at a time)
+ *      plain:    decompress to a plain (P3) PPM, in decimal, rather than
+ *                a raw (P6) one
+ *      scale:    decompress to 1/scale of the size (1, 2, 4 or 8) from
+ *                the mean colour of each block
+ *      crop:     when width is not 0, decompress only this rectangle of
+ *                the image, reading just the codewords under it
+ */
+struct Compress40Options
+{
+        unsigned threads;
+        int stream;
+        int pipeline;
+        int saturate;
+        int exact;
+        int entropy;
+        int tiled;
+        int plain;
+        unsigned scale;
+        struct {
+                unsigned x, y, width, height;
+        } crop;
+};
+
+extern struct Compress40Options compress40Options;
 
 /*
  * The two functions below are functions you should implement.
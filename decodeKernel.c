@@ -0,0 +1,860 @@
+/**************************************************************
+ *
+ *                     decodeKernel.c
+ *
+ *     Assignment: arith
+ *     Authors: Anh Hoang, Emilio Aleman
+ *     Date:  3/8/2024
+ *
+ *    This file contains the implementation of the decoder kernel. A row
+ *    of codewords is decoded either by the scalar value API or, when the
+ *    CPU supports AVX2, eight blocks at a time. The vector code repeats the
+ *    scalar arithmetic step for step, so both write the same pixels, and
+ *    clamps with saturating packs as it stores.
+ *
+ *    The default engine skips the floating-point pipeline altogether. 
+ *    Every field of a codeword is at most six bits wide, so the luma 
+ *    contribution of each of a, b, c and d and the three channel offsets
+ *    of each (pb, pr) pair are looked up in fixed-point tables built once.
+ *    A block then costs a few loads, adds and clamps. The tables hold 
+ *    exact values where the pipeline rounds to float along the way, so a
+ *    channel may come out one step away from the exact engine when its
+ *    value lands within a hair of a whole step.
+ *
+ **************************************************************/
+#include <math.h>
+#include <pthread.h>
+#include "decodeKernel.h"
+#include "rgbConversion.h"
+#include "compVidConversion.h"
+#include "codeword.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DECODE_AVX2 1
+#include <immintrin.h>
+#endif
+
+/* Block i of a row goes to top + pitch * i and bottom + pitch * i */
+typedef void DecodeRowFun(const uint32_t *words, unsigned blocks,
+                          unsigned char *top, unsigned char *bottom,
+                          size_t pitch);
+
+static DecodeRowFun decodeRowScalar;
+static DecodeRowFun decodeRowTables;
+static inline unsigned chromaIndex(uint32_t word);
+static inline void storeTablePixel(unsigned char *pixel, int32_t y, 
+                                   unsigned chroma);
+static void buildTables(void);
+static void pickKernel(void);
+
+static DecodeRowFun *exactRow = decodeRowScalar;
+static DecodeRowFun *tableRow = decodeRowTables;
+static Decode_engine engine = DECODE_TABLES;
+static pthread_once_t pickOnce = PTHREAD_ONCE_INIT;
+
+/* Fraction bits of the fixed-point tables, whose unit is one channel step */
+#define TABLE_FRAC 16
+
+/* Luma of the a field, and of the b, c and d fields, which share a width */
+static int32_t lumaA[1 << CODEWORD_A_WIDTH];
+static int32_t lumaCoef[1 << CODEWORD_B_WIDTH];
+
+/* Red, green and blue offsets of each pb field followed by a pr field */
+static int32_t chromaR[1 << (CODEWORD_PB_WIDTH + CODEWORD_PR_WIDTH)];
+static int32_t chromaG[1 << (CODEWORD_PB_WIDTH + CODEWORD_PR_WIDTH)];
+static int32_t chromaB[1 << (CODEWORD_PB_WIDTH + CODEWORD_PR_WIDTH)];
+
+/********** decodeSetEngine ********
+ * 
+ * Chooses how decodeBlockRow turns codewords into pixels
+ *
+ * Parameters:
+ *      Decode_engine engine: DECODE_TABLES for the lookup tables, or
+ *                            DECODE_EXACT for the floating-point pipeline
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - not thread safe; call before any thread starts decoding
+ *      
+ **********************************/
+void decodeSetEngine(Decode_engine choice)
+{
+        engine = choice;
+}
+
+/********** decodeBlockRow ********
+ * 
+ * Decodes a row of codewords into two rows of packed pixels
+ *
+ * Parameters:
+ *      const uint32_t *words: One codeword per block
+ *      unsigned blocks:       The number of blocks in the row
+ *      unsigned char *top:    The first pixel of the top image row
+ *      unsigned char *bottom: The first pixel of the bottom image row
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if any pointer is NULL
+ *      - the kernel is picked from the CPU's features on the first call
+ *      - safe to call from several threads at once
+ *      
+ **********************************/
+void decodeBlockRow(const uint32_t *words, unsigned blocks,
+                    unsigned char *top, unsigned char *bottom)
+{
+        assert(words != NULL && top != NULL && bottom != NULL);
+        pthread_once(&pickOnce, pickKernel);
+
+        if (engine == DECODE_EXACT) {
+                exactRow(words, blocks, top, bottom, 6);
+        } else {
+                tableRow(words, blocks, top, bottom, 6);
+        }
+}
+
+/********** decodeTileRow ********
+ * 
+ * Decodes a row of codewords into 2x2 blocks stored as tiles
+ *
+ * Parameters:
+ *      const uint32_t *words: One codeword per block
+ *      unsigned blocks:       The number of blocks in the row
+ *      unsigned char *tiles:  Where the first block goes, as twelve 
+ *                             bytes: top-left, top-right, bottom-left 
+ *                             and bottom-right pixels; the other blocks 
+ *                             follow
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if any pointer is NULL
+ *      - writes the same pixels as decodeBlockRow
+ *      
+ **********************************/
+void decodeTileRow(const uint32_t *words, unsigned blocks,
+                   unsigned char *tiles)
+{
+        assert(words != NULL && tiles != NULL);
+        pthread_once(&pickOnce, pickKernel);
+
+        if (engine == DECODE_EXACT) {
+                exactRow(words, blocks, tiles, tiles + 6, 12);
+        } else {
+                tableRow(words, blocks, tiles, tiles + 6, 12);
+        }
+}
+
+/********** decodeMeanRow ********
+ * 
+ * Decodes the mean colour of each block of a row into one pixel, which
+ * is a half-scale image of the row
+ *
+ * Parameters:
+ *      const uint32_t *words: One codeword per block
+ *      unsigned blocks:       The number of blocks in the row
+ *      unsigned char *pixels: Where the first block's pixel goes
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if any pointer is NULL
+ *      - a is the block's mean luma and pb and pr its mean chroma, so
+ *        b, c and d are ignored
+ *      - follows the engine chosen with decodeSetEngine
+ *      
+ **********************************/
+void decodeMeanRow(const uint32_t *words, unsigned blocks, 
+                   unsigned char *pixels)
+{
+        assert(words != NULL && pixels != NULL);
+        pthread_once(&pickOnce, pickKernel);
+
+        for (unsigned i = 0; i < blocks; i++) {
+                uint32_t w = words[i];
+
+                if (engine == DECODE_EXACT) {
+                        struct Compressed comp = Codeword_unpack(w);
+                        struct ComponentVideo cv;
+
+                        cv.y = (float)comp.a / 511.0;
+                        cv.pb = Arith40_chroma_of_index(comp.pb_avg);
+                        cv.pr = Arith40_chroma_of_index(comp.pr_avg);
+                        RGBtoPacked(compVidtoRGBval(cv), pixels + 3 * i);
+                } else {
+                        storeTablePixel(pixels + 3 * i, 
+                                        lumaA[Bitpack_getu32(w, 
+                                        CODEWORD_A_WIDTH, CODEWORD_A_LSB)],
+                                        chromaIndex(w));
+                }
+        }
+}
+
+/********** decodeCountClamps ********
+ * 
+ * Counts the channels of a row of codewords that decode outside [0, 255]
+ * and are clamped
+ *
+ * Parameters:
+ *      const uint32_t *words: One codeword per block
+ *      unsigned blocks:       The number of blocks in the row
+ * 
+ * Return: the number of clamped channels, at most 12 per block
+ *
+ * Notes:
+ *      - CRE if words is NULL
+ *      - counts through the tables whatever the engine, so a channel 
+ *        within a hair of the range may be counted differently from how
+ *        the exact engine clamps it
+ *      - only --stats calls this; decoding never does
+ *      
+ **********************************/
+unsigned decodeCountClamps(const uint32_t *words, unsigned blocks)
+{
+        assert(words != NULL);
+        pthread_once(&pickOnce, pickKernel);
+
+        const int32_t max = 256 << TABLE_FRAC;
+        unsigned clamped = 0;
+
+        for (unsigned i = 0; i < blocks; i++) {
+                uint32_t w = words[i];
+                int32_t a = lumaA[Bitpack_getu32(w, CODEWORD_A_WIDTH, 
+                                                 CODEWORD_A_LSB)];
+                int32_t b = lumaCoef[Bitpack_getu32(w, CODEWORD_B_WIDTH, 
+                                                    CODEWORD_B_LSB)];
+                int32_t c = lumaCoef[Bitpack_getu32(w, CODEWORD_C_WIDTH, 
+                                                    CODEWORD_C_LSB)];
+                int32_t d = lumaCoef[Bitpack_getu32(w, CODEWORD_D_WIDTH, 
+                                                    CODEWORD_D_LSB)];
+                int32_t y[4] = { a - b - c + d, a - b + c - d, 
+                                 a + b - c - d, a + b + c + d };
+                unsigned chroma = chromaIndex(w);
+                int32_t offsets[3] = { chromaR[chroma], chromaG[chroma],
+                                       chromaB[chroma] };
+
+                for (int p = 0; p < 4; p++) {
+                        for (int k = 0; k < 3; k++) {
+                                int32_t value = y[p] + offsets[k];
+                                clamped += value < 0 || value >= max;
+                        }
+                }
+        }
+
+        return clamped;
+}
+
+/********** decodeRowScalar ********
+ * 
+ * Decodes a row of codewords one block at a time through the value API
+ *
+ * Parameters: see decodeBlockRow, and pitch, the bytes from one block to
+ *             the next
+ * 
+ * Return: none
+ *
+ * Notes: none
+ *      
+ **********************************/
+static void decodeRowScalar(const uint32_t *words, unsigned blocks,
+                            unsigned char *top, unsigned char *bottom,
+                            size_t pitch)
+{
+        struct CompVidQuad cvQuad;
+        struct rgbQuad rgbQuad;
+
+        for (unsigned i = 0; i < blocks; i++) {
+                CompressedToCvQuad(Codeword_unpack(words[i]), &cvQuad);
+                CvQuadToRgbQuad(&cvQuad, &rgbQuad);
+                rgbQuadToPacked(&rgbQuad, top + pitch * i, 
+                                bottom + pitch * i);
+        }
+}
+
+/********** chromaIndex ********
+ * 
+ * Gives the index of a codeword's chroma fields in the chroma tables
+ *
+ * Parameters:
+ *      uint32_t word: The codeword
+ * 
+ * Return: the pb field followed by the pr field
+ *
+ * Notes: none
+ *      
+ **********************************/
+static inline unsigned chromaIndex(uint32_t word)
+{
+        return Bitpack_getu32(word, CODEWORD_PB_WIDTH, CODEWORD_PB_LSB) 
+                        << CODEWORD_PR_WIDTH | 
+               Bitpack_getu32(word, CODEWORD_PR_WIDTH, CODEWORD_PR_LSB);
+}
+
+/********** toChannel ********
+ * 
+ * Turns a fixed-point channel value into an 8-bit channel
+ *
+ * Parameters:
+ *      int32_t value: The value, in units of 2^-TABLE_FRAC of a step
+ * 
+ * Return: the whole steps in value, clamped to [0, 255]
+ *
+ * Notes: none
+ *      
+ **********************************/
+static inline unsigned char toChannel(int32_t value)
+{
+        value = value < 0 ? 0 : value >> TABLE_FRAC;
+        return value > 255 ? 255 : value;
+}
+
+/********** storeTablePixel ********
+ * 
+ * Stores one pixel from its table luma and chroma index
+ *
+ * Parameters:
+ *      unsigned char *pixel: Where the pixel goes
+ *      int32_t y:            The pixel's luma, in table units
+ *      unsigned chroma:      The block's index in the chroma tables
+ * 
+ * Return: none
+ *
+ * Notes: none
+ *      
+ **********************************/
+static inline void storeTablePixel(unsigned char *pixel, int32_t y, 
+                                   unsigned chroma)
+{
+        pixel[0] = toChannel(y + chromaR[chroma]);
+        pixel[1] = toChannel(y + chromaG[chroma]);
+        pixel[2] = toChannel(y + chromaB[chroma]);
+}
+
+/********** decodeRowTables ********
+ * 
+ * Decodes a row of codewords one block at a time through the tables
+ *
+ * Parameters: see decodeRowScalar
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - the tables must have been built
+ *      
+ **********************************/
+static void decodeRowTables(const uint32_t *words, unsigned blocks,
+                            unsigned char *top, unsigned char *bottom,
+                            size_t pitch)
+{
+        for (unsigned i = 0; i < blocks; i++) {
+                uint32_t w = words[i];
+                int32_t a = lumaA[Bitpack_getu32(w, CODEWORD_A_WIDTH, 
+                                                 CODEWORD_A_LSB)];
+                int32_t b = lumaCoef[Bitpack_getu32(w, CODEWORD_B_WIDTH, 
+                                                    CODEWORD_B_LSB)];
+                int32_t c = lumaCoef[Bitpack_getu32(w, CODEWORD_C_WIDTH, 
+                                                    CODEWORD_C_LSB)];
+                int32_t d = lumaCoef[Bitpack_getu32(w, CODEWORD_D_WIDTH, 
+                                                    CODEWORD_D_LSB)];
+                unsigned chroma = chromaIndex(w);
+
+                storeTablePixel(top + pitch * i, a - b - c + d, chroma);
+                storeTablePixel(top + pitch * i + 3, a - b + c - d, chroma);
+                storeTablePixel(bottom + pitch * i, a + b - c - d, chroma);
+                storeTablePixel(bottom + pitch * i + 3, a + b + c + d, 
+                                chroma);
+        }
+}
+
+/********** toTable ********
+ * 
+ * Converts a value on the [0, 1] channel scale to table units
+ *
+ * Parameters:
+ *      double value: The value
+ * 
+ * Return: value in units of 2^-TABLE_FRAC of an 8-bit step, rounded
+ *
+ * Notes: none
+ *      
+ **********************************/
+static int32_t toTable(double value)
+{
+        return lround(value * 255 * (1 << TABLE_FRAC));
+}
+
+/********** buildTables ********
+ * 
+ * Fills the luma and chroma tables of the table engine
+ *
+ * Parameters: none
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - each entry starts from the value CompressedToCvQuad would use, 
+ *        and the chroma entries use the factors of compVidtoRGBval
+ *      
+ **********************************/
+static void buildTables(void)
+{
+        for (unsigned a = 0; a < (1u << CODEWORD_A_WIDTH); a++) {
+                lumaA[a] = toTable((float)a / 511.0);
+        }
+
+        for (unsigned field = 0; field < (1u << CODEWORD_B_WIDTH); field++) {
+                int32_t coef = Bitpack_gets32(field, CODEWORD_B_WIDTH, 0);
+                lumaCoef[field] = toTable(dequantize(coef));
+        }
+
+        for (unsigned pbi = 0; pbi < (1u << CODEWORD_PB_WIDTH); pbi++) {
+                for (unsigned pri = 0; pri < (1u << CODEWORD_PR_WIDTH); 
+                     pri++) {
+                        double pb = Arith40_chroma_of_index(pbi);
+                        double pr = Arith40_chroma_of_index(pri);
+                        unsigned i = pbi << CODEWORD_PR_WIDTH | pri;
+
+                        chromaR[i] = toTable(1.402 * pr);
+                        chromaG[i] = toTable(-0.344136 * pb - 0.714136 * pr);
+                        chromaB[i] = toTable(1.772 * pb + 0.081312 * pr);
+                }
+        }
+}
+
+#ifdef DECODE_AVX2
+
+/* Arith40_chroma_of_index for every 4-bit index */
+static float chromaTable[16];
+
+__attribute__((target("avx2")))
+static __m256i packRGB8(__m256i r, __m256i g, __m256i b);
+
+/********** toRGB8 ********
+ * 
+ * Converts eight Component Video values to packed pixels
+ *
+ * Parameters:
+ *      __m256 y, pb, pr: The Component Video values
+ * 
+ * Return: one pixel per 32-bit lane, red in the low byte, then green and
+ *         blue, then a zero byte
+ *
+ * Notes:
+ *      - matches compVidtoRGBval followed by RGBtoPacked: the colour
+ *        products are done in double precision, then each channel is 
+ *        scaled in float and truncated; saturating packs do the clamping
+ *      
+ **********************************/
+__attribute__((target("avx2")))
+static __m256i toRGB8(__m256 y, __m256 pb, __m256 pr)
+{
+        __m256d yd[2] = { _mm256_cvtps_pd(_mm256_castps256_ps128(y)),
+                          _mm256_cvtps_pd(_mm256_extractf128_ps(y, 1)) };
+        __m256d pbd[2] = { _mm256_cvtps_pd(_mm256_castps256_ps128(pb)),
+                           _mm256_cvtps_pd(_mm256_extractf128_ps(pb, 1)) };
+        __m256d prd[2] = { _mm256_cvtps_pd(_mm256_castps256_ps128(pr)),
+                           _mm256_cvtps_pd(_mm256_extractf128_ps(pr, 1)) };
+        __m128 r[2], g[2], b[2];
+
+        for (int h = 0; h < 2; h++) {
+                __m256d t;
+
+                t = _mm256_add_pd(yd[h], 
+                        _mm256_mul_pd(_mm256_set1_pd(1.402), prd[h]));
+                r[h] = _mm256_cvtpd_ps(t);
+
+                t = _mm256_sub_pd(yd[h], 
+                        _mm256_mul_pd(_mm256_set1_pd(0.344136), pbd[h]));
+                t = _mm256_sub_pd(t, 
+                        _mm256_mul_pd(_mm256_set1_pd(0.714136), prd[h]));
+                g[h] = _mm256_cvtpd_ps(t);
+
+                t = _mm256_add_pd(yd[h], 
+                        _mm256_mul_pd(_mm256_set1_pd(1.772), pbd[h]));
+                t = _mm256_add_pd(t, 
+                        _mm256_mul_pd(_mm256_set1_pd(0.081312), prd[h]));
+                b[h] = _mm256_cvtpd_ps(t);
+        }
+
+        const __m256 scale = _mm256_set1_ps(255);
+        __m256i ri = _mm256_cvttps_epi32(_mm256_mul_ps(
+                        _mm256_set_m128(r[1], r[0]), scale));
+        __m256i gi = _mm256_cvttps_epi32(_mm256_mul_ps(
+                        _mm256_set_m128(g[1], g[0]), scale));
+        __m256i bi = _mm256_cvttps_epi32(_mm256_mul_ps(
+                        _mm256_set_m128(b[1], b[0]), scale));
+
+        return packRGB8(ri, gi, bi);
+}
+
+/********** packRGB8 ********
+ * 
+ * Packs eight red, green and blue channels into pixels
+ *
+ * Parameters:
+ *      __m256i r, g, b: The channels, one per 32-bit lane
+ * 
+ * Return: one pixel per 32-bit lane, red in the low byte, then green and
+ *         blue, then a zero byte
+ *
+ * Notes:
+ *      - saturating packs clamp each channel to [0, 255]
+ *      
+ **********************************/
+__attribute__((target("avx2")))
+static __m256i packRGB8(__m256i r, __m256i g, __m256i b)
+{
+        /* Each 128-bit lane becomes R0-R3 G0-G3 B0-B3 0000, clamped to
+         * [0, 255], then is regrouped to one pixel per 32-bit lane */
+        __m256i bytes = _mm256_packus_epi16(_mm256_packs_epi32(r, g),
+                        _mm256_packs_epi32(b, _mm256_setzero_si256()));
+        const __m256i transpose = _mm256_setr_epi8(
+                0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15,
+                0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+        return _mm256_shuffle_epi8(bytes, transpose);
+}
+
+/********** storeRow8 ********
+ * 
+ * Stores the left and right pixels of eight blocks as 48 bytes of RGB
+ *
+ * Parameters:
+ *      __m256i left:       The left pixel of each block, as from toRGB8
+ *      __m256i right:      The right pixel of each block
+ *      unsigned char *dst: Where the left pixel of the first block goes
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - writes four scratch bytes past the 48, so the caller must make
+ *        sure they belong to a later block of the row
+ *      
+ **********************************/
+__attribute__((target("avx2")))
+static void storeRow8(__m256i left, __m256i right, unsigned char *dst)
+{
+        const __m256i compact = _mm256_setr_epi8(
+                0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+        __m256i lo = _mm256_shuffle_epi8(_mm256_unpacklo_epi32(left, right),
+                                         compact);
+        __m256i hi = _mm256_shuffle_epi8(_mm256_unpackhi_epi32(left, right),
+                                         compact);
+
+        _mm_storeu_si128((__m128i *)dst, _mm256_castsi256_si128(lo));
+        _mm_storeu_si128((__m128i *)(dst + 12), _mm256_castsi256_si128(hi));
+        _mm_storeu_si128((__m128i *)(dst + 24), 
+                         _mm256_extracti128_si256(lo, 1));
+        _mm_storeu_si128((__m128i *)(dst + 36), 
+                         _mm256_extracti128_si256(hi, 1));
+}
+
+/********** storeTile8 ********
+ * 
+ * Stores the four pixels of eight blocks as 96 bytes of tiles
+ *
+ * Parameters:
+ *      __m256i p1, p2:     The top-left and top-right pixel of each 
+ *                          block, as from toRGB8
+ *      __m256i p3, p4:     The bottom-left and bottom-right pixels
+ *      unsigned char *dst: Where the first block's tile goes
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - writes four scratch bytes past the 96, like storeRow8
+ *      - the tiles are stored in order, so each one's scratch bytes are
+ *        overwritten by the next
+ *      
+ **********************************/
+__attribute__((target("avx2")))
+static void storeTile8(__m256i p1, __m256i p2, __m256i p3, __m256i p4,
+                       unsigned char *dst)
+{
+        const __m256i compact = _mm256_setr_epi8(
+                0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+        __m256i lo12 = _mm256_unpacklo_epi32(p1, p2);
+        __m256i hi12 = _mm256_unpackhi_epi32(p1, p2);
+        __m256i lo34 = _mm256_unpacklo_epi32(p3, p4);
+        __m256i hi34 = _mm256_unpackhi_epi32(p3, p4);
+
+        /* Block k of each 128-bit lane is tile k, and of the high lane,
+         * tile k + 4 */
+        __m256i tiles[4] = {
+                _mm256_shuffle_epi8(_mm256_unpacklo_epi64(lo12, lo34), 
+                                    compact),
+                _mm256_shuffle_epi8(_mm256_unpackhi_epi64(lo12, lo34), 
+                                    compact),
+                _mm256_shuffle_epi8(_mm256_unpacklo_epi64(hi12, hi34), 
+                                    compact),
+                _mm256_shuffle_epi8(_mm256_unpackhi_epi64(hi12, hi34), 
+                                    compact)
+        };
+
+        for (int k = 0; k < 4; k++) {
+                _mm_storeu_si128((__m128i *)(dst + 12 * k), 
+                                 _mm256_castsi256_si128(tiles[k]));
+        }
+        for (int k = 0; k < 4; k++) {
+                _mm_storeu_si128((__m128i *)(dst + 48 + 12 * k), 
+                                 _mm256_extracti128_si256(tiles[k], 1));
+        }
+}
+
+/********** storeBlocks8 ********
+ * 
+ * Stores the four pixels of eight blocks, in rows or as tiles
+ *
+ * Parameters:
+ *      __m256i p1, p2, p3, p4: The pixels, as for storeTile8
+ *      unsigned char *top:     Where the first block's top-left pixel 
+ *                              goes
+ *      unsigned char *bottom:  Where its bottom-left pixel goes
+ *      size_t pitch:           6 for rows, or 12 for tiles, where bottom
+ *                              is top + 6
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - writes four scratch bytes past the last block, like storeRow8
+ *      
+ **********************************/
+__attribute__((target("avx2")))
+static inline void storeBlocks8(__m256i p1, __m256i p2, __m256i p3, 
+                                __m256i p4, unsigned char *top, 
+                                unsigned char *bottom, size_t pitch)
+{
+        if (pitch == 12) {
+                storeTile8(p1, p2, p3, p4, top);
+        } else {
+                storeRow8(p1, p2, top);
+                storeRow8(p3, p4, bottom);
+        }
+}
+
+/********** dequantize8 ********
+ * 
+ * Dequantizes eight b, c or d fields, like dequantize()
+ *
+ * Parameters:
+ *      __m256i num: The sign-extended fields
+ * 
+ * Return: the coefficients
+ *
+ * Notes: none
+ *      
+ **********************************/
+__attribute__((target("avx2")))
+static __m256 dequantize8(__m256i num)
+{
+        num = _mm256_min_epi32(_mm256_max_epi32(num, _mm256_set1_epi32(-15)),
+                               _mm256_set1_epi32(15));
+        __m256d lo = _mm256_div_pd(_mm256_cvtepi32_pd(
+                        _mm256_castsi256_si128(num)), _mm256_set1_pd(50.0));
+        __m256d hi = _mm256_div_pd(_mm256_cvtepi32_pd(
+                        _mm256_extracti128_si256(num, 1)), 
+                        _mm256_set1_pd(50.0));
+
+        return _mm256_set_m128(_mm256_cvtpd_ps(hi), _mm256_cvtpd_ps(lo));
+}
+
+/********** getu8 / gets8 ********
+ * 
+ * Extracts an unsigned or sign-extended field from eight codewords, like
+ * Bitpack_getu32 and Bitpack_gets32
+ *
+ * Parameters:
+ *      __m256i words:  The codewords
+ *      unsigned width: The width of the field
+ *      unsigned lsb:   The least significant bit of the field
+ * 
+ * Return: the fields
+ *
+ * Notes: none
+ *      
+ **********************************/
+__attribute__((target("avx2")))
+static inline __m256i getu8(__m256i words, unsigned width, unsigned lsb)
+{
+        return _mm256_and_si256(_mm256_srli_epi32(words, lsb), 
+                                _mm256_set1_epi32(Bitpack_mask32(width)));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i gets8(__m256i words, unsigned width, unsigned lsb)
+{
+        return _mm256_srai_epi32(_mm256_slli_epi32(words, 32 - width - lsb),
+                                 32 - width);
+}
+
+/********** decodeRowAvx2 ********
+ * 
+ * Decodes a row of codewords eight at a time with AVX2
+ *
+ * Parameters: see decodeRowScalar
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - the last group of blocks is always left to the scalar kernel,
+ *        so the stores never write past the end of the row
+ *      
+ **********************************/
+__attribute__((target("avx2")))
+static void decodeRowAvx2(const uint32_t *words, unsigned blocks,
+                          unsigned char *top, unsigned char *bottom,
+                          size_t pitch)
+{
+        unsigned i = 0;
+
+        for (; i + 8 < blocks; i += 8) {
+                __m256i w = _mm256_loadu_si256((const __m256i *)(words + i));
+
+                /* Same field layout as Codeword_unpack */
+                __m256i aw = getu8(w, CODEWORD_A_WIDTH, CODEWORD_A_LSB);
+                __m256i bw = gets8(w, CODEWORD_B_WIDTH, CODEWORD_B_LSB);
+                __m256i cw = gets8(w, CODEWORD_C_WIDTH, CODEWORD_C_LSB);
+                __m256i dw = gets8(w, CODEWORD_D_WIDTH, CODEWORD_D_LSB);
+                __m256i pbw = getu8(w, CODEWORD_PB_WIDTH, CODEWORD_PB_LSB);
+                __m256i prw = getu8(w, CODEWORD_PR_WIDTH, CODEWORD_PR_LSB);
+
+                __m256d alo = _mm256_div_pd(_mm256_cvtepi32_pd(
+                        _mm256_castsi256_si128(aw)), _mm256_set1_pd(511.0));
+                __m256d ahi = _mm256_div_pd(_mm256_cvtepi32_pd(
+                        _mm256_extracti128_si256(aw, 1)), 
+                        _mm256_set1_pd(511.0));
+                __m256 a = _mm256_set_m128(_mm256_cvtpd_ps(ahi), 
+                                           _mm256_cvtpd_ps(alo));
+                __m256 b = dequantize8(bw);
+                __m256 c = dequantize8(cw);
+                __m256 d = dequantize8(dw);
+                __m256 pb = _mm256_i32gather_ps(chromaTable, pbw, 4);
+                __m256 pr = _mm256_i32gather_ps(chromaTable, prw, 4);
+
+                /* Same association order as CompressedToCvQuad */
+                __m256 amb = _mm256_sub_ps(a, b);
+                __m256 apb = _mm256_add_ps(a, b);
+                __m256 y1 = _mm256_add_ps(_mm256_sub_ps(amb, c), d);
+                __m256 y2 = _mm256_sub_ps(_mm256_add_ps(amb, c), d);
+                __m256 y3 = _mm256_sub_ps(_mm256_sub_ps(apb, c), d);
+                __m256 y4 = _mm256_add_ps(_mm256_add_ps(apb, c), d);
+
+                storeBlocks8(toRGB8(y1, pb, pr), toRGB8(y2, pb, pr), 
+                             toRGB8(y3, pb, pr), toRGB8(y4, pb, pr),
+                             top + pitch * i, bottom + pitch * i, pitch);
+        }
+
+        decodeRowScalar(words + i, blocks - i, top + pitch * i, 
+                        bottom + pitch * i, pitch);
+}
+
+/********** tablePixel8 ********
+ * 
+ * Looks up eight pixels' channels and packs them, like storeTablePixel
+ *
+ * Parameters:
+ *      __m256i y:      The luma of each pixel, in table units
+ *      __m256i chroma: The index of each pixel's block in the chroma tables
+ * 
+ * Return: the pixels, as from packRGB8
+ *
+ * Notes: none
+ *      
+ **********************************/
+__attribute__((target("avx2")))
+static __m256i tablePixel8(__m256i y, __m256i chroma)
+{
+        __m256i r = _mm256_add_epi32(y, _mm256_i32gather_epi32(
+                        (const int *)chromaR, chroma, 4));
+        __m256i g = _mm256_add_epi32(y, _mm256_i32gather_epi32(
+                        (const int *)chromaG, chroma, 4));
+        __m256i b = _mm256_add_epi32(y, _mm256_i32gather_epi32(
+                        (const int *)chromaB, chroma, 4));
+
+        return packRGB8(_mm256_srai_epi32(r, TABLE_FRAC), 
+                        _mm256_srai_epi32(g, TABLE_FRAC),
+                        _mm256_srai_epi32(b, TABLE_FRAC));
+}
+
+/********** decodeRowTablesAvx2 ********
+ * 
+ * Decodes a row of codewords eight at a time through the tables
+ *
+ * Parameters: see decodeRowScalar
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - the last group of blocks is always left to the scalar kernel,
+ *        so the stores never write past the end of the row
+ *      
+ **********************************/
+__attribute__((target("avx2")))
+static void decodeRowTablesAvx2(const uint32_t *words, unsigned blocks,
+                                unsigned char *top, unsigned char *bottom,
+                                size_t pitch)
+{
+        unsigned i = 0;
+
+        for (; i + 8 < blocks; i += 8) {
+                __m256i w = _mm256_loadu_si256((const __m256i *)(words + i));
+
+                __m256i a = _mm256_i32gather_epi32((const int *)lumaA, 
+                        getu8(w, CODEWORD_A_WIDTH, CODEWORD_A_LSB), 4);
+                __m256i b = _mm256_i32gather_epi32((const int *)lumaCoef, 
+                        getu8(w, CODEWORD_B_WIDTH, CODEWORD_B_LSB), 4);
+                __m256i c = _mm256_i32gather_epi32((const int *)lumaCoef, 
+                        getu8(w, CODEWORD_C_WIDTH, CODEWORD_C_LSB), 4);
+                __m256i d = _mm256_i32gather_epi32((const int *)lumaCoef, 
+                        getu8(w, CODEWORD_D_WIDTH, CODEWORD_D_LSB), 4);
+                __m256i chroma = _mm256_or_si256(_mm256_slli_epi32(
+                        getu8(w, CODEWORD_PB_WIDTH, CODEWORD_PB_LSB), 
+                        CODEWORD_PR_WIDTH), 
+                        getu8(w, CODEWORD_PR_WIDTH, CODEWORD_PR_LSB));
+
+                __m256i amb = _mm256_sub_epi32(a, b);
+                __m256i apb = _mm256_add_epi32(a, b);
+                __m256i cmd = _mm256_sub_epi32(c, d);
+                __m256i cpd = _mm256_add_epi32(c, d);
+
+                storeBlocks8(tablePixel8(_mm256_sub_epi32(amb, cmd), chroma),
+                             tablePixel8(_mm256_add_epi32(amb, cmd), chroma),
+                             tablePixel8(_mm256_sub_epi32(apb, cpd), chroma),
+                             tablePixel8(_mm256_add_epi32(apb, cpd), chroma),
+                             top + pitch * i, bottom + pitch * i, pitch);
+        }
+
+        decodeRowTables(words + i, blocks - i, top + pitch * i, 
+                        bottom + pitch * i, pitch);
+}
+
+#endif
+
+/********** pickKernel ********
+ * 
+ * Builds the tables and picks the fastest kernels the CPU supports
+ *
+ * Parameters: none
+ * 
+ * Return: none
+ *
+ * Notes: runs once, through pthread_once
+ *      
+ **********************************/
+static void pickKernel(void)
+{
+        buildTables();
+
+#ifdef DECODE_AVX2
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+                for (unsigned i = 0; i < 16; i++) {
+                        chromaTable[i] = Arith40_chroma_of_index(i);
+                }
+                exactRow = decodeRowAvx2;
+                tableRow = decodeRowTablesAvx2;
+        }
+#endif
+}
@@ -0,0 +1,34 @@
+/**************************************************************
+ *
+ *                     decodeKernel.h
+ *
+ *     Assignment: arith
+ *     Authors: Anh Hoang, Emilio Aleman
+ *     Date:  3/8/2024
+ *
+ *    This file contains the declaration of the decoder kernel, which turns
+ *    a row of codewords into the two rows of 8-bit RGB pixels they cover.
+ *    Two engines are available: integer lookup tables (the default), 
+ *    which may differ from the floating-point pipeline by one step in a
+ *    channel, and the floating-point pipeline itself.
+ *
+ **************************************************************/
+#ifndef DECODEKERNEL_INCLUDED
+#define DECODEKERNEL_INCLUDED
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "helpers.h"
+
+typedef enum { DECODE_TABLES, DECODE_EXACT } Decode_engine;
+
+void decodeSetEngine(Decode_engine engine);
+void decodeBlockRow(const uint32_t *words, unsigned blocks,
+                    unsigned char *top, unsigned char *bottom);
+void decodeTileRow(const uint32_t *words, unsigned blocks,
+                   unsigned char *tiles);
+void decodeMeanRow(const uint32_t *words, unsigned blocks, 
+                   unsigned char *pixels);
+unsigned decodeCountClamps(const uint32_t *words, unsigned blocks);
+
+#endif
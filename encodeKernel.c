@@ -0,0 +1,792 @@
+/**************************************************************
+ *
+ *                     encodeKernel.c
+ *
+ *     Assignment: arith
+ *     Authors: Anh Hoang, Emilio Aleman
+ *     Date:  3/8/2024
+ *
+ *    This file contains the implementation of the encoder kernel. A row
+ *    of blocks is encoded either by the scalar value API or, when the CPU
+ *    supports AVX2, eight blocks at a time. Both produce exactly the same
+ *    Compressed values: the vector code repeats the scalar arithmetic step
+ *    for step, including which operations are done in double precision.
+ *
+ *    The default engine works in fixed point instead. Colour conversion 
+ *    and the DCT are both linear, so the butterflies are done first, on
+ *    the exact integer channels of the block, and each field is then one
+ *    dot product with integer coefficients that fold in the scaling to 
+ *    the field's quantization step; quantizing is a shift. Since only 
+ *    the coefficients are rounded, a, b, c and d are within one step of
+ *    the exact engine and the chroma indices are the same or adjacent, 
+ *    and in practice nearly every block matches.
+ *
+ **************************************************************/
+#include <math.h>
+#include <pthread.h>
+#include "encodeKernel.h"
+#include "rgbConversion.h"
+#include "compVidConversion.h"
+#include "chromaIndex.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ENCODE_AVX2 1
+#include <immintrin.h>
+#endif
+
+/* Block i of a row starts at top + pitch * i and bottom + pitch * i */
+typedef void EncodeRowFun(const unsigned char *top, 
+                          const unsigned char *bottom, size_t pitch,
+                          unsigned blocks, struct Compressed *comps);
+
+static EncodeRowFun encodeRowScalar;
+static EncodeRowFun encodeRowFixed;
+static void buildCoefficients(void);
+static void pickKernel(void);
+
+static EncodeRowFun *exactRow = encodeRowScalar;
+static EncodeRowFun *fixedRow = encodeRowFixed;
+static Encode_engine engine = ENCODE_FIXED;
+static pthread_once_t pickOnce = PTHREAD_ONCE_INIT;
+
+/* Fraction bits of the fixed-point engine's luma and chroma coefficients;
+ * each is as many as the largest sum of a block's terms leaves room for */
+#define ENCODE_FIX 19
+#define CHROMA_FIX 28
+
+/* Red, green and blue coefficients giving a, b, c and d in units of 
+ * 2^-ENCODE_FIX of a quarter step, and four times Pb and Pr in units of
+ * 2^-CHROMA_FIX */
+static int32_t lumaA[3];
+static int32_t lumaCoef[3];
+static int32_t chromaPb[3];
+static int32_t chromaPr[3];
+
+/* ChromaIndex thresholds for the fixed-point averages above */
+static int32_t chromaSteps[CHROMA_THRESHOLDS];
+
+/********** encodeSetEngine ********
+ * 
+ * Chooses how encodeBlockRow turns pixels into Compressed values
+ *
+ * Parameters:
+ *      Encode_engine engine: ENCODE_FIXED for integer arithmetic, or
+ *                            ENCODE_EXACT for the floating-point pipeline
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - not thread safe; call before any thread starts encoding
+ *      
+ **********************************/
+void encodeSetEngine(Encode_engine choice)
+{
+        engine = choice;
+}
+
+/********** encodeBlockRow ********
+ * 
+ * Encodes a row of 2x2 blocks into Compressed values
+ *
+ * Parameters:
+ *      const unsigned char *top:    The first pixel of the block row's 
+ *                                   top image row
+ *      const unsigned char *bottom: The first pixel of its bottom image row
+ *      unsigned blocks:             The number of blocks in the row
+ *      struct Compressed *comps:    Storage for one value per block
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if any pointer is NULL
+ *      - the kernel is picked from the CPU's features on the first call
+ *      - safe to call from several threads at once
+ *      
+ **********************************/
+void encodeBlockRow(const unsigned char *top, const unsigned char *bottom,
+                    unsigned blocks, struct Compressed *comps)
+{
+        assert(top != NULL && bottom != NULL && comps != NULL);
+        pthread_once(&pickOnce, pickKernel);
+
+        if (engine == ENCODE_EXACT) {
+                exactRow(top, bottom, 6, blocks, comps);
+        } else {
+                fixedRow(top, bottom, 6, blocks, comps);
+        }
+}
+
+/********** encodeTileRow ********
+ * 
+ * Encodes a row of 2x2 blocks stored as tiles into Compressed values
+ *
+ * Parameters:
+ *      const unsigned char *tiles: The first block of the row, as twelve 
+ *                                  bytes: top-left, top-right, 
+ *                                  bottom-left and bottom-right pixels,
+ *                                  followed by the other blocks
+ *      unsigned blocks:            The number of blocks in the row
+ *      struct Compressed *comps:   Storage for one value per block
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if any pointer is NULL
+ *      - gives the same values as encodeBlockRow on the same pixels
+ *      
+ **********************************/
+void encodeTileRow(const unsigned char *tiles, unsigned blocks, 
+                   struct Compressed *comps)
+{
+        assert(tiles != NULL && comps != NULL);
+        pthread_once(&pickOnce, pickKernel);
+
+        if (engine == ENCODE_EXACT) {
+                exactRow(tiles, tiles + 6, 12, blocks, comps);
+        } else {
+                fixedRow(tiles, tiles + 6, 12, blocks, comps);
+        }
+}
+
+/********** encodeRowScalar ********
+ * 
+ * Encodes a row of blocks one at a time through the value API
+ *
+ * Parameters: see encodeBlockRow, and pitch, the bytes from one block to
+ *             the next
+ * 
+ * Return: none
+ *
+ * Notes: none
+ *      
+ **********************************/
+static void encodeRowScalar(const unsigned char *top, 
+                            const unsigned char *bottom, size_t pitch,
+                            unsigned blocks, struct Compressed *comps)
+{
+        struct rgbQuad rgbQuad;
+        struct CompVidQuad cvQuad;
+
+        for (unsigned i = 0; i < blocks; i++) {
+                packedToRgbQuad(top + pitch * i, bottom + pitch * i, 
+                                &rgbQuad);
+                rgbQuadToCvQuad(&rgbQuad, &cvQuad);
+                comps[i] = DCTval(&cvQuad);
+        }
+}
+
+/********** dot3 ********
+ * 
+ * Combines the red, green and blue terms of a fixed-point field
+ *
+ * Parameters:
+ *      const int32_t coef[3]: The field's coefficients
+ *      const int32_t sums[3]: The butterflied channels of the block
+ * 
+ * Return: the field in fixed point
+ *
+ * Notes: none
+ *      
+ **********************************/
+static inline int32_t dot3(const int32_t coef[3], const int32_t sums[3])
+{
+        return coef[0] * sums[0] + coef[1] * sums[1] + coef[2] * sums[2];
+}
+
+/********** quantizeFixedA ********
+ * 
+ * Quantizes a fixed-point a like round(inRange(a, 0, 1) * 511)
+ *
+ * Parameters:
+ *      int32_t scaled: a in units of 2^-ENCODE_FIX of a quarter step
+ * 
+ * Return: the quantized a
+ *
+ * Notes: none
+ *      
+ **********************************/
+static inline unsigned quantizeFixedA(int32_t scaled)
+{
+        const int32_t max = (4 * 511) << ENCODE_FIX;
+
+        scaled = scaled < 0 ? 0 : scaled > max ? max : scaled;
+        return (scaled + (2 << ENCODE_FIX)) >> (ENCODE_FIX + 2);
+}
+
+/********** quantizeFixed ********
+ * 
+ * Quantizes a fixed-point b, c or d like quantize()
+ *
+ * Parameters:
+ *      int32_t scaled: The coefficient in units of 2^-ENCODE_FIX of a 
+ *                      quarter step
+ * 
+ * Return: the quantized coefficient
+ *
+ * Notes: truncates toward zero, like the cast in quantize()
+ *      
+ **********************************/
+static inline signed quantizeFixed(int32_t scaled)
+{
+        int32_t steps = (scaled < 0 ? -scaled : scaled) >> (ENCODE_FIX + 2);
+
+        steps = steps > 15 ? 15 : steps;
+        return scaled < 0 ? -steps : steps;
+}
+
+/********** chromaFixed ********
+ * 
+ * Gives the index of a fixed-point average chroma value
+ *
+ * Parameters:
+ *      int32_t scaled: Four times the value, in units of 2^-CHROMA_FIX
+ * 
+ * Return: the index Arith40_index_of_chroma gives the value as a float
+ *
+ * Notes:
+ *      - counts the thresholds reached, without branches
+ *      
+ **********************************/
+static inline unsigned chromaFixed(int32_t scaled)
+{
+        unsigned index = 0;
+
+        for (unsigned k = 0; k < CHROMA_THRESHOLDS; k++) {
+                index += scaled >= chromaSteps[k];
+        }
+        return index;
+}
+
+/********** encodeRowFixed ********
+ * 
+ * Encodes a row of blocks one at a time in fixed point
+ *
+ * Parameters: see encodeRowScalar
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - the coefficients must have been built
+ *      
+ **********************************/
+static void encodeRowFixed(const unsigned char *top, 
+                           const unsigned char *bottom, size_t pitch,
+                           unsigned blocks, struct Compressed *comps)
+{
+        for (unsigned i = 0; i < blocks; i++) {
+                const unsigned char *p1 = top + pitch * i;
+                const unsigned char *p2 = p1 + 3;
+                const unsigned char *p3 = bottom + pitch * i;
+                const unsigned char *p4 = p3 + 3;
+                int32_t sum[3], bq[3], cq[3], dq[3];
+
+                /* Same butterflies as DCTval, one channel at a time */
+                for (unsigned ch = 0; ch < 3; ch++) {
+                        int32_t sum43 = p4[ch] + p3[ch];
+                        int32_t dif43 = p4[ch] - p3[ch];
+
+                        sum[ch] = sum43 + p2[ch] + p1[ch];
+                        bq[ch] = sum43 - p2[ch] - p1[ch];
+                        cq[ch] = dif43 + p2[ch] - p1[ch];
+                        dq[ch] = dif43 - p2[ch] + p1[ch];
+                }
+
+                comps[i].a = quantizeFixedA(dot3(lumaA, sum));
+                comps[i].b = quantizeFixed(dot3(lumaCoef, bq));
+                comps[i].c = quantizeFixed(dot3(lumaCoef, cq));
+                comps[i].d = quantizeFixed(dot3(lumaCoef, dq));
+                comps[i].pb_avg = chromaFixed(dot3(chromaPb, sum));
+                comps[i].pr_avg = chromaFixed(dot3(chromaPr, sum));
+        }
+}
+
+/********** toFixed ********
+ * 
+ * Scales a colour factor to a fixed-point coefficient
+ *
+ * Parameters:
+ *      double factor: The factor applied to a channel on the [0, 1] scale
+ *      double step:   The size of the field's quantization step on the 
+ *                     same scale, or 1 for no step
+ *      unsigned bits:  The fraction bits of the coefficient
+ * 
+ * Return: the coefficient for a channel in [0, 255]
+ *
+ * Notes: none
+ *      
+ **********************************/
+static int32_t toFixed(double factor, double step, unsigned bits)
+{
+        return lround(factor / 255 / step * (1 << bits));
+}
+
+/********** buildCoefficients ********
+ * 
+ * Fills the coefficients of the fixed-point engine
+ *
+ * Parameters: none
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - the factors are those of RGBtoCompVidVal; a's step is 1/511 and
+ *        the step of b, c and d is 1/50, as in DCTval
+ *      
+ **********************************/
+static void buildCoefficients(void)
+{
+        static const double y[3] = { 0.299, 0.587, 0.114 };
+        static const double pb[3] = { -0.168736, -0.331264, 0.5 };
+        static const double pr[3] = { 0.5, -0.418688, -0.081312 };
+
+        for (unsigned ch = 0; ch < 3; ch++) {
+                lumaA[ch] = toFixed(y[ch], 1.0 / 511, ENCODE_FIX);
+                lumaCoef[ch] = toFixed(y[ch], 1.0 / 50, ENCODE_FIX);
+                chromaPb[ch] = toFixed(pb[ch], 1, CHROMA_FIX);
+                chromaPr[ch] = toFixed(pr[ch], 1, CHROMA_FIX);
+        }
+
+        /* Grey has no chroma; keep it at exactly zero despite rounding */
+        chromaPb[2] = -(chromaPb[0] + chromaPb[1]);
+        chromaPr[0] = -(chromaPr[1] + chromaPr[2]);
+
+        ChromaIndex_fixedThresholds(1.0f / (4 << CHROMA_FIX), chromaSteps);
+}
+
+#ifdef ENCODE_AVX2
+
+/* Y, Pb and Pr for eight pixels, one per block */
+struct CompVid8 
+{
+        __m256 y, pb, pr;
+};
+
+/********** loadCompVid8 ********
+ * 
+ * Loads one pixel from each of eight consecutive blocks and converts them
+ * to Component Video
+ *
+ * Parameters:
+ *      const unsigned char *first: The pixel in the first block; the pixel
+ *                                  in block i is pitch * i bytes later
+ *      size_t pitch:               The bytes from one block to the next
+ * 
+ * Return: the eight Component Video values
+ *
+ * Notes:
+ *      - reads one byte past the last pixel, so the caller must make sure
+ *        that byte belongs to the row
+ *      - matches RGBtoCompVidVal: products and sums are done in double
+ *        precision and rounded to float once at the end
+ *      
+ **********************************/
+__attribute__((target("avx2")))
+static struct CompVid8 loadCompVid8(const unsigned char *first, 
+                                    size_t pitch)
+{
+        const __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(
+                0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(pitch));
+        const __m256i byteMask = _mm256_set1_epi32(0xff);
+        const __m256 scale = _mm256_set1_ps(255.0f);
+
+        __m256i raw = _mm256_i32gather_epi32((const int *)first, offsets, 1);
+        __m256 r = _mm256_div_ps(_mm256_cvtepi32_ps(
+                        _mm256_and_si256(raw, byteMask)), scale);
+        __m256 g = _mm256_div_ps(_mm256_cvtepi32_ps(
+                        _mm256_and_si256(_mm256_srli_epi32(raw, 8), 
+                                         byteMask)), scale);
+        __m256 b = _mm256_div_ps(_mm256_cvtepi32_ps(
+                        _mm256_and_si256(_mm256_srli_epi32(raw, 16), 
+                                         byteMask)), scale);
+
+        __m256d rd[2] = { _mm256_cvtps_pd(_mm256_castps256_ps128(r)),
+                          _mm256_cvtps_pd(_mm256_extractf128_ps(r, 1)) };
+        __m256d gd[2] = { _mm256_cvtps_pd(_mm256_castps256_ps128(g)),
+                          _mm256_cvtps_pd(_mm256_extractf128_ps(g, 1)) };
+        __m256d bd[2] = { _mm256_cvtps_pd(_mm256_castps256_ps128(b)),
+                          _mm256_cvtps_pd(_mm256_extractf128_ps(b, 1)) };
+        __m128 y[2], pb[2], pr[2];
+
+        for (int h = 0; h < 2; h++) {
+                __m256d t;
+
+                t = _mm256_add_pd(
+                        _mm256_mul_pd(_mm256_set1_pd(0.299), rd[h]),
+                        _mm256_mul_pd(_mm256_set1_pd(0.587), gd[h]));
+                t = _mm256_add_pd(t, 
+                        _mm256_mul_pd(_mm256_set1_pd(0.114), bd[h]));
+                y[h] = _mm256_cvtpd_ps(t);
+
+                t = _mm256_sub_pd(
+                        _mm256_mul_pd(_mm256_set1_pd(-0.168736), rd[h]),
+                        _mm256_mul_pd(_mm256_set1_pd(0.331264), gd[h]));
+                t = _mm256_add_pd(t, 
+                        _mm256_mul_pd(_mm256_set1_pd(0.5), bd[h]));
+                pb[h] = _mm256_cvtpd_ps(t);
+
+                t = _mm256_sub_pd(
+                        _mm256_mul_pd(_mm256_set1_pd(0.5), rd[h]),
+                        _mm256_mul_pd(_mm256_set1_pd(0.418688), gd[h]));
+                t = _mm256_sub_pd(t, 
+                        _mm256_mul_pd(_mm256_set1_pd(0.081312), bd[h]));
+                pr[h] = _mm256_cvtpd_ps(t);
+        }
+
+        struct CompVid8 cv;
+        cv.y = _mm256_set_m128(y[1], y[0]);
+        cv.pb = _mm256_set_m128(pb[1], pb[0]);
+        cv.pr = _mm256_set_m128(pr[1], pr[0]);
+        return cv;
+}
+
+/********** quantize8 ********
+ * 
+ * Quantizes eight b, c or d coefficients, like quantize()
+ *
+ * Parameters:
+ *      __m256 num: The coefficients
+ * 
+ * Return: the quantized coefficients
+ *
+ * Notes: none
+ *      
+ **********************************/
+__attribute__((target("avx2")))
+static __m256i quantize8(__m256 num)
+{
+        num = _mm256_min_ps(_mm256_max_ps(num, _mm256_set1_ps(-0.3f)), 
+                            _mm256_set1_ps(0.3f));
+        return _mm256_cvttps_epi32(_mm256_mul_ps(num, _mm256_set1_ps(50)));
+}
+
+/********** chromaIndex8 ********
+ * 
+ * Quantizes eight chroma values, like ChromaIndex_of
+ *
+ * Parameters:
+ *      __m256 value:            The values
+ *      const float *thresholds: From ChromaIndex_thresholds
+ * 
+ * Return: the indices
+ *
+ * Notes:
+ *      - each comparison gives -1 in the lanes that reach the threshold,
+ *        so subtracting it counts them
+ *      
+ **********************************/
+__attribute__((target("avx2")))
+static __m256i chromaIndex8(__m256 value, const float *thresholds)
+{
+        __m256i index = _mm256_setzero_si256();
+
+        for (unsigned k = 0; k < CHROMA_THRESHOLDS; k++) {
+                __m256 reached = _mm256_cmp_ps(value, 
+                        _mm256_broadcast_ss(&thresholds[k]), _CMP_GE_OQ);
+                index = _mm256_sub_epi32(index, _mm256_castps_si256(reached));
+        }
+        return index;
+}
+
+/********** encodeRowAvx2 ********
+ * 
+ * Encodes a row of blocks eight at a time with AVX2
+ *
+ * Parameters: see encodeRowScalar
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - the last group of blocks is always left to the scalar kernel,
+ *        so the gathers never read past the end of the row
+ *      
+ **********************************/
+__attribute__((target("avx2")))
+static void encodeRowAvx2(const unsigned char *top, 
+                          const unsigned char *bottom, size_t pitch,
+                          unsigned blocks, struct Compressed *comps)
+{
+        const __m256 quarter = _mm256_set1_ps(0.25f);
+        const float *thresholds = ChromaIndex_thresholds();
+        unsigned i = 0;
+
+        for (; i + 8 < blocks; i += 8) {
+                struct CompVid8 cv1 = loadCompVid8(top + pitch * i, pitch);
+                struct CompVid8 cv2 = loadCompVid8(top + pitch * i + 3, 
+                                                   pitch);
+                struct CompVid8 cv3 = loadCompVid8(bottom + pitch * i, 
+                                                   pitch);
+                struct CompVid8 cv4 = loadCompVid8(bottom + pitch * i + 3,
+                                                   pitch);
+
+                /* Same association order as DCTval */
+                __m256 pb = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(
+                        _mm256_add_ps(cv1.pb, cv2.pb), cv3.pb), cv4.pb), 
+                        quarter);
+                __m256 pr = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(
+                        _mm256_add_ps(cv1.pr, cv2.pr), cv3.pr), cv4.pr), 
+                        quarter);
+
+                __m256 sum43 = _mm256_add_ps(cv4.y, cv3.y);
+                __m256 dif43 = _mm256_sub_ps(cv4.y, cv3.y);
+                __m256 a = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(
+                        sum43, cv2.y), cv1.y), quarter);
+                __m256 b = _mm256_mul_ps(_mm256_sub_ps(_mm256_sub_ps(
+                        sum43, cv2.y), cv1.y), quarter);
+                __m256 c = _mm256_mul_ps(_mm256_sub_ps(_mm256_add_ps(
+                        dif43, cv2.y), cv1.y), quarter);
+                __m256 d = _mm256_mul_ps(_mm256_add_ps(_mm256_sub_ps(
+                        dif43, cv2.y), cv1.y), quarter);
+
+                /* round() of a non-negative value: truncate, then add one 
+                 * if the dropped fraction is at least a half */
+                a = _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(a, 
+                        _mm256_setzero_ps()), _mm256_set1_ps(1)), 
+                        _mm256_set1_ps(511));
+                __m256 whole = _mm256_round_ps(a, _MM_FROUND_TO_ZERO | 
+                                                  _MM_FROUND_NO_EXC);
+                __m256 up = _mm256_and_ps(_mm256_cmp_ps(
+                        _mm256_sub_ps(a, whole), _mm256_set1_ps(0.5f), 
+                        _CMP_GE_OQ), _mm256_set1_ps(1));
+                __m256i aq = _mm256_cvttps_epi32(_mm256_add_ps(whole, up));
+
+                int av[8], bv[8], cv[8], dv[8], pbv[8], prv[8];
+                _mm256_storeu_si256((__m256i *)av, aq);
+                _mm256_storeu_si256((__m256i *)bv, quantize8(b));
+                _mm256_storeu_si256((__m256i *)cv, quantize8(c));
+                _mm256_storeu_si256((__m256i *)dv, quantize8(d));
+                _mm256_storeu_si256((__m256i *)pbv, 
+                                    chromaIndex8(pb, thresholds));
+                _mm256_storeu_si256((__m256i *)prv, 
+                                    chromaIndex8(pr, thresholds));
+
+                for (unsigned j = 0; j < 8; j++) {
+                        struct Compressed *comp = &comps[i + j];
+                        comp->pb_avg = pbv[j];
+                        comp->pr_avg = prv[j];
+                        comp->a = av[j];
+                        comp->b = bv[j];
+                        comp->c = cv[j];
+                        comp->d = dv[j];
+                }
+        }
+
+        encodeRowScalar(top + pitch * i, bottom + pitch * i, pitch, 
+                        blocks - i, comps + i);
+}
+
+/* The butterflied channels of eight blocks, as in encodeRowFixed */
+struct Butterflies8
+{
+        __m256i sum[3], bq[3], cq[3], dq[3];
+};
+
+/********** butterflies8 ********
+ * 
+ * Loads eight consecutive blocks and butterflies each of their channels
+ *
+ * Parameters:
+ *      const unsigned char *top:    The first block's top-left pixel
+ *      const unsigned char *bottom: The first block's bottom-left pixel
+ *      size_t pitch:                The bytes from one block to the next
+ * 
+ * Return: the butterflied channels
+ *
+ * Notes:
+ *      - reads one byte past the last block, like loadCompVid8
+ *      
+ **********************************/
+__attribute__((target("avx2")))
+static struct Butterflies8 butterflies8(const unsigned char *top,
+                                        const unsigned char *bottom,
+                                        size_t pitch)
+{
+        const __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(
+                0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(pitch));
+        const __m256i byteMask = _mm256_set1_epi32(0xff);
+        __m256i p1 = _mm256_i32gather_epi32((const int *)top, offsets, 1);
+        __m256i p2 = _mm256_i32gather_epi32((const int *)(top + 3), 
+                                            offsets, 1);
+        __m256i p3 = _mm256_i32gather_epi32((const int *)bottom, offsets, 1);
+        __m256i p4 = _mm256_i32gather_epi32((const int *)(bottom + 3), 
+                                            offsets, 1);
+        struct Butterflies8 bf;
+
+        for (int ch = 0; ch < 3; ch++) {
+                __m256i y1 = _mm256_and_si256(p1, byteMask);
+                __m256i y2 = _mm256_and_si256(p2, byteMask);
+                __m256i y3 = _mm256_and_si256(p3, byteMask);
+                __m256i y4 = _mm256_and_si256(p4, byteMask);
+                __m256i sum43 = _mm256_add_epi32(y4, y3);
+                __m256i dif43 = _mm256_sub_epi32(y4, y3);
+                __m256i sum21 = _mm256_add_epi32(y2, y1);
+                __m256i dif21 = _mm256_sub_epi32(y2, y1);
+
+                bf.sum[ch] = _mm256_add_epi32(sum43, sum21);
+                bf.bq[ch] = _mm256_sub_epi32(sum43, sum21);
+                bf.cq[ch] = _mm256_add_epi32(dif43, dif21);
+                bf.dq[ch] = _mm256_sub_epi32(dif43, dif21);
+
+                p1 = _mm256_srli_epi32(p1, 8);
+                p2 = _mm256_srli_epi32(p2, 8);
+                p3 = _mm256_srli_epi32(p3, 8);
+                p4 = _mm256_srli_epi32(p4, 8);
+        }
+
+        return bf;
+}
+
+/********** dot8 ********
+ * 
+ * Combines the red, green and blue terms of eight fixed-point fields
+ *
+ * Parameters:
+ *      const int32_t coef[3]: The field's coefficients
+ *      const __m256i sums[3]: The butterflied channels of the blocks
+ * 
+ * Return: the fields in fixed point, like dot3
+ *
+ * Notes: none
+ *      
+ **********************************/
+__attribute__((target("avx2")))
+static __m256i dot8(const int32_t coef[3], const __m256i sums[3])
+{
+        return _mm256_add_epi32(_mm256_add_epi32(
+                _mm256_mullo_epi32(_mm256_set1_epi32(coef[0]), sums[0]),
+                _mm256_mullo_epi32(_mm256_set1_epi32(coef[1]), sums[1])),
+                _mm256_mullo_epi32(_mm256_set1_epi32(coef[2]), sums[2]));
+}
+
+/********** quantizeFixed8 ********
+ * 
+ * Quantizes eight fixed-point b, c or d coefficients, like quantizeFixed
+ *
+ * Parameters:
+ *      __m256i scaled: The coefficients
+ * 
+ * Return: the quantized coefficients
+ *
+ * Notes: none
+ *      
+ **********************************/
+__attribute__((target("avx2")))
+static __m256i quantizeFixed8(__m256i scaled)
+{
+        __m256i steps = _mm256_srli_epi32(_mm256_abs_epi32(scaled), 
+                                          ENCODE_FIX + 2);
+
+        steps = _mm256_min_epi32(steps, _mm256_set1_epi32(15));
+        return _mm256_sign_epi32(steps, scaled);
+}
+
+/********** chromaFixed8 ********
+ * 
+ * Quantizes eight fixed-point chroma averages, like chromaFixed
+ *
+ * Parameters:
+ *      __m256i scaled: The averages, as from dot8
+ * 
+ * Return: the indices
+ *
+ * Notes: none
+ *      
+ **********************************/
+__attribute__((target("avx2")))
+static __m256i chromaFixed8(__m256i scaled)
+{
+        __m256i index = _mm256_setzero_si256();
+
+        for (unsigned k = 0; k < CHROMA_THRESHOLDS; k++) {
+                /* scaled >= step, as scaled > step - 1 */
+                __m256i reached = _mm256_cmpgt_epi32(scaled, 
+                        _mm256_set1_epi32(chromaSteps[k] - 1));
+                index = _mm256_sub_epi32(index, reached);
+        }
+        return index;
+}
+
+/********** encodeRowFixedAvx2 ********
+ * 
+ * Encodes a row of blocks eight at a time in fixed point with AVX2
+ *
+ * Parameters: see encodeRowScalar
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - the last group of blocks is always left to the scalar kernel,
+ *        so the gathers never read past the end of the row
+ *      
+ **********************************/
+__attribute__((target("avx2")))
+static void encodeRowFixedAvx2(const unsigned char *top, 
+                               const unsigned char *bottom, size_t pitch,
+                               unsigned blocks, struct Compressed *comps)
+{
+        unsigned i = 0;
+
+        for (; i + 8 < blocks; i += 8) {
+                struct Butterflies8 bf = butterflies8(top + pitch * i, 
+                                                      bottom + pitch * i,
+                                                      pitch);
+
+                /* round() as in quantizeFixedA */
+                __m256i aq = _mm256_min_epi32(_mm256_max_epi32(
+                        dot8(lumaA, bf.sum), _mm256_setzero_si256()),
+                        _mm256_set1_epi32((4 * 511) << ENCODE_FIX));
+                aq = _mm256_srai_epi32(_mm256_add_epi32(aq, 
+                        _mm256_set1_epi32(2 << ENCODE_FIX)), ENCODE_FIX + 2);
+
+                int av[8], bv[8], cv[8], dv[8], pbv[8], prv[8];
+                _mm256_storeu_si256((__m256i *)av, aq);
+                _mm256_storeu_si256((__m256i *)bv, 
+                                    quantizeFixed8(dot8(lumaCoef, bf.bq)));
+                _mm256_storeu_si256((__m256i *)cv, 
+                                    quantizeFixed8(dot8(lumaCoef, bf.cq)));
+                _mm256_storeu_si256((__m256i *)dv, 
+                                    quantizeFixed8(dot8(lumaCoef, bf.dq)));
+                _mm256_storeu_si256((__m256i *)pbv, 
+                                    chromaFixed8(dot8(chromaPb, bf.sum)));
+                _mm256_storeu_si256((__m256i *)prv, 
+                                    chromaFixed8(dot8(chromaPr, bf.sum)));
+
+                for (unsigned j = 0; j < 8; j++) {
+                        struct Compressed *comp = &comps[i + j];
+                        comp->pb_avg = pbv[j];
+                        comp->pr_avg = prv[j];
+                        comp->a = av[j];
+                        comp->b = bv[j];
+                        comp->c = cv[j];
+                        comp->d = dv[j];
+                }
+        }
+
+        encodeRowFixed(top + pitch * i, bottom + pitch * i, pitch, 
+                       blocks - i, comps + i);
+}
+
+#endif
+
+/********** pickKernel ********
+ * 
+ * Builds the coefficients and picks the fastest kernels the CPU supports
+ *
+ * Parameters: none
+ * 
+ * Return: none
+ *
+ * Notes: runs once, through pthread_once
+ *      
+ **********************************/
+static void pickKernel(void)
+{
+        buildCoefficients();
+
+#ifdef ENCODE_AVX2
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+                exactRow = encodeRowAvx2;
+                fixedRow = encodeRowFixedAvx2;
+        }
+#endif
+}
@@ -0,0 +1,30 @@
+/**************************************************************
+ *
+ *                     encodeKernel.h
+ *
+ *     Assignment: arith
+ *     Authors: Anh Hoang, Emilio Aleman
+ *     Date:  3/8/2024
+ *
+ *    This file contains the declaration of the encoder kernel, which turns
+ *    a whole row of 2x2 blocks of a packed image into Compressed values.
+ *    Two engines are available: fixed-point integer arithmetic (the 
+ *    default), whose fields may be one step away from the floating-point
+ *    pipeline's, and the floating-point pipeline itself.
+ *
+ **************************************************************/
+#ifndef ENCODEKERNEL_INCLUDED
+#define ENCODEKERNEL_INCLUDED
+
+#include <stdlib.h>
+#include "helpers.h"
+
+typedef enum { ENCODE_FIXED, ENCODE_EXACT } Encode_engine;
+
+void encodeSetEngine(Encode_engine engine);
+void encodeBlockRow(const unsigned char *top, const unsigned char *bottom,
+                    unsigned blocks, struct Compressed *comps);
+void encodeTileRow(const unsigned char *tiles, unsigned blocks, 
+                   struct Compressed *comps);
+
+#endif
@@ -104,6 +104,60 @@ void freeDecompression(Compressed comp, CompVidBlock cvBlock, rgbBlock rgbBlock)
         FREE(rgbBlock);
 }
 
+/********** readCompressedHeader ********
+ * 
+ * Reads the header of a compressed image
+ *
+ * Parameters:
+ *      FILE *input:      A pointer to the input file stream containing 
+ *                        the compressed image.
+ *      unsigned *width:  Set to the width of the image
+ *      unsigned *height: Set to the height of the image
+ *
+ * Return: the format, 2 for plain codewords or 3 for chunked (see
+ *         chunked.h), whose header goes on past the height line
+ *
+ * Notes:
+ *      - CRE if the header is badly formatted or of another format
+ * 
+ ******************************/
+int readCompressedHeader(FILE *input, unsigned *width, unsigned *height)
+{
+        assert(input != NULL && width != NULL && height != NULL);
+
+        int format;
+        int read = fscanf(input, "COMP40 Compressed image format %d\n%u %u",
+                          &format, width, height);
+        assert(read == 3 && (format == 2 || format == 3));
+        int c = getc(input);
+        assert(c == '\n');
+
+        return format;
+}
+
+/********** writeCompressedHeader ********
+ * 
+ * Writes the header of a compressed image
+ *
+ * Parameters:
+ *      FILE *output:    The stream to write to
+ *      unsigned width:  The width of the image
+ *      unsigned height: The height of the image
+ *
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if output is NULL
+ * 
+ ******************************/
+void writeCompressedHeader(FILE *output, unsigned width, unsigned height)
+{
+        assert(output != NULL);
+
+        fprintf(output, "COMP40 Compressed image format 2\n%u %u\n", 
+                width, height);
+}
+
 /********** readHeader ********
  * 
  * Reads the header of a compressed PPM file
@@ -128,11 +182,8 @@ Pnm_ppm readHeader(FILE *input)
         assert(methods != NULL);
 
         unsigned height, width;
-        int read = fscanf(input, "COMP40 Compressed image format 2\n%u %u", 
-                          &width, &height);
-        assert(read == 2);
-        int c = getc(input);
-        assert(c == '\n');
+        int format = readCompressedHeader(input, &width, &height);
+        assert(format == 2);
         
         pixmap->width = width;
         pixmap->height = height;
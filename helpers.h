@@ -53,7 +53,24 @@ struct rgbBlock
         RGB rgb1, rgb2, rgb3, rgb4;
 };
 
+/* 
+ * Value versions of the blocks above. These hold the four pixels of a 2x2
+ * block directly so the caller can keep them on the stack and reuse them
+ * for every block without touching the heap.
+ */
+struct rgbQuad
+{
+        struct RGB rgb1, rgb2, rgb3, rgb4;
+};
+
+struct CompVidQuad
+{
+        struct ComponentVideo cv1, cv2, cv3, cv4;
+};
+
 float inRange(float num, float min, float max);
+int readCompressedHeader(FILE *input, unsigned *width, unsigned *height);
+void writeCompressedHeader(FILE *output, unsigned width, unsigned height);
 Pnm_ppm readHeader(FILE *input);
 void freeCompression(rgbBlock rgbBlock, CompVidBlock cvBlock);
 void freeDecompression(Compressed comp, CompVidBlock cvBlock, 
@@ -0,0 +1,206 @@
+/**************************************************************
+ *
+ *                     mappedFile.c
+ *
+ *     Assignment: arith
+ *     Authors: Anh Hoang, Emilio Aleman
+ *     Date:  3/8/2024
+ *
+ *    This file contains the implementation of memory-mapped input and
+ *    output files. An input is mapped whole and read-only, with a hint
+ *    that it will be read in order. An output is reserved with
+ *    posix_fallocate at the stream's position before it is mapped, so a
+ *    full disk shows up as a fallback to stdio rather than as SIGBUS
+ *    halfway through; when the mapping is closed the stream's position
+ *    moves past the bytes, as if they had been written.
+ *
+ **************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "assert.h"
+#include "mem.h"
+#include "mappedFile.h"
+
+static MappedFile mapRegion(int fd, int mapFd, off_t at, size_t size,
+                            int prot);
+
+/********** MappedFile_input ********
+ * 
+ * Maps the whole of a regular file for reading
+ *
+ * Parameters:
+ *      FILE *input: The stream to map; its position does not move
+ * 
+ * Return: the mapping, from the first byte of the file, or NULL if input
+ *         is not a regular file, is empty or cannot be mapped
+ *
+ * Notes:
+ *      - CRE if input is NULL
+ *      - the mapping must be closed with MappedFile_close
+ *      
+ **********************************/
+MappedFile MappedFile_input(FILE *input)
+{
+        assert(input != NULL);
+        int fd = fileno(input);
+        struct stat info;
+
+        if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) ||
+            info.st_size == 0) {
+                return NULL;
+        }
+
+        MappedFile file = mapRegion(fd, fd, 0, info.st_size, PROT_READ);
+        if (file == NULL) {
+                return NULL;
+        }
+
+        madvise(file->base, file->length, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+        madvise(file->base, file->length, MADV_HUGEPAGE);
+#endif
+        file->end = -1;
+
+        return file;
+}
+
+/********** MappedFile_output ********
+ * 
+ * Maps the next bytes of a regular file for writing
+ *
+ * Parameters:
+ *      FILE *output: The stream to write to, at the position the bytes
+ *                    go; it is flushed first
+ *      size_t size:  Exactly how many bytes will be written
+ * 
+ * Return: the mapping, or NULL if output is not a regular file, is open
+ *         for appending, or cannot be grown or mapped
+ *
+ * Notes:
+ *      - CRE if output is NULL
+ *      - every byte of the mapping should be written before it is closed
+ *      - a descriptor open only for writing, as a shell's > leaves it,
+ *        cannot be mapped; it is reopened for reading and writing
+ *        through /proc/self/fd where there is one
+ *      
+ **********************************/
+MappedFile MappedFile_output(FILE *output, size_t size)
+{
+        assert(output != NULL);
+        int fd = fileno(output);
+        struct stat info;
+
+        int flags = fcntl(fd, F_GETFL);
+        if (size == 0 || flags < 0 || (flags & O_APPEND) ||
+            fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+                return NULL;
+        }
+
+        fflush(output);
+        off_t at = lseek(fd, 0, SEEK_CUR);
+        if (at < 0) {
+                return NULL;
+        }
+
+        int mapFd = fd;
+        if ((flags & O_ACCMODE) != O_RDWR) {
+                char path[32];
+                snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+                mapFd = open(path, O_RDWR);
+                if (mapFd < 0) {
+                        return NULL;
+                }
+        }
+
+        MappedFile file = NULL;
+        if (posix_fallocate(mapFd, at, size) == 0) {
+                file = mapRegion(fd, mapFd, at, size,
+                                 PROT_READ | PROT_WRITE);
+        }
+        if (file == NULL) {
+                if (mapFd != fd) {
+                        close(mapFd);
+                }
+                return NULL;
+        }
+        file->end = at + size;
+
+        return file;
+}
+
+/********** MappedFile_close ********
+ * 
+ * Unmaps a file, moving an output's position past its bytes
+ *
+ * Parameters:
+ *      MappedFile *file: Pointer to the mapping
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if file or *file is NULL; *file is set to NULL
+ *      - the stream stays open
+ *      
+ **********************************/
+void MappedFile_close(MappedFile *file)
+{
+        assert(file != NULL && *file != NULL);
+        MappedFile mapped = *file;
+
+        munmap(mapped->base, mapped->length);
+        if (mapped->end >= 0) {
+                lseek(mapped->fd, mapped->end, SEEK_SET);
+        }
+        if (mapped->mapFd != mapped->fd) {
+                close(mapped->mapFd);
+        }
+        FREE(*file);
+}
+
+/********** mapRegion ********
+ * 
+ * Maps bytes of a file, from the page holding the first of them
+ *
+ * Parameters:
+ *      int fd:      The stream's descriptor
+ *      int mapFd:   The descriptor to map, fd or a reopened copy
+ *      off_t at:    The offset of the first byte
+ *      size_t size: How many bytes
+ *      int prot:    PROT_READ, or PROT_READ | PROT_WRITE
+ * 
+ * Return: the mapping, or NULL if mmap fails
+ *
+ * Notes:
+ *      - a writable mapping is shared, so its stores reach the file
+ *      
+ **********************************/
+static MappedFile mapRegion(int fd, int mapFd, off_t at, size_t size,
+                            int prot)
+{
+        off_t page = sysconf(_SC_PAGESIZE);
+        off_t start = at - at % page;
+        size_t length = size + (at - start);
+
+        void *base = mmap(NULL, length, prot,
+                          prot & PROT_WRITE ? MAP_SHARED : MAP_PRIVATE,
+                          mapFd, start);
+        if (base == MAP_FAILED) {
+                return NULL;
+        }
+
+        MappedFile file;
+        NEW(file);
+        file->base = base;
+        file->length = length;
+        file->bytes = (unsigned char *)base + (at - start);
+        file->size = size;
+        file->fd = fd;
+        file->mapFd = mapFd;
+
+        return file;
+}
@@ -0,0 +1,41 @@
+/**************************************************************
+ *
+ *                     mappedFile.h
+ *
+ *     Assignment: arith
+ *     Authors: Anh Hoang, Emilio Aleman
+ *     Date:  3/8/2024
+ *
+ *    This file contains the declaration of memory-mapped input and output
+ *    files. When 40image reads or writes a regular file, the pipeline can
+ *    work on the file's pages directly instead of copying every byte
+ *    through stdio. Either function gives NULL when the stream cannot be
+ *    mapped (a pipe or terminal, say), and the caller falls back to stdio.
+ *
+ **************************************************************/
+#ifndef MAPPEDFILE_INCLUDED
+#define MAPPEDFILE_INCLUDED
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+typedef struct MappedFile *MappedFile;
+
+/* bytes is the mapped region, size bytes long. The other fields are
+ * private to mappedFile.c. */
+struct MappedFile
+{
+        unsigned char *bytes;
+        size_t size;
+        void *base;
+        size_t length;
+        int fd, mapFd;
+        off_t end;
+};
+
+MappedFile MappedFile_input(FILE *input);
+MappedFile MappedFile_output(FILE *output, size_t size);
+void MappedFile_close(MappedFile *file);
+
+#endif
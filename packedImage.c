@@ -0,0 +1,981 @@
+/**************************************************************
+ *
+ *                     packedImage.c
+ *
+ *     Assignment: arith
+ *     Authors: Anh Hoang, Emilio Aleman
+ *     Date:  3/8/2024
+ *
+ *    This file contains the implementation of the packed image type:
+ *    allocation, and reading and writing PPM images straight into and
+ *    out of the packed buffer.
+ *
+ **************************************************************/
+#include <ctype.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include "plainPpm.h"
+#include "packedImage.h"
+
+/* The headers of the PPMs this module writes */
+#define P6_HEADER "P6\n%u %u\n255\n"
+#define P3_HEADER "P3\n%u %u\n255\n"
+
+/* Rows totalling at least this many bytes skip stdio's buffer and go out
+ * in one writev */
+#define BULK_BYTES 65536
+
+/* Rows given to one writev; IOV_MAX is 1024 on Linux, and POSIX allows
+ * as few as 16 */
+#if defined(IOV_MAX) && IOV_MAX < 1024
+#define WRITE_ROWS IOV_MAX
+#else
+#define WRITE_ROWS 1024
+#endif
+
+/* Samples per line of a P3 payload, which keeps lines under 70 chars */
+#define PLAIN_LINE 15
+
+/* A tiled image is written out about this many bytes of rows at a time */
+#define UNTILE_BYTES 262144
+
+static PackedImage_format format = PPM_RAW;
+
+/* The text of each sample value, a space included, for P3 payloads */
+static char digits[256][5];
+static unsigned char lengths[256];
+
+static void writeRaw(FILE *output, const unsigned char *src, size_t stride,
+                     size_t rowBytes, unsigned rows);
+static void writePlain(FILE *output, const unsigned char *src, 
+                       size_t stride, size_t rowBytes, unsigned rows);
+static void writeAll(FILE *output, struct iovec *iov, int count);
+
+static void skipSpace(FILE *input);
+static unsigned readNumber(FILE *input);
+static void readRawRows(FILE *input, const struct PpmHeader *header,
+                        unsigned char *dest, size_t stride, unsigned rows);
+static void readPlainRows(FILE *input, const struct PpmHeader *header,
+                          unsigned char *dest, size_t stride, unsigned rows);
+static void readPlain(FILE *input, const struct PpmHeader *header,
+                      PackedImage image, unsigned threads);
+static PackedImage readRawTiled(FILE *input, 
+                                const struct PpmHeader *header);
+static void writeTiled(FILE *output, PackedImage image);
+static void tileRows(const unsigned char *top, const unsigned char *bottom,
+                     unsigned blocks, unsigned char *tiles);
+static void untileRows(const unsigned char *tiles, unsigned blocks,
+                       unsigned char *top, unsigned char *bottom);
+
+/********** PackedImage_new ********
+ * 
+ * Allocates a packed image of the given dimensions
+ *
+ * Parameters:
+ *      unsigned width:  The width of the image in pixels
+ *      unsigned height: The height of the image in pixels
+ * 
+ * Return: the new PackedImage, with uninitialized pixels
+ *
+ * Notes:
+ *      - the image must be freed with PackedImage_free
+ *      
+ **********************************/
+PackedImage PackedImage_new(unsigned width, unsigned height)
+{
+        PackedImage image;
+        NEW(image);
+
+        image->width = width;
+        image->height = height;
+        image->stride = (size_t)width * 3;
+        /* One spare byte keeps ALLOC happy for empty images */
+        image->pixels = ALLOC(image->stride * height + 1);
+        image->mapped = NULL;
+        image->tiled = 0;
+
+        return image;
+}
+
+/********** PackedImage_newTiled ********
+ * 
+ * Allocates a packed image of the given dimensions in the tiled layout
+ *
+ * Parameters:
+ *      unsigned width:  The width of the image in pixels, even
+ *      unsigned height: The height of the image in pixels, even
+ * 
+ * Return: the new PackedImage, with uninitialized pixels
+ *
+ * Notes:
+ *      - CRE if width or height is odd
+ *      - the image must be freed with PackedImage_free
+ *      
+ **********************************/
+PackedImage PackedImage_newTiled(unsigned width, unsigned height)
+{
+        assert(width % 2 == 0 && height % 2 == 0);
+
+        PackedImage image = PackedImage_new(width, height);
+        image->tiled = 1;
+
+        return image;
+}
+
+/********** PackedImage_free ********
+ * 
+ * Frees a packed image and its pixels
+ *
+ * Parameters:
+ *      PackedImage *image: Pointer to the image to free
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if image or *image is NULL
+ *      - *image is set to NULL
+ *      - a mapped image is unmapped; for PackedImage_mapOutput this is
+ *        what finishes writing it
+ *      
+ **********************************/
+void PackedImage_free(PackedImage *image)
+{
+        assert(image != NULL && *image != NULL);
+
+        if ((*image)->mapped != NULL) {
+                MappedFile_close(&(*image)->mapped);
+        } else {
+                FREE((*image)->pixels);
+        }
+        FREE(*image);
+}
+
+/********** PackedImage_read ********
+ * 
+ * Reads a PPM image (raw P6 or plain P3) into a new packed image
+ *
+ * Parameters:
+ *      FILE *input:      A pointer to the input file stream 
+ *                        containing the PPM image.
+ *      unsigned threads: How many threads may parse a plain payload
+ * 
+ * Return: the new PackedImage
+ *
+ * Notes:
+ *      - CRE if input is NULL or the image is badly formatted
+ *      - samples are rescaled to [0, 255] when the maxval is not 255
+ *      - a plain payload is read to the end of input
+ *      
+ **********************************/
+PackedImage PackedImage_read(FILE *input, unsigned threads)
+{
+        struct PpmHeader header;
+        PackedImage_readHeader(input, &header);
+
+        PackedImage image = PackedImage_new(header.width, header.height);
+        if (header.raw) {
+                PackedImage_readRows(input, &header, image->pixels, 
+                                     image->stride, header.height);
+        } else {
+                readPlain(input, &header, image, threads);
+        }
+
+        return image;
+}
+
+/********** PackedImage_readTiled ********
+ * 
+ * Reads a PPM image (raw P6 or plain P3) into a new tiled image
+ *
+ * Parameters:
+ *      FILE *input:      A pointer to the input file stream 
+ *                        containing the PPM image.
+ *      unsigned threads: How many threads may parse a plain payload
+ *      unsigned *width:  Set to the width in the header
+ *      unsigned *height: Set to the height in the header
+ * 
+ * Return: the new PackedImage, without the last column or row of an 
+ *         image whose width or height is odd
+ *
+ * Notes:
+ *      - CRE if input is NULL or the image is badly formatted
+ *      - a raw image is tiled as it is read, from its mapping or one pair
+ *        of rows at a time, so the rows are never stored whole; a plain
+ *        payload is parsed as by PackedImage_read and then tiled
+ *      - the last row of an image with an odd height is never read
+ *      
+ **********************************/
+PackedImage PackedImage_readTiled(FILE *input, unsigned threads,
+                                  unsigned *width, unsigned *height)
+{
+        assert(width != NULL && height != NULL);
+
+        PackedImage rows = PackedImage_map(input);
+        if (rows == NULL) {
+                struct PpmHeader header;
+                PackedImage_readHeader(input, &header);
+                *width = header.width;
+                *height = header.height;
+                if (header.raw) {
+                        return readRawTiled(input, &header);
+                }
+
+                rows = PackedImage_new(header.width, header.height);
+                readPlain(input, &header, rows, threads);
+        } else {
+                *width = rows->width;
+                *height = rows->height;
+        }
+
+        PackedImage image = PackedImage_newTiled(rows->width & ~1u,
+                                                 rows->height & ~1u);
+        for (unsigned row = 0; row < image->height; row += 2) {
+                const unsigned char *top = rows->pixels + 
+                                           row * rows->stride;
+
+                tileRows(top, top + rows->stride, image->width / 2,
+                         image->pixels + row * image->stride);
+        }
+        PackedImage_free(&rows);
+
+        return image;
+}
+
+/********** PackedImage_map ********
+ * 
+ * Maps a raw PPM with a maxval of 255 and uses its payload in place as a
+ * packed image, without copying it
+ *
+ * Parameters:
+ *      FILE *input: The stream containing the PPM image
+ * 
+ * Return: the new PackedImage, whose pixels must not be written, or NULL
+ *         if input is not a regular file or holds any other kind of PPM
+ *
+ * Notes:
+ *      - CRE if input is NULL or the header is badly formatted
+ *      - on NULL, input is back where it was, ready for PackedImage_read
+ *      - the image must be freed with PackedImage_free, which unmaps it
+ *      
+ **********************************/
+PackedImage PackedImage_map(FILE *input)
+{
+        assert(input != NULL);
+
+        MappedFile file = MappedFile_input(input);
+        if (file == NULL) {
+                return NULL;
+        }
+
+        struct PpmHeader header;
+        long start = ftell(input);
+        PackedImage_readHeader(input, &header);
+        long payload = ftell(input);
+        size_t bytes = (size_t)header.width * 3 * header.height;
+
+        /* A short payload goes through PackedImage_read, which reports it */
+        if (!header.raw || header.maxval != 255 || start < 0 || 
+            payload < 0 || (size_t)payload + bytes > file->size) {
+                MappedFile_close(&file);
+                fseek(input, start, SEEK_SET);
+                return NULL;
+        }
+
+        PackedImage image;
+        NEW(image);
+        image->width = header.width;
+        image->height = header.height;
+        image->stride = (size_t)header.width * 3;
+        image->pixels = file->bytes + payload;
+        image->mapped = file;
+        image->tiled = 0;
+
+        return image;
+}
+
+/********** PackedImage_mapOutput ********
+ * 
+ * Makes a packed image whose pixels are the payload of a raw P6 PPM
+ * mapped into output, so that filling it writes the image
+ *
+ * Parameters:
+ *      FILE *output:    The stream to write to
+ *      unsigned width:  The width of the image
+ *      unsigned height: The height of the image
+ * 
+ * Return: the new PackedImage, with the header written and the pixels 
+ *         uninitialized, or NULL if output cannot be mapped or the format
+ *         is PPM_PLAIN
+ *
+ * Notes:
+ *      - CRE if output is NULL
+ *      - the image is complete in the file once PackedImage_free unmaps
+ *        it; it must not also be passed to PackedImage_write
+ *      
+ **********************************/
+PackedImage PackedImage_mapOutput(FILE *output, unsigned width, 
+                                  unsigned height)
+{
+        assert(output != NULL);
+        if (format == PPM_PLAIN) {
+                return NULL;
+        }
+
+        char header[64];
+        int length = snprintf(header, sizeof(header), P6_HEADER, width, 
+                              height);
+        size_t stride = (size_t)width * 3;
+
+        MappedFile file = MappedFile_output(output, length + stride * 
+                                                    height);
+        if (file == NULL) {
+                return NULL;
+        }
+        memcpy(file->bytes, header, length);
+
+        PackedImage image;
+        NEW(image);
+        image->width = width;
+        image->height = height;
+        image->stride = stride;
+        image->pixels = file->bytes + length;
+        image->mapped = file;
+        image->tiled = 0;
+
+        return image;
+}
+
+/********** PackedImage_readHeader ********
+ * 
+ * Reads the header of a PPM image (raw P6 or plain P3)
+ *
+ * Parameters:
+ *      FILE *input:              The stream containing the PPM image
+ *      struct PpmHeader *header: Set to what the header says
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if input or header is NULL or the header is badly formatted
+ *      - leaves input at the first sample
+ *      
+ **********************************/
+void PackedImage_readHeader(FILE *input, struct PpmHeader *header)
+{
+        assert(input != NULL && header != NULL);
+
+        int magic = getc(input);
+        int kind = getc(input);
+        assert(magic == 'P' && (kind == '6' || kind == '3'));
+
+        header->raw = (kind == '6');
+        header->width = readNumber(input);
+        header->height = readNumber(input);
+        header->maxval = readNumber(input);
+        assert(header->width > 0 && header->height > 0);
+        assert(header->maxval > 0 && header->maxval < 65536);
+
+        if (header->raw) {
+                /* A single whitespace character ends a raw header */
+                int c = getc(input);
+                assert(c != EOF && isspace(c));
+        }
+}
+
+/********** PackedImage_readRows ********
+ * 
+ * Reads the next rows of a PPM image's pixels as packed 8-bit RGB
+ *
+ * Parameters:
+ *      FILE *input:                    The stream, positioned at the 
+ *                                      first sample of a row
+ *      const struct PpmHeader *header: The image's header
+ *      unsigned char *dest:            Where the first row goes
+ *      size_t stride:                  Bytes from one row of dest to 
+ *                                      the next
+ *      unsigned rows:                  How many rows to read
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if any pointer is NULL or the rows are truncated
+ *      - samples are rescaled to [0, 255] when the maxval is not 255
+ *      
+ **********************************/
+void PackedImage_readRows(FILE *input, const struct PpmHeader *header,
+                          unsigned char *dest, size_t stride, unsigned rows)
+{
+        assert(input != NULL && header != NULL && dest != NULL);
+
+        if (header->raw) {
+                readRawRows(input, header, dest, stride, rows);
+        } else {
+                readPlainRows(input, header, dest, stride, rows);
+        }
+}
+
+/********** PackedImage_setFormat ********
+ * 
+ * Chooses what the writing functions below produce
+ *
+ * Parameters:
+ *      PackedImage_format choice: PPM_RAW for binary P6, or PPM_PLAIN for
+ *                                 decimal P3
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - not thread safe; call before anything is written
+ *      - with PPM_PLAIN, PackedImage_mapOutput always gives NULL, since 
+ *        the size of the output is not known in advance
+ *      
+ **********************************/
+void PackedImage_setFormat(PackedImage_format choice)
+{
+        format = choice;
+        if (lengths[0] != 0) {
+                return;
+        }
+        for (unsigned sample = 0; sample < 256; sample++) {
+                lengths[sample] = sprintf(digits[sample], "%u ", sample);
+        }
+}
+
+/********** PackedImage_write ********
+ * 
+ * Writes a packed image as a PPM with a maxval of 255
+ *
+ * Parameters:
+ *      FILE *output:      The stream to write to
+ *      PackedImage image: The image to write
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if output or image is NULL
+ *      - a tiled image is put back into rows as it is written
+ *      
+ **********************************/
+void PackedImage_write(FILE *output, PackedImage image)
+{
+        assert(output != NULL && image != NULL);
+
+        if (image->tiled) {
+                writeTiled(output, image);
+                return;
+        }
+
+        PackedImage_writeHeader(output, image->width, image->height);
+        PackedImage_writeRows(output, image->pixels, image->stride, 
+                              image->width, image->height);
+}
+
+/********** PackedImage_writeHeader ********
+ * 
+ * Writes the header of a PPM with a maxval of 255
+ *
+ * Parameters:
+ *      FILE *output:    The stream to write to
+ *      unsigned width:  The width of the image
+ *      unsigned height: The height of the image
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if output is NULL
+ *      
+ **********************************/
+void PackedImage_writeHeader(FILE *output, unsigned width, unsigned height)
+{
+        assert(output != NULL);
+
+        fprintf(output, format == PPM_PLAIN ? P3_HEADER : P6_HEADER, width,
+                height);
+}
+
+/********** PackedImage_writeRows ********
+ * 
+ * Writes rows of packed pixels as the payload of a PPM
+ *
+ * Parameters:
+ *      FILE *output:              The stream to write to
+ *      const unsigned char *src:  The first row to write
+ *      size_t stride:             Bytes from one row of src to the next
+ *      unsigned width:            The number of pixels in a row
+ *      unsigned rows:             How many rows to write
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if output or src is NULL
+ *      - as with fwrite, a failed write is not reported
+ *      
+ **********************************/
+void PackedImage_writeRows(FILE *output, const unsigned char *src, 
+                           size_t stride, unsigned width, unsigned rows)
+{
+        assert(output != NULL && src != NULL);
+
+        size_t rowBytes = (size_t)width * 3;
+        if (format == PPM_PLAIN) {
+                writePlain(output, src, stride, rowBytes, rows);
+        } else {
+                writeRaw(output, src, stride, rowBytes, rows);
+        }
+}
+
+/********** readRawTiled ********
+ * 
+ * Reads a raw PPM's payload into a new tiled image, one pair of rows at
+ * a time
+ *
+ * Parameters:
+ *      FILE *input:                    The stream, positioned at the 
+ *                                      first sample
+ *      const struct PpmHeader *header: The image's header
+ * 
+ * Return: the new PackedImage, as for PackedImage_readTiled
+ *
+ * Notes:
+ *      - CRE if the payload is truncated
+ *      
+ **********************************/
+static PackedImage readRawTiled(FILE *input, const struct PpmHeader *header)
+{
+        PackedImage image = PackedImage_newTiled(header->width & ~1u,
+                                                 header->height & ~1u);
+        size_t rowBytes = (size_t)header->width * 3;
+        unsigned char *pair = ALLOC(2 * rowBytes);
+
+        for (unsigned row = 0; row < image->height; row += 2) {
+                PackedImage_readRows(input, header, pair, rowBytes, 2);
+                tileRows(pair, pair + rowBytes, image->width / 2,
+                         image->pixels + row * image->stride);
+        }
+        FREE(pair);
+
+        return image;
+}
+
+/********** writeTiled ********
+ * 
+ * Writes a tiled image as a PPM, putting its pixels back into rows
+ *
+ * Parameters:
+ *      FILE *output:      The stream to write to
+ *      PackedImage image: The tiled image
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - into a file that can be mapped, the rows are untiled straight
+ *        into the output; otherwise about UNTILE_BYTES of rows at a time
+ *        are untiled into a buffer and written with PackedImage_writeRows
+ *      
+ **********************************/
+static void writeTiled(FILE *output, PackedImage image)
+{
+        unsigned blocks = image->width / 2;
+        PackedImage rows = PackedImage_mapOutput(output, image->width, 
+                                                 image->height);
+        if (rows != NULL) {
+                for (unsigned row = 0; row < image->height; row += 2) {
+                        unsigned char *top = rows->pixels + 
+                                             row * rows->stride;
+
+                        untileRows(image->pixels + row * image->stride, 
+                                   blocks, top, top + rows->stride);
+                }
+                PackedImage_free(&rows);
+                return;
+        }
+
+        unsigned pairs = UNTILE_BYTES / (2 * image->stride + 1) + 1;
+        unsigned char *buffer = ALLOC(2 * image->stride * pairs + 1);
+
+        PackedImage_writeHeader(output, image->width, image->height);
+        for (unsigned row = 0; row < image->height; ) {
+                unsigned rowCount = 0;
+
+                for (; rowCount < 2 * pairs && row < image->height; 
+                     rowCount += 2, row += 2) {
+                        unsigned char *top = buffer + 
+                                             rowCount * image->stride;
+
+                        untileRows(image->pixels + row * image->stride, 
+                                   blocks, top, top + image->stride);
+                }
+                PackedImage_writeRows(output, buffer, image->stride, 
+                                      image->width, rowCount);
+        }
+        FREE(buffer);
+}
+
+/********** tileRows ********
+ * 
+ * Copies a pair of rows of pixels into a row of tiles
+ *
+ * Parameters:
+ *      const unsigned char *top:    The top row of the pair
+ *      const unsigned char *bottom: The bottom row
+ *      unsigned blocks:             The number of 2x2 blocks in the pair
+ *      unsigned char *tiles:        Where the first block's tile goes
+ * 
+ * Return: none
+ *
+ * Notes: none
+ *      
+ **********************************/
+static void tileRows(const unsigned char *top, const unsigned char *bottom,
+                     unsigned blocks, unsigned char *tiles)
+{
+        for (unsigned i = 0; i < blocks; i++) {
+                memcpy(tiles + 12 * i, top + 6 * i, 6);
+                memcpy(tiles + 12 * i + 6, bottom + 6 * i, 6);
+        }
+}
+
+/********** untileRows ********
+ * 
+ * Copies a row of tiles back into a pair of rows of pixels
+ *
+ * Parameters:
+ *      const unsigned char *tiles: The first block's tile
+ *      unsigned blocks:            The number of 2x2 blocks in the row
+ *      unsigned char *top:         Where the top row of the pair goes
+ *      unsigned char *bottom:      Where the bottom row goes
+ * 
+ * Return: none
+ *
+ * Notes: none
+ *      
+ **********************************/
+static void untileRows(const unsigned char *tiles, unsigned blocks,
+                       unsigned char *top, unsigned char *bottom)
+{
+        for (unsigned i = 0; i < blocks; i++) {
+                memcpy(top + 6 * i, tiles + 12 * i, 6);
+                memcpy(bottom + 6 * i, tiles + 12 * i + 6, 6);
+        }
+}
+
+/********** writeRaw ********
+ * 
+ * Writes rows of packed pixels as binary samples
+ *
+ * Parameters:
+ *      FILE *output:             The stream to write to
+ *      const unsigned char *src: The first row to write
+ *      size_t stride:            Bytes from one row of src to the next
+ *      size_t rowBytes:          Bytes in a row
+ *      unsigned rows:            How many rows to write
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if the rows cannot be written
+ *      - a few rows, or rows for a stream with no file descriptor, go
+ *        through stdio; more are written with writev straight from src,
+ *        up to WRITE_ROWS rows a call, after flushing what stdio holds
+ *      
+ **********************************/
+static void writeRaw(FILE *output, const unsigned char *src, size_t stride,
+                     size_t rowBytes, unsigned rows)
+{
+        if (rowBytes * rows < BULK_BYTES || fileno(output) < 0) {
+                for (unsigned row = 0; row < rows; row++) {
+                        fwrite(src + row * stride, 1, rowBytes, output);
+                }
+                return;
+        }
+
+        /* Contiguous rows are one piece however many there are */
+        unsigned pieces = stride == rowBytes ? 1 : rows;
+        size_t pieceBytes = stride == rowBytes ? rowBytes * rows : rowBytes;
+        struct iovec iov[WRITE_ROWS];
+
+        int flushed = fflush(output);
+        assert(flushed == 0);
+        for (unsigned piece = 0; piece < pieces; ) {
+                int count = 0;
+                for (; count < WRITE_ROWS && piece < pieces; count++, piece++) {
+                        iov[count].iov_base = (void *)(src + piece * stride);
+                        iov[count].iov_len = pieceBytes;
+                }
+                writeAll(output, iov, count);
+        }
+}
+
+/********** writePlain ********
+ * 
+ * Writes rows of packed pixels as decimal samples
+ *
+ * Parameters: see writeRaw
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - each sample is copied from a table of the texts of 0 to 255,
+ *        a space included, into a buffer holding a row; a newline ends
+ *        every PLAIN_LINE samples and every row
+ *      
+ **********************************/
+static void writePlain(FILE *output, const unsigned char *src, 
+                       size_t stride, size_t rowBytes, unsigned rows)
+{
+        char *text = ALLOC(rowBytes * 4);
+        for (unsigned row = 0; row < rows; row++) {
+                const unsigned char *samples = src + row * stride;
+                char *end = text;
+
+                for (size_t i = 0; i < rowBytes; i++) {
+                        memcpy(end, digits[samples[i]], 4);
+                        end += lengths[samples[i]];
+                        if ((i + 1) % PLAIN_LINE == 0 || i + 1 == rowBytes) {
+                                end[-1] = '\n';
+                        }
+                }
+                fwrite(text, 1, end - text, output);
+        }
+        FREE(text);
+}
+
+/********** writeAll ********
+ * 
+ * Writes a whole vector of buffers with writev
+ *
+ * Parameters:
+ *      FILE *output:      The stream to write to, with nothing buffered
+ *      struct iovec *iov: The buffers; changed as parts are written
+ *      int count:         How many buffers there are
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if a write fails
+ *      - goes on after a short write or an interrupted call
+ *      - what is left goes through stdio if the descriptor does not
+ *        take writev
+ *      
+ **********************************/
+static void writeAll(FILE *output, struct iovec *iov, int count)
+{
+        while (count > 0) {
+                ssize_t wrote = writev(fileno(output), iov, count);
+                if (wrote < 0) {
+                        if (errno == EINTR) {
+                                continue;
+                        }
+                        assert(errno == EBADF || errno == EINVAL);
+                        for (; count > 0; iov++, count--) {
+                                size_t put = fwrite(iov->iov_base, 1,
+                                                    iov->iov_len, output);
+                                assert(put == iov->iov_len);
+                        }
+                        return;
+                }
+
+                while (count > 0 && (size_t)wrote >= iov->iov_len) {
+                        wrote -= iov->iov_len;
+                        iov++;
+                        count--;
+                }
+                if (count > 0) {
+                        iov->iov_base = (char *)iov->iov_base + wrote;
+                        iov->iov_len -= wrote;
+                }
+        }
+}
+
+/********** skipSpace ********
+ * 
+ * Skips whitespace and '#' comments in a PPM header
+ *
+ * Parameters:
+ *      FILE *input: The stream to read from
+ * 
+ * Return: none
+ *
+ * Notes: none
+ *      
+ **********************************/
+static void skipSpace(FILE *input)
+{
+        int c;
+
+        while ((c = getc(input)) != EOF) {
+                if (c == '#') {
+                        while ((c = getc(input)) != EOF && c != '\n') {
+                        }
+                } else if (!isspace(c)) {
+                        ungetc(c, input);
+                        return;
+                }
+        }
+}
+
+/********** readNumber ********
+ * 
+ * Reads one unsigned decimal number from a PPM header or plain payload
+ *
+ * Parameters:
+ *      FILE *input: The stream to read from
+ * 
+ * Return: the number read
+ *
+ * Notes:
+ *      - CRE if there is no number to read
+ *      
+ **********************************/
+static unsigned readNumber(FILE *input)
+{
+        unsigned num;
+
+        skipSpace(input);
+        int read = fscanf(input, "%u", &num);
+        assert(read == 1);
+
+        return num;
+}
+
+/********** readRawRows ********
+ * 
+ * Reads rows of the binary payload of a P6 image as packed pixels
+ *
+ * Parameters: see PackedImage_readRows
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if the payload is truncated
+ *      - samples take two bytes (big-endian) when maxval exceeds 255
+ *      
+ **********************************/
+static void readRawRows(FILE *input, const struct PpmHeader *header,
+                        unsigned char *dest, size_t stride, unsigned rows)
+{
+        size_t rowBytes = (size_t)header->width * 3;
+        unsigned maxval = header->maxval;
+
+        if (maxval == 255) {
+                for (unsigned row = 0; row < rows; row++) {
+                        size_t read = fread(dest + row * stride, 1, 
+                                            rowBytes, input);
+                        assert(read == rowBytes);
+                }
+                return;
+        }
+
+        unsigned bytesPerSample = maxval < 256 ? 1 : 2;
+        unsigned char *raw = ALLOC(rowBytes * bytesPerSample);
+
+        for (unsigned row = 0; row < rows; row++) {
+                unsigned char *pixels = dest + row * stride;
+                size_t read = fread(raw, bytesPerSample, rowBytes, input);
+                assert(read == rowBytes);
+
+                for (size_t i = 0; i < rowBytes; i++) {
+                        unsigned sample = raw[i * bytesPerSample];
+                        if (bytesPerSample == 2) {
+                                sample = (sample << 8) | raw[i * 2 + 1];
+                        }
+                        pixels[i] = PackedImage_scaleSample(sample, maxval);
+                }
+        }
+
+        FREE(raw);
+}
+
+/********** readPlain ********
+ * 
+ * Reads the whole decimal payload of a P3 image with the fast parser
+ *
+ * Parameters:
+ *      FILE *input:                    The stream, positioned at the 
+ *                                      first sample
+ *      const struct PpmHeader *header: The image's header
+ *      PackedImage image:              The image to fill
+ *      unsigned threads:               How many threads may parse
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if the payload is truncated or badly formatted
+ *      - a regular file is parsed where it is mapped; any other stream 
+ *        is read to its end first
+ *      - a payload with comments goes through readPlainRows instead
+ *      
+ **********************************/
+static void readPlain(FILE *input, const struct PpmHeader *header,
+                      PackedImage image, unsigned threads)
+{
+        MappedFile file = MappedFile_input(input);
+        long at = ftell(input);
+        unsigned char *buffer = NULL;
+        const unsigned char *text;
+        size_t size = 0;
+
+        if (file != NULL && at >= 0 && (size_t)at <= file->size) {
+                text = file->bytes + at;
+                size = file->size - at;
+        } else {
+                size_t capacity = 1 << 16;
+                buffer = ALLOC(capacity);
+                size_t read;
+                while ((read = fread(buffer + size, 1, capacity - size, 
+                                     input)) > 0) {
+                        size += read;
+                        if (size == capacity) {
+                                capacity *= 2;
+                                RESIZE(buffer, capacity);
+                        }
+                }
+                text = buffer;
+        }
+
+        if (!PlainPpm_parse(text, size, header, image->pixels, 
+                            image->stride, threads)) {
+                FILE *stream = fmemopen((void *)text, size, "rb");
+                assert(stream != NULL);
+                readPlainRows(stream, header, image->pixels, image->stride,
+                              header->height);
+                fclose(stream);
+        }
+
+        if (file != NULL) {
+                MappedFile_close(&file);
+        }
+        if (buffer != NULL) {
+                FREE(buffer);
+        }
+}
+
+/********** readPlainRows ********
+ * 
+ * Reads rows of the decimal payload of a P3 image as packed pixels
+ *
+ * Parameters: see PackedImage_readRows
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if the payload is truncated
+ *      
+ **********************************/
+static void readPlainRows(FILE *input, const struct PpmHeader *header,
+                          unsigned char *dest, size_t stride, unsigned rows)
+{
+        size_t rowBytes = (size_t)header->width * 3;
+
+        for (unsigned row = 0; row < rows; row++) {
+                unsigned char *pixels = dest + row * stride;
+
+                for (size_t i = 0; i < rowBytes; i++) {
+                        pixels[i] = PackedImage_scaleSample(
+                                readNumber(input), header->maxval);
+                }
+        }
+}
@@ -0,0 +1,89 @@
+/**************************************************************
+ *
+ *                     packedImage.h
+ *
+ *     Assignment: arith
+ *     Authors: Anh Hoang, Emilio Aleman
+ *     Date:  3/8/2024
+ *
+ *    This file contains the declaration of the packed image type used
+ *    internally by the compressor and decompressor. A packed image holds
+ *    8-bit R, G, B samples for each pixel in one strided buffer.
+ *
+ **************************************************************/
+#ifndef PACKEDIMAGE_INCLUDED
+#define PACKEDIMAGE_INCLUDED
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "mem.h"
+#include "assert.h"
+#include "mappedFile.h"
+
+typedef struct PackedImage *PackedImage;
+
+/* 
+ * Pixel (col, row) starts at pixels + row * stride + 3 * col and is stored
+ * as three bytes: red, green, blue. Every sample is scaled to [0, 255].
+ * When mapped is not NULL the pixels are the payload of a mapped file,
+ * read-only for PackedImage_map and the output itself for 
+ * PackedImage_mapOutput, rather than memory of their own.
+ *
+ * When tiled is set, width and height are even and each pair of rows 
+ * still takes 2 * stride bytes, but holds its 2x2 blocks in order, 
+ * twelve bytes each: the top-left, top-right, bottom-left and 
+ * bottom-right pixels. Block (col, row) then starts at 
+ * pixels + 2 * row * stride + 12 * col, so a block row is read or 
+ * written in one pass from start to end.
+ */
+struct PackedImage
+{
+        unsigned width, height;
+        size_t stride;
+        unsigned char *pixels;
+        MappedFile mapped;
+        int tiled;
+};
+
+/* What PackedImage_write and friends produce: binary P6 or decimal P3 */
+typedef enum { PPM_RAW, PPM_PLAIN } PackedImage_format;
+
+/* What a PPM header says: raw is true for P6 and false for P3 */
+struct PpmHeader
+{
+        unsigned width, height, maxval;
+        int raw;
+};
+
+PackedImage PackedImage_new(unsigned width, unsigned height);
+PackedImage PackedImage_newTiled(unsigned width, unsigned height);
+void PackedImage_free(PackedImage *image);
+PackedImage PackedImage_read(FILE *input, unsigned threads);
+PackedImage PackedImage_readTiled(FILE *input, unsigned threads,
+                                  unsigned *width, unsigned *height);
+PackedImage PackedImage_map(FILE *input);
+PackedImage PackedImage_mapOutput(FILE *output, unsigned width, 
+                                  unsigned height);
+void PackedImage_readHeader(FILE *input, struct PpmHeader *header);
+void PackedImage_readRows(FILE *input, const struct PpmHeader *header,
+                          unsigned char *dest, size_t stride, unsigned rows);
+void PackedImage_setFormat(PackedImage_format choice);
+void PackedImage_write(FILE *output, PackedImage image);
+void PackedImage_writeHeader(FILE *output, unsigned width, unsigned height);
+void PackedImage_writeRows(FILE *output, const unsigned char *src, 
+                           size_t stride, unsigned width, unsigned rows);
+
+/* Rescales a sample from [0, maxval] to [0, 255], rounding to nearest;
+ * samples above maxval are treated as maxval */
+static inline unsigned char PackedImage_scaleSample(unsigned sample, 
+                                                    unsigned maxval)
+{
+        if (sample > maxval) {
+                sample = maxval;
+        }
+
+        return (sample * 255 + maxval / 2) / maxval;
+}
+
+#endif
@@ -0,0 +1,201 @@
+/**************************************************************
+ *
+ *                     pipeline.c
+ *
+ *     Assignment: arith
+ *     Authors: Anh Hoang, Emilio Aleman
+ *     Date:  3/8/2024
+ *
+ *    This file contains the implementation of the three-stage pipeline.
+ *    Each stage counts the strips it has finished; a stage waits until
+ *    the stage before it is ahead, and the reader also waits until the
+ *    writer is less than a ring of slots behind, so memory stays bounded
+ *    however tall the image is.
+ *
+ **************************************************************/
+#include <stdlib.h>
+#include <pthread.h>
+#include "assert.h"
+#include "pipeline.h"
+
+struct Pipeline
+{
+        unsigned strips, slots;
+        Pipeline_stage *stage[3];
+        void *cl;
+        unsigned done[3];       /* strips read, computed and written */
+        pthread_mutex_t lock;
+        pthread_cond_t changed;
+};
+
+enum { READ, COMPUTE, WRITE };
+
+static void *runReader(void *arg);
+static void *runWriter(void *arg);
+static void runStage(struct Pipeline *pipeline, int stage);
+static void waitFor(struct Pipeline *pipeline, int stage, unsigned done);
+static void finish(struct Pipeline *pipeline, int stage);
+
+/********** Pipeline_run ********
+ * 
+ * Reads, computes and writes strips 0 to strips - 1, each stage in 
+ * order, and waits until the last strip is written
+ *
+ * Parameters:
+ *      unsigned strips:         The number of strips
+ *      unsigned slots:          The number of buffers the caller has, at
+ *                               least 1
+ *      Pipeline_stage *read:    Fills a slot, on the reader thread
+ *      Pipeline_stage *compute: Works on a filled slot, on the calling
+ *                               thread
+ *      Pipeline_stage *write:   Drains a computed slot, on the writer 
+ *                               thread
+ *      void *cl:                Closure passed to every stage
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if a stage is NULL, slots is 0 or a thread cannot be 
+ *        created
+ *      - three slots let all three stages run at once; more absorb
+ *        strips that take uneven times
+ *      
+ **********************************/
+void Pipeline_run(unsigned strips, unsigned slots, Pipeline_stage *read,
+                  Pipeline_stage *compute, Pipeline_stage *write, 
+                  void *cl)
+{
+        assert(read != NULL && compute != NULL && write != NULL);
+        assert(slots > 0);
+
+        struct Pipeline pipeline = { strips, slots, { read, compute, write },
+                                     cl, { 0, 0, 0 },
+                                     PTHREAD_MUTEX_INITIALIZER,
+                                     PTHREAD_COND_INITIALIZER };
+        pthread_t reader, writer;
+
+        int err = pthread_create(&reader, NULL, runReader, &pipeline);
+        assert(err == 0);
+        err = pthread_create(&writer, NULL, runWriter, &pipeline);
+        assert(err == 0);
+
+        runStage(&pipeline, COMPUTE);
+
+        pthread_join(reader, NULL);
+        pthread_join(writer, NULL);
+        pthread_cond_destroy(&pipeline.changed);
+        pthread_mutex_destroy(&pipeline.lock);
+}
+
+/********** runReader ********
+ * 
+ * Thread body that runs the read stage
+ *
+ * Parameters:
+ *      void *arg: The struct Pipeline
+ * 
+ * Return: NULL
+ *
+ * Notes: none
+ *      
+ **********************************/
+static void *runReader(void *arg)
+{
+        runStage(arg, READ);
+        return NULL;
+}
+
+/********** runWriter ********
+ * 
+ * Thread body that runs the write stage
+ *
+ * Parameters:
+ *      void *arg: The struct Pipeline
+ * 
+ * Return: NULL
+ *
+ * Notes: none
+ *      
+ **********************************/
+static void *runWriter(void *arg)
+{
+        runStage(arg, WRITE);
+        return NULL;
+}
+
+/********** runStage ********
+ * 
+ * Runs one stage on every strip in turn
+ *
+ * Parameters:
+ *      struct Pipeline *pipeline: The pipeline
+ *      int stage:                 READ, COMPUTE or WRITE
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - a strip is read once the strip a ring earlier is written, and
+ *        computed or written once the stage before has finished it
+ *      
+ **********************************/
+static void runStage(struct Pipeline *pipeline, int stage)
+{
+        unsigned slots = pipeline->slots;
+
+        for (unsigned strip = 0; strip < pipeline->strips; strip++) {
+                if (stage == READ) {
+                        waitFor(pipeline, WRITE, strip < slots ? 0 
+                                                 : strip + 1 - slots);
+                } else {
+                        waitFor(pipeline, stage - 1, strip + 1);
+                }
+
+                pipeline->stage[stage](strip, strip % slots, pipeline->cl);
+                finish(pipeline, stage);
+        }
+}
+
+/********** waitFor ********
+ * 
+ * Waits until a stage has finished a number of strips
+ *
+ * Parameters:
+ *      struct Pipeline *pipeline: The pipeline
+ *      int stage:                 The stage to wait for
+ *      unsigned done:             How many strips it must have finished
+ * 
+ * Return: none
+ *
+ * Notes: none
+ *      
+ **********************************/
+static void waitFor(struct Pipeline *pipeline, int stage, unsigned done)
+{
+        pthread_mutex_lock(&pipeline->lock);
+        while (pipeline->done[stage] < done) {
+                pthread_cond_wait(&pipeline->changed, &pipeline->lock);
+        }
+        pthread_mutex_unlock(&pipeline->lock);
+}
+
+/********** finish ********
+ * 
+ * Records that a stage has finished another strip and wakes the stages
+ * waiting on it
+ *
+ * Parameters:
+ *      struct Pipeline *pipeline: The pipeline
+ *      int stage:                 The stage
+ * 
+ * Return: none
+ *
+ * Notes: none
+ *      
+ **********************************/
+static void finish(struct Pipeline *pipeline, int stage)
+{
+        pthread_mutex_lock(&pipeline->lock);
+        pipeline->done[stage]++;
+        pthread_cond_broadcast(&pipeline->changed);
+        pthread_mutex_unlock(&pipeline->lock);
+}
@@ -0,0 +1,30 @@
+/**************************************************************
+ *
+ *                     pipeline.h
+ *
+ *     Assignment: arith
+ *     Authors: Anh Hoang, Emilio Aleman
+ *     Date:  3/8/2024
+ *
+ *    This file contains the declaration of a three-stage pipeline that
+ *    overlaps input, computation and output. An image is cut into strips
+ *    that pass through a fixed ring of slots: a reader thread fills a 
+ *    slot with the next strip while the caller computes the one before
+ *    and a writer thread writes out the one before that.
+ *
+ **************************************************************/
+#ifndef PIPELINE_INCLUDED
+#define PIPELINE_INCLUDED
+
+/*
+ * Runs one stage on one strip. index says which strip, slot says which
+ * of the caller's buffers (0 to slots - 1) holds it; a slot is not used
+ * for the next strip until the writer is done with it.
+ */
+typedef void Pipeline_stage(unsigned index, unsigned slot, void *cl);
+
+void Pipeline_run(unsigned strips, unsigned slots, Pipeline_stage *read,
+                  Pipeline_stage *compute, Pipeline_stage *write, 
+                  void *cl);
+
+#endif
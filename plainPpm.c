@@ -0,0 +1,439 @@
+/**************************************************************
+ *
+ *                     plainPpm.c
+ *
+ *     Assignment: arith
+ *     Authors: Anh Hoang, Emilio Aleman
+ *     Date:  3/8/2024
+ *
+ *    This file contains the implementation of the fast P3 reader. The
+ *    payload is classified 64 bytes at a time into a bit mask of digits
+ *    (with AVX2 where the CPU has it), and a number starts wherever a
+ *    digit follows a non-digit. A first pass counts the numbers in each
+ *    piece so that every piece knows which sample it starts at; a second
+ *    pass jumps from start to start and converts each number of up to
+ *    seven digits in one 64-bit word, reading it and the byte after it
+ *    as eight bytes; longer numbers are converted a digit at a time.
+ *
+ **************************************************************/
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "assert.h"
+#include "mem.h"
+#include "threadPool.h"
+#include "plainPpm.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PLAIN_AVX2 1
+#include <immintrin.h>
+#endif
+
+/* Payloads are split into about this many pieces per thread, none
+ * smaller than MIN_PIECE bytes */
+#define PIECES_PER_THREAD 4
+#define MIN_PIECE 65536
+
+/* Bit i of a mask stands for byte i of a 64-byte block */
+#define BLOCK 64
+
+/* Sets *other to the bytes that are neither digits nor whitespace, and
+ * returns the digits */
+typedef uint64_t MaskFun(const unsigned char *block, uint64_t *other);
+
+/* A payload being parsed, one task per piece. Piece i runs from byte
+ * bounds[i] to bounds[i + 1] and holds counts[i] numbers, the first of
+ * which is sample first[i]. stray[i] is set if the piece has a byte
+ * that is neither a digit nor whitespace, where its numbers end. */
+struct PlainParse
+{
+        const unsigned char *text;
+        size_t size;
+        size_t *bounds, *counts, *first;
+        unsigned char *stray;
+        size_t samples, rowBytes, stride;
+        unsigned char *dest;
+        const unsigned char *scale;
+        unsigned maxval;
+};
+
+static MaskFun masksScalar;
+static void pickKernel(void);
+static void countTask(unsigned piece, unsigned worker, void *cl);
+static void storeTask(unsigned piece, unsigned worker, void *cl);
+static size_t scanPiece(struct PlainParse *parse, unsigned piece,
+                        int store);
+static unsigned readNumber(const unsigned char *text, size_t at,
+                           size_t size);
+
+static MaskFun *blockMasks = masksScalar;
+static pthread_once_t pickOnce = PTHREAD_ONCE_INIT;
+
+/********** PlainPpm_parse ********
+ * 
+ * Parses the decimal payload of a P3 image into packed 8-bit RGB
+ *
+ * Parameters:
+ *      const unsigned char *text:      The payload, from just after the
+ *                                      header to the end of the input
+ *      size_t size:                    Its length in bytes
+ *      const struct PpmHeader *header: The image's header
+ *      unsigned char *dest:            Where the first row goes
+ *      size_t stride:                  Bytes from one row of dest to
+ *                                      the next
+ *      unsigned threads:               How many threads may parse
+ * 
+ * Return: 1 if the image was parsed, or 0 if the payload has '#'
+ *         comments or a byte that is neither a digit nor whitespace
+ *         before the last sample, which are left to the serial reader
+ *         in packedImage.c
+ *
+ * Notes:
+ *      - CRE if a pointer is NULL or the payload has fewer numbers than
+ *        the image needs
+ *      - samples are rescaled to [0, 255] when the maxval is not 255;
+ *        anything after the last sample is ignored
+ *      
+ **********************************/
+int PlainPpm_parse(const unsigned char *text, size_t size,
+                   const struct PpmHeader *header, unsigned char *dest,
+                   size_t stride, unsigned threads)
+{
+        assert(text != NULL && header != NULL && dest != NULL);
+        if (memchr(text, '#', size) != NULL) {
+                return 0;
+        }
+        pthread_once(&pickOnce, pickKernel);
+
+        struct PlainParse parse;
+        parse.text = text;
+        parse.size = size;
+        parse.rowBytes = (size_t)header->width * 3;
+        parse.samples = parse.rowBytes * header->height;
+        parse.stride = stride;
+        parse.dest = dest;
+        parse.maxval = header->maxval;
+
+        unsigned char *scale = ALLOC(header->maxval + 1);
+        for (unsigned sample = 0; sample <= header->maxval; sample++) {
+                scale[sample] = PackedImage_scaleSample(sample,
+                                                        header->maxval);
+        }
+        parse.scale = scale;
+
+        /* Each piece but the first starts at a byte that is not a digit,
+         * so no number is split between two pieces */
+        unsigned pieces = threads > 1 ? threads * PIECES_PER_THREAD : 1;
+        if (pieces > size / MIN_PIECE + 1) {
+                pieces = size / MIN_PIECE + 1;
+        }
+        parse.bounds = ALLOC((pieces + 1) * sizeof(*parse.bounds));
+        parse.counts = ALLOC(pieces * sizeof(*parse.counts));
+        parse.first = ALLOC(pieces * sizeof(*parse.first));
+        parse.stray = ALLOC(pieces * sizeof(*parse.stray));
+        parse.bounds[0] = 0;
+        for (unsigned i = 1; i < pieces; i++) {
+                size_t at = size / pieces * i;
+                if (at < parse.bounds[i - 1]) {
+                        at = parse.bounds[i - 1];
+                }
+                while (at < size && (unsigned)(text[at] - '0') < 10) {
+                        at++;
+                }
+                parse.bounds[i] = at;
+        }
+        parse.bounds[pieces] = size;
+
+        /* Numbers after a stray byte are not counted, so the pieces
+         * after it store nothing */
+        ThreadPool_run(threads, pieces, countTask, &parse);
+        size_t total = 0;
+        int stopped = 0;
+        for (unsigned i = 0; i < pieces; i++) {
+                parse.first[i] = total;
+                if (!stopped) {
+                        total += parse.counts[i];
+                        stopped = parse.stray[i];
+                }
+        }
+        int parsed = total >= parse.samples;
+        assert(parsed || stopped);
+        if (parsed) {
+                ThreadPool_run(threads, pieces, storeTask, &parse);
+        }
+
+        FREE(parse.bounds);
+        FREE(parse.counts);
+        FREE(parse.first);
+        FREE(parse.stray);
+        FREE(scale);
+
+        return parsed;
+}
+
+/********** countTask / storeTask ********
+ * 
+ * Count the numbers in one piece, then store its samples
+ *
+ * Parameters:
+ *      unsigned piece:  Which piece
+ *      unsigned worker: The thread running the task (unused)
+ *      void *cl:        The struct PlainParse
+ * 
+ * Return: none
+ *
+ * Notes: none
+ *      
+ **********************************/
+static void countTask(unsigned piece, unsigned worker, void *cl)
+{
+        struct PlainParse *parse = cl;
+        (void)worker;
+
+        parse->counts[piece] = scanPiece(parse, piece, 0);
+}
+
+static void storeTask(unsigned piece, unsigned worker, void *cl)
+{
+        (void)worker;
+        scanPiece(cl, piece, 1);
+}
+
+/********** scanPiece ********
+ * 
+ * Finds the numbers of a piece, counting or storing them
+ *
+ * Parameters:
+ *      struct PlainParse *parse: The payload being parsed
+ *      unsigned piece:           Which piece
+ *      int store:                0 to count the numbers, 1 to store them
+ *                                as samples from parse->first[piece] on
+ * 
+ * Return: the number of numbers in the piece, up to its first byte
+ *         that is neither a digit nor whitespace
+ *
+ * Notes:
+ *      - sets parse->stray[piece] if the piece has such a byte
+ *      - the last, partial block is copied out and padded with spaces,
+ *        so nothing past the piece is classified
+ *      
+ **********************************/
+static size_t scanPiece(struct PlainParse *parse, unsigned piece,
+                        int store)
+{
+        size_t from = parse->bounds[piece], to = parse->bounds[piece + 1];
+        size_t index = store ? parse->first[piece] : 0, count = 0;
+        size_t row = index / parse->rowBytes, col = index % parse->rowBytes;
+        unsigned char padded[BLOCK];
+        uint64_t carry = 0;
+        int stray = 0;
+
+        for (size_t pos = from; pos < to; pos += BLOCK) {
+                const unsigned char *block = parse->text + pos;
+                if (to - pos < BLOCK) {
+                        memcpy(padded, block, to - pos);
+                        memset(padded + (to - pos), ' ', BLOCK - (to - pos));
+                        block = padded;
+                }
+
+                uint64_t other;
+                uint64_t digits = blockMasks(block, &other);
+                /* A number running into the stray byte is left out, as
+                 * if it were not there */
+                uint64_t cut = 0;
+                if (other != 0) {
+                        cut = (digits << 1 | carry) & other & -other;
+                        digits &= (other & -other) - 1;
+                        stray = 1;
+                }
+                uint64_t starts = digits & ~(digits << 1 | carry);
+                carry = digits >> (BLOCK - 1);
+
+                if (!store) {
+                        count += __builtin_popcountll(starts);
+                        if (stray) {
+                                count -= cut != 0;
+                                break;
+                        }
+                        continue;
+                }
+                for (; starts != 0 && index < parse->samples; index++) {
+                        size_t at = pos + __builtin_ctzll(starts);
+                        unsigned sample = readNumber(parse->text, at,
+                                                     parse->size);
+                        starts &= starts - 1;
+
+                        if (sample > parse->maxval) {
+                                sample = parse->maxval;
+                        }
+                        parse->dest[row * parse->stride + col] =
+                                parse->scale[sample];
+                        if (++col == parse->rowBytes) {
+                                col = 0;
+                                row++;
+                        }
+                        count++;
+                }
+                if (index >= parse->samples || stray) {
+                        break;
+                }
+        }
+
+        if (!store) {
+                parse->stray[piece] = stray;
+        }
+        return count;
+}
+
+/********** readNumber ********
+ * 
+ * Converts the decimal number starting at a byte of the payload
+ *
+ * Parameters:
+ *      const unsigned char *text: The payload
+ *      size_t at:                 Where the number's first digit is
+ *      size_t size:               The payload's length
+ * 
+ * Return: the number, or a number above any maxval if it is too large
+ *
+ * Notes:
+ *      - a number of at most seven digits with eight bytes of payload
+ *        left is converted in one 64-bit word: the bytes past its last
+ *        digit are shifted out, which leaves leading zeros, and pairs,
+ *        fours and eights of digits are combined with three multiplies
+ *      
+ **********************************/
+static unsigned readNumber(const unsigned char *text, size_t at,
+                           size_t size)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        if (at + 8 <= size) {
+                const uint64_t zeros = 0x3030303030303030ull;
+                const uint64_t high = 0xf0f0f0f0f0f0f0f0ull;
+                uint64_t word;
+
+                memcpy(&word, text + at, 8);
+                /* A byte is a digit when both its high nibble and that
+                 * of the byte plus 6 are 3 */
+                uint64_t other = ((word & high) ^ zeros) |
+                                 (((word + 0x0606060606060606ull) & high) ^
+                                  zeros);
+                if (other != 0) {
+                        unsigned length = __builtin_ctzll(other) / 8;
+
+                        word = (word - zeros) << (8 * (8 - length));
+                        word = word * 10 + (word >> 8);
+                        word = ((word & 0x000000ff000000ffull) *
+                                (100 + (1000000ull << 32)) +
+                                ((word >> 16) & 0x000000ff000000ffull) *
+                                (1 + (10000ull << 32))) >> 32;
+                        return word;
+                }
+        }
+#endif
+        unsigned number = 0;
+
+        for (; at < size && (unsigned)(text[at] - '0') < 10; at++) {
+                if (number < 1u << 24) {
+                        number = number * 10 + (text[at] - '0');
+                }
+        }
+        return number;
+}
+
+/********** masksScalar ********
+ * 
+ * Classifies a block of payload one byte at a time
+ *
+ * Parameters: see MaskFun
+ * 
+ * Return: the mask of digits
+ *
+ * Notes: whitespace is what isspace accepts in the C locale
+ *      
+ **********************************/
+static uint64_t masksScalar(const unsigned char *block, uint64_t *other)
+{
+        uint64_t digits = 0, rest = 0;
+
+        for (unsigned i = 0; i < BLOCK; i++) {
+                unsigned c = block[i];
+                if (c - '0' < 10u) {
+                        digits |= 1ull << i;
+                } else if (c != ' ' && c - '\t' > (unsigned)('\r' - '\t')) {
+                        rest |= 1ull << i;
+                }
+        }
+
+        *other = rest;
+        return digits;
+}
+
+#ifdef PLAIN_AVX2
+
+/********** masksAvx2 ********
+ * 
+ * Classifies a block of payload 32 bytes at a time with AVX2
+ *
+ * Parameters: see MaskFun
+ * 
+ * Return: the mask of digits
+ *
+ * Notes:
+ *      - compares are signed, so bytes from 0x80 up come out as neither
+ *        digits nor whitespace, as they should
+ *      
+ **********************************/
+__attribute__((target("avx2")))
+static uint64_t masksAvx2(const unsigned char *block, uint64_t *other)
+{
+        const __m256i belowZero = _mm256_set1_epi8('0' - 1);
+        const __m256i aboveNine = _mm256_set1_epi8('9' + 1);
+        const __m256i space = _mm256_set1_epi8(' ');
+        const __m256i belowTab = _mm256_set1_epi8('\t' - 1);
+        const __m256i aboveReturn = _mm256_set1_epi8('\r' + 1);
+        uint64_t digits = 0, spaces = 0;
+
+        for (unsigned half = 0; half < 2; half++) {
+                __m256i c = _mm256_loadu_si256((const __m256i *)
+                                               (block + 32 * half));
+                __m256i digit = _mm256_and_si256(
+                        _mm256_cmpgt_epi8(c, belowZero),
+                        _mm256_cmpgt_epi8(aboveNine, c));
+                __m256i white = _mm256_or_si256(
+                        _mm256_cmpeq_epi8(c, space),
+                        _mm256_and_si256(_mm256_cmpgt_epi8(c, belowTab),
+                                         _mm256_cmpgt_epi8(aboveReturn, c)));
+
+                digits |= (uint64_t)(uint32_t)_mm256_movemask_epi8(digit)
+                          << (32 * half);
+                spaces |= (uint64_t)(uint32_t)_mm256_movemask_epi8(white)
+                          << (32 * half);
+        }
+
+        *other = ~(digits | spaces);
+        return digits;
+}
+
+#endif
+
+/********** pickKernel ********
+ * 
+ * Picks the fastest classifier the CPU supports
+ *
+ * Parameters: none
+ * 
+ * Return: none
+ *
+ * Notes: runs once, through pthread_once
+ *      
+ **********************************/
+static void pickKernel(void)
+{
+#ifdef PLAIN_AVX2
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+                blockMasks = masksAvx2;
+        }
+#endif
+}
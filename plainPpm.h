@@ -0,0 +1,25 @@
+/**************************************************************
+ *
+ *                     plainPpm.h
+ *
+ *     Assignment: arith
+ *     Authors: Anh Hoang, Emilio Aleman
+ *     Date:  3/8/2024
+ *
+ *    This file contains the declaration of the fast reader for the
+ *    decimal payload of a plain (P3) PPM. The payload is split at
+ *    whitespace into pieces that are parsed on several threads, each
+ *    storing its samples straight into the packed pixel buffer.
+ *
+ **************************************************************/
+#ifndef PLAINPPM_INCLUDED
+#define PLAINPPM_INCLUDED
+
+#include <stdlib.h>
+#include "packedImage.h"
+
+int PlainPpm_parse(const unsigned char *text, size_t size,
+                   const struct PpmHeader *header, unsigned char *dest,
+                   size_t stride, unsigned threads);
+
+#endif
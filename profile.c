@@ -0,0 +1,262 @@
+/**************************************************************
+ *
+ *                     profile.c
+ *
+ *     Assignment: arith
+ *     Authors: Anh Hoang, Emilio Aleman
+ *     Date:  3/8/2024
+ *
+ *    This file contains the implementation of the --profile counters. A
+ *    thread opens its group the first time it reads it, counting only
+ *    itself in user space, so the bands of -j are counted on the threads
+ *    that run them, and closes it when it exits. Events the kernel or the machine refuses (a virtual
+ *    machine often has no hardware counters) are left out of the group,
+ *    and an event stays unavailable unless some thread could open it.
+ *    When the PMU is shared, the kernel may count a group only part of
+ *    the time; readings are scaled up to the whole time, as perf stat
+ *    does.
+ *
+ **************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "assert.h"
+#include "profile.h"
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+/* The events of a group, leader first */
+static const struct {
+        const char *name;
+        uint32_t type;
+        uint64_t config;
+} events[PROFILE_EVENTS] = {
+#ifdef __linux__
+        { "cycles",           PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { "instructions",     PERF_TYPE_HARDWARE,
+                              PERF_COUNT_HW_INSTRUCTIONS },
+        { "cache_references", PERF_TYPE_HARDWARE,
+                              PERF_COUNT_HW_CACHE_REFERENCES },
+        { "cache_misses",     PERF_TYPE_HARDWARE,
+                              PERF_COUNT_HW_CACHE_MISSES },
+        { "branches",         PERF_TYPE_HARDWARE,
+                              PERF_COUNT_HW_BRANCH_INSTRUCTIONS },
+        { "branch_misses",    PERF_TYPE_HARDWARE,
+                              PERF_COUNT_HW_BRANCH_MISSES },
+        { "page_faults",      PERF_TYPE_SOFTWARE,
+                              PERF_COUNT_SW_PAGE_FAULTS },
+        { "context_switches", PERF_TYPE_SOFTWARE,
+                              PERF_COUNT_SW_CONTEXT_SWITCHES },
+#else
+        { "cycles", 0, 0 }, { "instructions", 0, 0 },
+        { "cache_references", 0, 0 }, { "cache_misses", 0, 0 },
+        { "branches", 0, 0 }, { "branch_misses", 0, 0 },
+        { "page_faults", 0, 0 }, { "context_switches", 0, 0 },
+#endif
+};
+
+/* One thread's group. slots[e] is where event e comes in a group read,
+ * or -1 if it did not open; fds holds the members' descriptors, the
+ * leader's first */
+struct Group
+{
+        int state;              /* 0 not yet opened, 1 open, -1 none */
+        int leader;
+        unsigned members;
+        int slots[PROFILE_EVENTS];
+        int fds[PROFILE_EVENTS];
+};
+
+static __thread struct Group group;
+static unsigned availableMask;  /* events open on some thread */
+
+/* Its destructor closes a thread's group when the thread exits */
+static pthread_key_t groupKey;
+static pthread_once_t keyOnce = PTHREAD_ONCE_INIT;
+
+static void openGroup(struct Group *g);
+static void makeKey(void);
+static void closeGroup(void *cl);
+
+/********** Profile_read ********
+ * 
+ * Reads the calling thread's counters, opening its group the first time
+ *
+ * Parameters:
+ *      uint64_t counts[PROFILE_EVENTS]: Set to each event's count since
+ *                                       the group opened, or 0 for an
+ *                                       event that is unavailable
+ * 
+ * Return: 1 if the counts were read, 0 if this thread has no counters
+ *
+ * Notes:
+ *      - CRE if counts is NULL
+ *      - the group stays open until the thread exits, and is closed
+ *        then
+ *      
+ **********************************/
+int Profile_read(uint64_t counts[PROFILE_EVENTS])
+{
+        assert(counts != NULL);
+        memset(counts, 0, PROFILE_EVENTS * sizeof(*counts));
+
+        if (group.state == 0) {
+                openGroup(&group);
+        }
+        if (group.state < 0) {
+                return 0;
+        }
+
+        /* Number of events, time enabled, time running, then the counts */
+        uint64_t values[3 + PROFILE_EVENTS];
+        ssize_t want = (3 + group.members) * sizeof(*values);
+        if (read(group.leader, values, want) != want || values[0] !=
+            group.members) {
+                return 0;
+        }
+
+        double scale = 1;
+        if (values[2] > 0 && values[2] < values[1]) {
+                scale = (double)values[1] / values[2];
+        }
+        for (unsigned e = 0; e < PROFILE_EVENTS; e++) {
+                if (group.slots[e] >= 0) {
+                        counts[e] = values[3 + group.slots[e]] * scale;
+                }
+        }
+
+        return 1;
+}
+
+/********** Profile_available ********
+ * 
+ * Tells whether an event could be counted on any thread so far
+ *
+ * Parameters:
+ *      Profile_event event: The event
+ * 
+ * Return: 1 if it could, else 0
+ *
+ * Notes:
+ *      - CRE if event is out of range
+ *      
+ **********************************/
+int Profile_available(Profile_event event)
+{
+        assert(event < PROFILE_EVENTS);
+        return (__atomic_load_n(&availableMask, __ATOMIC_RELAXED) >> event)
+               & 1;
+}
+
+/********** Profile_name ********
+ * 
+ * Names an event, as the JSON report spells it
+ *
+ * Parameters:
+ *      Profile_event event: The event
+ * 
+ * Return: the name, in static storage
+ *
+ * Notes:
+ *      - CRE if event is out of range
+ *      
+ **********************************/
+const char *Profile_name(Profile_event event)
+{
+        assert(event < PROFILE_EVENTS);
+        return events[event].name;
+}
+
+/********** openGroup ********
+ * 
+ * Opens the calling thread's counters as one group
+ *
+ * Parameters:
+ *      struct Group *g: The thread's group, not yet opened
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - the first event that opens leads the group; if none opens,
+ *        g->state becomes -1 and the thread is never tried again
+ *      - an open group is registered to be closed when the thread exits
+ *      
+ **********************************/
+static void openGroup(struct Group *g)
+{
+        g->state = -1;
+        g->leader = -1;
+        g->members = 0;
+
+#ifdef __linux__
+        for (unsigned e = 0; e < PROFILE_EVENTS; e++) {
+                struct perf_event_attr attr;
+                memset(&attr, 0, sizeof(attr));
+                attr.size = sizeof(attr);
+                attr.type = events[e].type;
+                attr.config = events[e].config;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                attr.read_format = PERF_FORMAT_GROUP |
+                                   PERF_FORMAT_TOTAL_TIME_ENABLED |
+                                   PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+                int fd = syscall(SYS_perf_event_open, &attr, 0, -1,
+                                 g->leader, 0);
+                if (fd < 0) {
+                        g->slots[e] = -1;
+                        continue;
+                }
+                if (g->leader < 0) {
+                        g->leader = fd;
+                }
+                g->fds[g->members] = fd;
+                g->slots[e] = g->members++;
+                __atomic_or_fetch(&availableMask, 1u << e, __ATOMIC_RELAXED);
+        }
+        if (g->leader >= 0) {
+                g->state = 1;
+                pthread_once(&keyOnce, makeKey);
+                pthread_setspecific(groupKey, g);
+        }
+#else
+        for (unsigned e = 0; e < PROFILE_EVENTS; e++) {
+                g->slots[e] = -1;
+        }
+#endif
+}
+
+/********** makeKey / closeGroup ********
+ * 
+ * Create the key whose destructor closes a thread's group, and close it
+ *
+ * Parameters:
+ *      void *cl: The exiting thread's struct Group
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - the members are closed before the leader
+ *      
+ **********************************/
+static void makeKey(void)
+{
+        int made = pthread_key_create(&groupKey, closeGroup);
+        assert(made == 0);
+}
+
+static void closeGroup(void *cl)
+{
+        struct Group *g = cl;
+
+        while (g->members > 0) {
+                close(g->fds[--g->members]);
+        }
+        g->leader = -1;
+        g->state = -1;
+}
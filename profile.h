@@ -0,0 +1,32 @@
+/**************************************************************
+ *
+ *                     profile.h
+ *
+ *     Assignment: arith
+ *     Authors: Anh Hoang, Emilio Aleman
+ *     Date:  3/8/2024
+ *
+ *    This file contains the declaration of the hardware counters behind
+ *    --profile. Each thread that asks opens one perf_event_open group of
+ *    cycles, instructions, cache and branch events, so the counters of a
+ *    group are read together and a stage sees them all over the same
+ *    stretch of time.
+ *
+ **************************************************************/
+#ifndef PROFILE_INCLUDED
+#define PROFILE_INCLUDED
+
+#include <stdint.h>
+
+typedef enum {
+        PROFILE_CYCLES, PROFILE_INSTRUCTIONS, PROFILE_CACHE_REFERENCES,
+        PROFILE_CACHE_MISSES, PROFILE_BRANCHES, PROFILE_BRANCH_MISSES,
+        PROFILE_PAGE_FAULTS, PROFILE_CONTEXT_SWITCHES,
+        PROFILE_EVENTS
+} Profile_event;
+
+int Profile_read(uint64_t counts[PROFILE_EVENTS]);
+int Profile_available(Profile_event event);
+const char *Profile_name(Profile_event event);
+
+#endif
@@ -13,6 +13,33 @@
  **************************************************************/
 #include "rgbConversion.h"
 
+/********** imageToRgbQuad **********
+ * 
+ * Reads the 2x2 block of pixels whose top-left corner is at the specified
+ * column and row into a caller-owned RGB quad.
+ *
+ * Parameters:
+ *      Pnm_ppm image: The input image.
+ *      int col: The column index.
+ *      int row: The row index.
+ *      struct rgbQuad *quad: Storage for the four pixels.
+ *
+ * Return: none
+ *
+ * Notes: 
+ *      - CRE if quad is NULL
+ * 
+ **********************************/
+void imageToRgbQuad(Pnm_ppm image, int col, int row, struct rgbQuad *quad)
+{
+        assert(quad != NULL);
+
+        quad->rgb1 = imageToRGBval(image, col, row);
+        quad->rgb2 = imageToRGBval(image, col + 1, row);
+        quad->rgb3 = imageToRGBval(image, col, row + 1);
+        quad->rgb4 = imageToRGBval(image, col + 1, row + 1);
+}
+
 /********** imageToRgbBlock **********
  * 
  * Create an RGB block from a Pnm_ppm image at the specified column and row.
@@ -41,6 +68,34 @@ rgbBlock imageToRgbBlock(Pnm_ppm image, int col, int row)
         return rgbBlock;
 }
 
+/********** imageToRGBval **********
+ * 
+ * Read the pixel of a Pnm_ppm image at the specified column and row as an
+ * RGB value scaled to [0, 1].
+ *
+ * Parameters:
+ *      Pnm_ppm image: The input image.
+ *      int col: The column index.
+ *      int row: The row index.
+ *
+ * Return: The RGB value of the pixel
+ *
+ * Notes: 
+ *      - does not allocate
+ * 
+ *******************************/
+struct RGB imageToRGBval(Pnm_ppm image, int col, int row)
+{
+        Pnm_rgb pixel = image->methods->at(image->pixels, col, row);
+        struct RGB rgb;
+
+        rgb.r = ((float)pixel->red) / 255;
+        rgb.g = ((float)pixel->green) / 255;
+        rgb.b = ((float)pixel->blue) / 255;
+
+        return rgb;
+}
+
 /********** imageToRGB **********
  * 
  * Create an RGB struct from a Pnm_ppm image at the specified column and row.
@@ -54,6 +109,7 @@ rgbBlock imageToRgbBlock(Pnm_ppm image, int col, int row)
  *
  * Notes: 
  *      - RGB will be freed outside where the function is called
+ *      - thin wrapper around imageToRGBval
  * 
  *******************************/
 RGB imageToRGB(Pnm_ppm image, int col, int row)
@@ -61,16 +117,61 @@ RGB imageToRGB(Pnm_ppm image, int col, int row)
         RGB rgb;
         NEW(rgb);
 
-        rgb->r = ((float)((Pnm_rgb)(image->methods
-                ->at(image->pixels, col, row)))->red) / 255;
-        rgb->g = ((float)((Pnm_rgb)(image->methods
-                ->at(image->pixels, col, row)))->green) / 255; 
-        rgb->b = ((float)((Pnm_rgb)(image->methods
-                ->at(image->pixels, col, row)))->blue) / 255;
+        *rgb = imageToRGBval(image, col, row);
 
         return rgb;
 }
 
+/********** RGBvalToImage **********
+ * 
+ * Update the RGB values of a Pnm_ppm image at the specified column and row.
+ *
+ * Parameters:
+ *      Pnm_ppm image: The input image.
+ *      struct RGB rgb: The RGB values to set, scaled to [0, 1].
+ *      int col: The column index.
+ *      int row: The row index.
+ *
+ * Notes:
+ *      none
+ * 
+ *******************************/
+void RGBvalToImage(Pnm_ppm image, struct RGB rgb, int col, int row)
+{
+        Pnm_rgb pixel = image->methods->at(image->pixels, col, row);
+
+        /* Scale RGB values from [0, 1] to [0, 255] */
+        pixel->red = (unsigned)inRange(rgb.r * 255, 0, 255);
+        pixel->green = (unsigned)inRange(rgb.g * 255, 0, 255);
+        pixel->blue = (unsigned)inRange(rgb.b * 255, 0, 255);
+}
+
+/********** rgbQuadToImage **********
+ * 
+ * Write the four pixels of an RGB quad into the 2x2 block of a Pnm_ppm
+ * image whose top-left corner is at the specified column and row.
+ *
+ * Parameters:
+ *      Pnm_ppm image: The output image.
+ *      const struct rgbQuad *quad: The four pixels to write.
+ *      int col: The column index.
+ *      int row: The row index.
+ *
+ * Notes:
+ *      - CRE if quad is NULL
+ * 
+ *******************************/
+void rgbQuadToImage(Pnm_ppm image, const struct rgbQuad *quad, 
+                    int col, int row)
+{
+        assert(quad != NULL);
+
+        RGBvalToImage(image, quad->rgb1, col, row);
+        RGBvalToImage(image, quad->rgb2, col + 1, row);
+        RGBvalToImage(image, quad->rgb3, col, row + 1);
+        RGBvalToImage(image, quad->rgb4, col + 1, row + 1);
+}
+
 /********** RGBtoImage **********
  * 
  * Update the RGB values of a Pnm_ppm image at the specified column and row.
@@ -82,22 +183,157 @@ RGB imageToRGB(Pnm_ppm image, int col, int row)
  *      int row: The row index.
  *
  * Notes:
- *      none
+ *      - CRE if rgb is NULL
+ *      - thin wrapper around RGBvalToImage
  * 
  *******************************/
 void RGBtoImage(Pnm_ppm image, RGB rgb, int col, int row)
 {
         assert(rgb != NULL);
 
+        RGBvalToImage(image, *rgb, col, row);
+}
+
+/********** packedToRGB **********
+ * 
+ * Read one pixel of a packed image as an RGB value scaled to [0, 1].
+ *
+ * Parameters:
+ *      const unsigned char *pixel: The red, green and blue bytes of the pixel
+ *
+ * Return: The RGB value of the pixel
+ *
+ * Notes: 
+ *      - does not allocate
+ * 
+ *******************************/
+struct RGB packedToRGB(const unsigned char *pixel)
+{
+        struct RGB rgb;
+
+        rgb.r = ((float)pixel[0]) / 255;
+        rgb.g = ((float)pixel[1]) / 255;
+        rgb.b = ((float)pixel[2]) / 255;
+
+        return rgb;
+}
+
+/********** packedToRgbQuad **********
+ * 
+ * Read a 2x2 block of a packed image into a caller-owned RGB quad.
+ *
+ * Parameters:
+ *      const unsigned char *top:    The left pixel of the block's top row
+ *      const unsigned char *bottom: The left pixel of the block's bottom row
+ *      struct rgbQuad *quad:        Storage for the four pixels.
+ *
+ * Return: none
+ *
+ * Notes: 
+ *      - CRE if quad is NULL
+ * 
+ *******************************/
+void packedToRgbQuad(const unsigned char *top, const unsigned char *bottom,
+                     struct rgbQuad *quad)
+{
+        assert(quad != NULL);
+
+        quad->rgb1 = packedToRGB(top);
+        quad->rgb2 = packedToRGB(top + 3);
+        quad->rgb3 = packedToRGB(bottom);
+        quad->rgb4 = packedToRGB(bottom + 3);
+}
+
+/********** RGBtoPacked **********
+ * 
+ * Store an RGB value into one pixel of a packed image.
+ *
+ * Parameters:
+ *      struct RGB rgb:        The RGB values to set, scaled to [0, 1].
+ *      unsigned char *pixel:  The red, green and blue bytes to write
+ *
+ * Notes:
+ *      none
+ * 
+ *******************************/
+void RGBtoPacked(struct RGB rgb, unsigned char *pixel)
+{
         /* Scale RGB values from [0, 1] to [0, 255] */
-        ((Pnm_rgb)image->methods->at(image->pixels, col, row))->red 
-                                = (unsigned)inRange(rgb->r * 255, 0, 255);
+        pixel[0] = (unsigned)inRange(rgb.r * 255, 0, 255);
+        pixel[1] = (unsigned)inRange(rgb.g * 255, 0, 255);
+        pixel[2] = (unsigned)inRange(rgb.b * 255, 0, 255);
+}
 
-        ((Pnm_rgb)image->methods->at(image->pixels, col, row))->green 
-                                = (unsigned)inRange(rgb->g * 255, 0, 255);
-        
-        ((Pnm_rgb)image->methods->at(image->pixels, col, row))->blue 
-                                = (unsigned)inRange(rgb->b * 255, 0, 255);
+/********** rgbQuadToPacked **********
+ * 
+ * Write the four pixels of an RGB quad into a 2x2 block of a packed image.
+ *
+ * Parameters:
+ *      const struct rgbQuad *quad: The four pixels to write.
+ *      unsigned char *top:         The left pixel of the block's top row
+ *      unsigned char *bottom:      The left pixel of the block's bottom row
+ *
+ * Notes:
+ *      - CRE if quad is NULL
+ * 
+ *******************************/
+void rgbQuadToPacked(const struct rgbQuad *quad, unsigned char *top,
+                     unsigned char *bottom)
+{
+        assert(quad != NULL);
+
+        RGBtoPacked(quad->rgb1, top);
+        RGBtoPacked(quad->rgb2, top + 3);
+        RGBtoPacked(quad->rgb3, bottom);
+        RGBtoPacked(quad->rgb4, bottom + 3);
+}
+
+/********** compVidtoRGBval **********
+ * 
+ * Convert a ComponentVideo value to RGB.
+ *
+ * Parameters:
+ *      struct ComponentVideo cv: The input ComponentVideo.
+ *
+ * Return: The RGB value, scaled to [0, 1] but not clamped
+ * 
+ * Notes:
+ *      - does not allocate
+ * 
+ *****************************/
+struct RGB compVidtoRGBval(struct ComponentVideo cv)
+{
+        struct RGB rgb;
+
+        rgb.r = 1.0 * cv.y + 0.0 * cv.pb + 1.402 * cv.pr;
+        rgb.g = 1.0 * cv.y - 0.344136 * cv.pb - 0.714136 * cv.pr;
+        rgb.b = 1.0 * cv.y + 1.772 * cv.pb + 0.081312 * cv.pr;
+
+        return rgb;
+}
+
+/********** CvQuadToRgbQuad **********
+ * 
+ * Convert the four Component Video values of a 2x2 block to RGB.
+ *
+ * Parameters:
+ *      const struct CompVidQuad *cvQuad: The input Component Video block.
+ *      struct rgbQuad *quad: Caller-owned storage for the result.
+ *
+ * Return: none
+ * 
+ * Notes:
+ *      - CRE if cvQuad or quad is NULL
+ * 
+ *****************************/
+void CvQuadToRgbQuad(const struct CompVidQuad *cvQuad, struct rgbQuad *quad)
+{
+        assert(cvQuad != NULL && quad != NULL);
+
+        quad->rgb1 = compVidtoRGBval(cvQuad->cv1);
+        quad->rgb2 = compVidtoRGBval(cvQuad->cv2);
+        quad->rgb3 = compVidtoRGBval(cvQuad->cv3);
+        quad->rgb4 = compVidtoRGBval(cvQuad->cv4);
 }
 
 /********** compVidtoRGB **********
@@ -113,6 +349,7 @@ void RGBtoImage(Pnm_ppm image, RGB rgb, int col, int row)
  *      - CRE if cv is NULL
  *      - The RGB struct is dynamically allocated and must be freed 
  *      by the caller.
+ *      - thin wrapper around compVidtoRGBval
  * 
  *****************************/
 RGB compVidtoRGB(ComponentVideo cv)
@@ -121,9 +358,7 @@ RGB compVidtoRGB(ComponentVideo cv)
         RGB rgb;
         NEW(rgb);
 
-        rgb->r = 1.0 * cv->y + 0.0 * cv->pb + 1.402 * cv->pr;
-        rgb->g = 1.0 * cv->y - 0.344136 * cv->pb - 0.714136 * cv->pr;
-        rgb->b = 1.0 * cv->y + 1.772 * cv->pb + 0.081312 * cv->pr;
+        *rgb = compVidtoRGBval(*cv);
 
         return rgb;
 }
@@ -23,6 +23,21 @@
 #include "except.h"
 #include "pnm.h"
 #include "helpers.h"
+#include "packedImage.h"
+
+struct RGB imageToRGBval(Pnm_ppm image, int col, int row);
+void imageToRgbQuad(Pnm_ppm image, int col, int row, struct rgbQuad *quad);
+void RGBvalToImage(Pnm_ppm image, struct RGB rgb, int col, int row);
+void rgbQuadToImage(Pnm_ppm image, const struct rgbQuad *quad, 
+                    int col, int row);
+struct RGB packedToRGB(const unsigned char *pixel);
+void packedToRgbQuad(const unsigned char *top, const unsigned char *bottom,
+                     struct rgbQuad *quad);
+void RGBtoPacked(struct RGB rgb, unsigned char *pixel);
+void rgbQuadToPacked(const struct rgbQuad *quad, unsigned char *top,
+                     unsigned char *bottom);
+struct RGB compVidtoRGBval(struct ComponentVideo cv);
+void CvQuadToRgbQuad(const struct CompVidQuad *cvQuad, struct rgbQuad *quad);
 
 RGB imageToRGB(Pnm_ppm image, int col, int row);
 rgbBlock imageToRgbBlock(Pnm_ppm image, int col, int row);
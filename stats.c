@@ -0,0 +1,377 @@
+/**************************************************************
+ *
+ *                     stats.c
+ *
+ *     Assignment: arith
+ *     Authors: Anh Hoang, Emilio Aleman
+ *     Date:  3/8/2024
+ *
+ *    This file contains the implementation of the --stats instrumentation.
+ *    A stage is timed from Stats_start to Stats_stop on the wall clock and
+ *    on the calling thread's CPU clock, and the time is added to the
+ *    stage's totals atomically, so the bands of -j time themselves on
+ *    their own threads. With several threads a stage's totals are summed
+ *    over the threads and can exceed the run's wall time.
+ *
+ *    With --profile a stage also adds up the change in the thread's
+ *    hardware counters, read from profile.c when it starts and stops.
+ *
+ **************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include "assert.h"
+#include "bitpackInline.h"
+#include "decodeKernel.h"
+#include "compress40.h"
+#include "stats.h"
+
+int Stats_enabled = 0;
+
+static int profiling = 0;
+static const char *reportPath;
+static struct timespec runStart;
+static uint64_t stageWall[STATS_STAGES];        /* nanoseconds */
+static uint64_t stageCpu[STATS_STAGES];
+static uint64_t counters[STATS_COUNTERS];
+static uint64_t stageCounts[STATS_STAGES][PROFILE_EVENTS];
+
+static const char *stageNames[STATS_STAGES] = {
+        "read", "encode", "pack", "entropy", "decode", "write"
+};
+
+static uint64_t elapsedNs(const struct timespec *from,
+                          const struct timespec *to);
+static void reportCounters(FILE *out, const uint64_t *counts);
+
+/********** Stats_enable ********
+ * 
+ * Turns the instrumentation on and starts timing the run
+ *
+ * Parameters:
+ *      const char *path: Where Stats_report writes, or NULL for stderr
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - call before any thread starts; path must outlive the run
+ *      
+ **********************************/
+void Stats_enable(const char *path)
+{
+        reportPath = path;
+        clock_gettime(CLOCK_MONOTONIC, &runStart);
+        Stats_enabled = 1;
+}
+
+/********** Stats_profile ********
+ * 
+ * Turns the instrumentation on with hardware counters per stage
+ *
+ * Parameters: none
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - call before any thread starts; reports to stderr unless 
+ *        Stats_enable gives a file
+ *      
+ **********************************/
+void Stats_profile(void)
+{
+        if (!Stats_enabled) {
+                Stats_enable(NULL);
+        }
+        profiling = 1;
+}
+
+/********** Stats_startTimer ********
+ * 
+ * Notes the start of a stage on the calling thread
+ *
+ * Parameters:
+ *      struct Stats_timer *timer: Where to note it
+ * 
+ * Return: none
+ *
+ * Notes: called through Stats_start
+ *      
+ **********************************/
+void Stats_startTimer(struct Stats_timer *timer)
+{
+        clock_gettime(CLOCK_MONOTONIC, &timer->wall);
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &timer->cpu);
+        timer->counted = profiling && Profile_read(timer->counts);
+}
+
+/********** Stats_stopTimer ********
+ * 
+ * Adds the time since a Stats_startTimer on the same thread to a stage
+ *
+ * Parameters:
+ *      Stats_stage stage:               The stage that ran
+ *      const struct Stats_timer *timer: When it started
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if stage is out of range
+ *      - called through Stats_stop; safe from several threads at once
+ *      
+ **********************************/
+void Stats_stopTimer(Stats_stage stage, const struct Stats_timer *timer)
+{
+        assert(stage < STATS_STAGES);
+        struct timespec wall, cpu;
+        uint64_t counts[PROFILE_EVENTS];
+
+        if (timer->counted && Profile_read(counts)) {
+                for (unsigned e = 0; e < PROFILE_EVENTS; e++) {
+                        __atomic_add_fetch(&stageCounts[stage][e],
+                                           counts[e] - timer->counts[e],
+                                           __ATOMIC_RELAXED);
+                }
+        }
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+        clock_gettime(CLOCK_MONOTONIC, &wall);
+        __atomic_add_fetch(&stageWall[stage], elapsedNs(&timer->wall, &wall),
+                           __ATOMIC_RELAXED);
+        __atomic_add_fetch(&stageCpu[stage], elapsedNs(&timer->cpu, &cpu),
+                           __ATOMIC_RELAXED);
+}
+
+/********** Stats_add ********
+ * 
+ * Adds to a counter
+ *
+ * Parameters:
+ *      Stats_counter counter: The counter
+ *      uint64_t n:            How much to add
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if counter is out of range
+ *      - called through Stats_count; safe from several threads at once
+ *      
+ **********************************/
+void Stats_add(Stats_counter counter, uint64_t n)
+{
+        assert(counter < STATS_COUNTERS);
+        __atomic_add_fetch(&counters[counter], n, __ATOMIC_RELAXED);
+}
+
+/********** Stats_countEncoded ********
+ * 
+ * Counts the blocks of a row just compressed and the values clamped on
+ * the way to their codewords
+ *
+ * Parameters:
+ *      const struct Compressed *comps: The row's quantized values
+ *      unsigned count:                 How many there are
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - a b, c or d at +-15 is counted as clamped by quantize, which is
+ *        exact but for values landing on +-0.3 itself
+ *      - a field that does not fit its width is counted as clamped by
+ *        packing, which is what --saturate does to it; without it the
+ *        row raises Bitpack_Overflow once packed
+ *      - called through Stats_encoded
+ *      
+ **********************************/
+void Stats_countEncoded(const struct Compressed *comps, unsigned count)
+{
+        uint64_t quantized = 0, packed = 0;
+
+        for (unsigned i = 0; i < count; i++) {
+                struct Compressed comp = comps[i];
+
+                quantized += (abs(comp.b) >= 15) + (abs(comp.c) >= 15) +
+                             (abs(comp.d) >= 15);
+                packed += (Bitpack_overu32(comp.a, CODEWORD_A_WIDTH) != 0) +
+                          (Bitpack_overs32(comp.b, CODEWORD_B_WIDTH) != 0) +
+                          (Bitpack_overs32(comp.c, CODEWORD_C_WIDTH) != 0) +
+                          (Bitpack_overs32(comp.d, CODEWORD_D_WIDTH) != 0) +
+                          (Bitpack_overu32(comp.pb_avg,
+                                           CODEWORD_PB_WIDTH) != 0) +
+                          (Bitpack_overu32(comp.pr_avg,
+                                           CODEWORD_PR_WIDTH) != 0);
+        }
+
+        Stats_add(STATS_BLOCKS, count);
+        Stats_add(STATS_QUANTIZE_CLAMPS, quantized);
+        Stats_add(STATS_PACK_CLAMPS, packed);
+}
+
+/********** Stats_countDecoded ********
+ * 
+ * Counts the blocks of a row just decompressed and the values clamped on
+ * the way to their pixels
+ *
+ * Parameters:
+ *      const uint32_t *words: The row's codewords, in host order
+ *      unsigned count:        How many there are
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - b, c and d fields beyond +-15 are those dequantize clamps
+ *      - called through Stats_decoded
+ *      
+ **********************************/
+void Stats_countDecoded(const uint32_t *words, unsigned count)
+{
+        uint64_t dequantized = 0;
+
+        for (unsigned i = 0; i < count; i++) {
+                struct Compressed comp = Codeword_unpack(words[i]);
+
+                dequantized += (abs(comp.b) > 15) + (abs(comp.c) > 15) +
+                               (abs(comp.d) > 15);
+        }
+
+        Stats_add(STATS_BLOCKS, count);
+        Stats_add(STATS_DEQUANTIZE_CLAMPS, dequantized);
+        Stats_add(STATS_CHANNEL_CLAMPS, decodeCountClamps(words, count));
+}
+
+/********** Stats_report ********
+ * 
+ * Writes the run's stats as one JSON object
+ *
+ * Parameters:
+ *      const char *mode: "compress" or "decompress"
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if the report file cannot be created
+ *      - does nothing unless stats are on
+ *      - the run's CPU time and peak memory are the process's, from
+ *        getrusage
+ *      - with --profile each stage also lists the counters available,
+ *        with IPC and miss rates where their events are
+ *      
+ **********************************/
+void Stats_report(const char *mode)
+{
+        if (!Stats_enabled) {
+                return;
+        }
+
+        struct timespec now;
+        struct rusage usage;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        getrusage(RUSAGE_SELF, &usage);
+
+        FILE *out = stderr;
+        if (reportPath != NULL) {
+                out = fopen(reportPath, "w");
+                assert(out != NULL);
+        }
+
+        double cpuMs = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3 +
+                       (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e3;
+        fprintf(out, "{\"mode\": \"%s\", \"engine\": \"%s\", "
+                "\"threads\": %u,\n", mode,
+                compress40Options.exact ? "exact" : "fixed",
+                compress40Options.threads);
+        fprintf(out, " \"wall_ms\": %.3f, \"cpu_ms\": %.3f, "
+                "\"peak_rss_kb\": %ld,\n", elapsedNs(&runStart, &now) / 1e6,
+                cpuMs, usage.ru_maxrss);
+        fprintf(out, " \"blocks\": %lu, \"bytes_in\": %lu, "
+                "\"bytes_out\": %lu,\n",
+                (unsigned long)counters[STATS_BLOCKS],
+                (unsigned long)counters[STATS_BYTES_IN],
+                (unsigned long)counters[STATS_BYTES_OUT]);
+        fprintf(out, " \"clamps\": {\"quantize\": %lu, \"pack\": %lu, "
+                "\"dequantize\": %lu, \"channel\": %lu},\n",
+                (unsigned long)counters[STATS_QUANTIZE_CLAMPS],
+                (unsigned long)counters[STATS_PACK_CLAMPS],
+                (unsigned long)counters[STATS_DEQUANTIZE_CLAMPS],
+                (unsigned long)counters[STATS_CHANNEL_CLAMPS]);
+        fprintf(out, " \"stages\": {");
+        for (unsigned i = 0; i < STATS_STAGES; i++) {
+                fprintf(out, "%s\n  \"%s\": {\"wall_ms\": %.3f, "
+                        "\"cpu_ms\": %.3f", i > 0 ? "," : "",
+                        stageNames[i], stageWall[i] / 1e6,
+                        stageCpu[i] / 1e6);
+                if (profiling) {
+                        reportCounters(out, stageCounts[i]);
+                }
+                fprintf(out, "}");
+        }
+        fprintf(out, "}");
+        if (profiling) {
+                fprintf(out, ",\n \"counters_available\": [");
+                for (unsigned e = 0, n = 0; e < PROFILE_EVENTS; e++) {
+                        if (Profile_available(e)) {
+                                fprintf(out, "%s\"%s\"", n++ > 0 ? ", " : "",
+                                        Profile_name(e));
+                        }
+                }
+                fprintf(out, "]");
+        }
+        fprintf(out, "}\n");
+
+        if (out != stderr) {
+                fclose(out);
+        }
+}
+
+/* Nanoseconds from one time to a later one */
+static uint64_t elapsedNs(const struct timespec *from,
+                          const struct timespec *to)
+{
+        return (uint64_t)(to->tv_sec - from->tv_sec) * 1000000000u +
+               to->tv_nsec - from->tv_nsec;
+}
+
+/********** reportCounters ********
+ * 
+ * Writes one stage's counters as JSON members
+ *
+ * Parameters:
+ *      FILE *out:             Where the report goes
+ *      const uint64_t *counts: The stage's count of each event
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - events no thread could count are left out, as are the ratios
+ *        that need them
+ *      
+ **********************************/
+static void reportCounters(FILE *out, const uint64_t *counts)
+{
+        for (unsigned e = 0; e < PROFILE_EVENTS; e++) {
+                if (Profile_available(e)) {
+                        fprintf(out, ", \"%s\": %lu", Profile_name(e),
+                                (unsigned long)counts[e]);
+                }
+        }
+
+        if (Profile_available(PROFILE_CYCLES) &&
+            Profile_available(PROFILE_INSTRUCTIONS) &&
+            counts[PROFILE_CYCLES] > 0) {
+                fprintf(out, ", \"ipc\": %.3f",
+                        (double)counts[PROFILE_INSTRUCTIONS] /
+                        counts[PROFILE_CYCLES]);
+        }
+        if (Profile_available(PROFILE_CACHE_MISSES) &&
+            Profile_available(PROFILE_CACHE_REFERENCES) &&
+            counts[PROFILE_CACHE_REFERENCES] > 0) {
+                fprintf(out, ", \"cache_miss_rate\": %.4f",
+                        (double)counts[PROFILE_CACHE_MISSES] /
+                        counts[PROFILE_CACHE_REFERENCES]);
+        }
+        if (Profile_available(PROFILE_BRANCH_MISSES) &&
+            Profile_available(PROFILE_BRANCHES) &&
+            counts[PROFILE_BRANCHES] > 0) {
+                fprintf(out, ", \"branch_miss_rate\": %.4f",
+                        (double)counts[PROFILE_BRANCH_MISSES] /
+                        counts[PROFILE_BRANCHES]);
+        }
+}
@@ -0,0 +1,98 @@
+/**************************************************************
+ *
+ *                     stats.h
+ *
+ *     Assignment: arith
+ *     Authors: Anh Hoang, Emilio Aleman
+ *     Date:  3/8/2024
+ *
+ *    This file contains the declaration of the --stats instrumentation:
+ *    wall and CPU time per pipeline stage, counters for blocks, bytes and
+ *    clamped values, and peak memory, reported as JSON. Every hook tests
+ *    Stats_enabled inline first, so with stats off a hook costs a branch.
+ *
+ **************************************************************/
+#ifndef STATS_INCLUDED
+#define STATS_INCLUDED
+
+#include <stdint.h>
+#include <time.h>
+#include "helpers.h"
+#include "profile.h"
+
+typedef enum {
+        STATS_READ, STATS_ENCODE, STATS_PACK, STATS_ENTROPY, STATS_DECODE,
+        STATS_WRITE, STATS_STAGES
+} Stats_stage;
+
+typedef enum {
+        STATS_BLOCKS,           /* blocks compressed or decompressed */
+        STATS_BYTES_IN,         /* pixel or codeword bytes read */
+        STATS_BYTES_OUT,        /* codeword or pixel bytes written */
+        STATS_QUANTIZE_CLAMPS,  /* b, c or d quantized at +-0.3 */
+        STATS_PACK_CLAMPS,      /* fields saturated to fit a codeword */
+        STATS_DEQUANTIZE_CLAMPS,/* b, c or d fields beyond +-15 */
+        STATS_CHANNEL_CLAMPS,   /* decoded channels clamped to [0, 255] */
+        STATS_COUNTERS
+} Stats_counter;
+
+/* When a stage started, on the wall clock and the thread's CPU clock,
+ * and with --profile the thread's counters then */
+struct Stats_timer
+{
+        struct timespec wall, cpu;
+        int counted;
+        uint64_t counts[PROFILE_EVENTS];
+};
+
+extern int Stats_enabled;
+
+void Stats_enable(const char *path);
+void Stats_profile(void);
+void Stats_report(const char *mode);
+void Stats_startTimer(struct Stats_timer *timer);
+void Stats_stopTimer(Stats_stage stage, const struct Stats_timer *timer);
+void Stats_add(Stats_counter counter, uint64_t n);
+void Stats_countEncoded(const struct Compressed *comps, unsigned count);
+void Stats_countDecoded(const uint32_t *words, unsigned count);
+
+/* The hooks the pipeline calls; each does nothing unless stats are on */
+
+static inline void Stats_start(struct Stats_timer *timer)
+{
+        if (Stats_enabled) {
+                Stats_startTimer(timer);
+        }
+}
+
+static inline void Stats_stop(Stats_stage stage,
+                              const struct Stats_timer *timer)
+{
+        if (Stats_enabled) {
+                Stats_stopTimer(stage, timer);
+        }
+}
+
+static inline void Stats_count(Stats_counter counter, uint64_t n)
+{
+        if (Stats_enabled) {
+                Stats_add(counter, n);
+        }
+}
+
+static inline void Stats_encoded(const struct Compressed *comps,
+                                 unsigned count)
+{
+        if (Stats_enabled) {
+                Stats_countEncoded(comps, count);
+        }
+}
+
+static inline void Stats_decoded(const uint32_t *words, unsigned count)
+{
+        if (Stats_enabled) {
+                Stats_countDecoded(words, count);
+        }
+}
+
+#endif
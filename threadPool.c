@@ -0,0 +1,122 @@
+/**************************************************************
+ *
+ *                     threadPool.c
+ *
+ *     Assignment: arith
+ *     Authors: Anh Hoang, Emilio Aleman
+ *     Date:  3/8/2024
+ *
+ *    This file contains the implementation of the fork-join thread pool.
+ *    Workers claim tasks from a shared counter until none are left, so a
+ *    slow band never holds up the others.
+ *
+ **************************************************************/
+#include <stdlib.h>
+#include <pthread.h>
+#include "assert.h"
+#include "mem.h"
+#include "threadPool.h"
+
+struct Job 
+{
+        ThreadPool_task *task;
+        void *cl;
+        unsigned tasks;
+        unsigned next;
+};
+
+struct Worker
+{
+        struct Job *job;
+        unsigned id;
+};
+
+static void *runWorker(void *arg);
+
+/********** ThreadPool_run ********
+ * 
+ * Runs tasks 0 to tasks - 1 on up to the given number of threads and 
+ * waits for all of them to finish
+ *
+ * Parameters:
+ *      unsigned threads:      The number of threads to use, counting the
+ *                             calling thread
+ *      unsigned tasks:        The number of tasks to run
+ *      ThreadPool_task *task: The function that runs one task
+ *      void *cl:              Closure passed to every task
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if task is NULL or a thread cannot be created
+ *      - with one thread, or one task, everything runs on the caller
+ *      
+ **********************************/
+void ThreadPool_run(unsigned threads, unsigned tasks, 
+                    ThreadPool_task *task, void *cl)
+{
+        assert(task != NULL);
+
+        if (threads > tasks) {
+                threads = tasks;
+        }
+
+        struct Job job = { task, cl, tasks, 0 };
+        if (threads <= 1) {
+                for (unsigned i = 0; i < tasks; i++) {
+                        task(i, 0, cl);
+                }
+                return;
+        }
+
+        pthread_t *ids = ALLOC(threads * sizeof(*ids));
+        struct Worker *workers = ALLOC(threads * sizeof(*workers));
+
+        for (unsigned i = 0; i < threads; i++) {
+                workers[i].job = &job;
+                workers[i].id = i;
+        }
+        for (unsigned i = 1; i < threads; i++) {
+                int err = pthread_create(&ids[i], NULL, runWorker, 
+                                         &workers[i]);
+                assert(err == 0);
+        }
+
+        runWorker(&workers[0]);
+
+        for (unsigned i = 1; i < threads; i++) {
+                pthread_join(ids[i], NULL);
+        }
+
+        FREE(workers);
+        FREE(ids);
+}
+
+/********** runWorker ********
+ * 
+ * Claims and runs tasks until there are none left
+ *
+ * Parameters:
+ *      void *arg: The struct Worker for this thread
+ * 
+ * Return: NULL
+ *
+ * Notes: none
+ *      
+ **********************************/
+static void *runWorker(void *arg)
+{
+        struct Worker *worker = arg;
+        struct Job *job = worker->job;
+
+        for (;;) {
+                unsigned index = __atomic_fetch_add(&job->next, 1, 
+                                                    __ATOMIC_RELAXED);
+                if (index >= job->tasks) {
+                        break;
+                }
+                job->task(index, worker->id, job->cl);
+        }
+
+        return NULL;
+}
@@ -0,0 +1,26 @@
+/**************************************************************
+ *
+ *                     threadPool.h
+ *
+ *     Assignment: arith
+ *     Authors: Anh Hoang, Emilio Aleman
+ *     Date:  3/8/2024
+ *
+ *    This file contains the declaration of a small fork-join thread pool
+ *    used to run independent bands of an image on several threads.
+ *
+ **************************************************************/
+#ifndef THREADPOOL_INCLUDED
+#define THREADPOOL_INCLUDED
+
+/* 
+ * Runs one task. index says which task, worker says which thread is
+ * running it (0 to threads - 1) so the task can use per-thread scratch
+ * storage that the caller set up.
+ */
+typedef void ThreadPool_task(unsigned index, unsigned worker, void *cl);
+
+void ThreadPool_run(unsigned threads, unsigned tasks, 
+                    ThreadPool_task *task, void *cl);
+
+#endif
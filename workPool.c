@@ -0,0 +1,296 @@
+/**************************************************************
+ *
+ *                     workPool.c
+ *
+ *     Assignment: arith
+ *     Authors: Anh Hoang, Emilio Aleman
+ *     Date:  3/8/2024
+ *
+ *    This file contains the implementation of the work-stealing thread
+ *    pool. Each worker has a deque of tasks. It pushes and pops tasks at
+ *    the bottom, so it finishes the pieces of its own job first while
+ *    they are warm in its cache, and an idle worker steals from the top
+ *    of another's deque, taking the oldest and usually largest task.
+ *    The pool is done when no task is queued or running.
+ *
+ **************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include "assert.h"
+#include "mem.h"
+#include "workPool.h"
+
+struct Task
+{
+        WorkPool_task *run;
+        void *arg;
+};
+
+/* Tasks head to tail - 1 are queued; the bottom is at the tail */
+struct Deque
+{
+        pthread_mutex_t lock;
+        struct Task *tasks;
+        unsigned head, tail, size;
+};
+
+struct WorkPool
+{
+        unsigned threads;
+        struct Deque *deques;
+        unsigned pending;       /* queued or running, updated atomically */
+};
+
+struct Worker
+{
+        WorkPool pool;
+        unsigned id;
+};
+
+static void *runWorker(void *arg);
+static int popBottom(struct Deque *deque, struct Task *task);
+static int stealTop(struct Deque *deque, struct Task *task);
+
+/********** WorkPool_new ********
+ * 
+ * Creates a pool with no tasks
+ *
+ * Parameters:
+ *      unsigned threads: The number of threads to run tasks on, counting
+ *                        the thread that calls WorkPool_run
+ * 
+ * Return: the new WorkPool
+ *
+ * Notes:
+ *      - CRE if threads is 0
+ *      - the pool must be freed with WorkPool_free
+ *      
+ **********************************/
+WorkPool WorkPool_new(unsigned threads)
+{
+        assert(threads > 0);
+
+        WorkPool pool;
+        NEW(pool);
+        pool->threads = threads;
+        pool->pending = 0;
+        pool->deques = ALLOC(threads * sizeof(*pool->deques));
+
+        for (unsigned i = 0; i < threads; i++) {
+                struct Deque *deque = &pool->deques[i];
+                pthread_mutex_init(&deque->lock, NULL);
+                deque->size = 16;
+                deque->tasks = ALLOC(deque->size * sizeof(*deque->tasks));
+                deque->head = deque->tail = 0;
+        }
+
+        return pool;
+}
+
+/********** WorkPool_free ********
+ * 
+ * Frees a pool
+ *
+ * Parameters:
+ *      WorkPool *pool: Pointer to the pool to free
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if pool or *pool is NULL
+ *      - *pool is set to NULL
+ *      
+ **********************************/
+void WorkPool_free(WorkPool *pool)
+{
+        assert(pool != NULL && *pool != NULL);
+
+        for (unsigned i = 0; i < (*pool)->threads; i++) {
+                pthread_mutex_destroy(&(*pool)->deques[i].lock);
+                FREE((*pool)->deques[i].tasks);
+        }
+        FREE((*pool)->deques);
+        FREE(*pool);
+}
+
+/********** WorkPool_spawn ********
+ * 
+ * Adds a task to the bottom of a worker's deque
+ *
+ * Parameters:
+ *      WorkPool pool:      The pool
+ *      unsigned worker:    Whose deque gets the task; a running task
+ *                          passes its own worker
+ *      WorkPool_task *run: The function that runs the task
+ *      void *arg:          What to pass it
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if pool or run is NULL or worker is out of range
+ *      - may be called before WorkPool_run, or by a running task
+ *      
+ **********************************/
+void WorkPool_spawn(WorkPool pool, unsigned worker,
+                    WorkPool_task *run, void *arg)
+{
+        assert(pool != NULL && run != NULL && worker < pool->threads);
+        struct Deque *deque = &pool->deques[worker];
+
+        __atomic_add_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST);
+
+        pthread_mutex_lock(&deque->lock);
+        if (deque->tail == deque->size) {
+                if (deque->head > 0) {
+                        memmove(deque->tasks, deque->tasks + deque->head,
+                                (deque->tail - deque->head) *
+                                sizeof(*deque->tasks));
+                        deque->tail -= deque->head;
+                        deque->head = 0;
+                } else {
+                        deque->size *= 2;
+                        RESIZE(deque->tasks,
+                               deque->size * sizeof(*deque->tasks));
+                }
+        }
+        deque->tasks[deque->tail].run = run;
+        deque->tasks[deque->tail].arg = arg;
+        deque->tail++;
+        pthread_mutex_unlock(&deque->lock);
+}
+
+/********** WorkPool_run ********
+ * 
+ * Runs the spawned tasks, and any tasks they spawn, until none are left
+ *
+ * Parameters:
+ *      WorkPool pool: The pool
+ * 
+ * Return: none
+ *
+ * Notes:
+ *      - CRE if pool is NULL or a thread cannot be created
+ *      - the calling thread is worker 0
+ *      
+ **********************************/
+void WorkPool_run(WorkPool pool)
+{
+        assert(pool != NULL);
+        unsigned threads = pool->threads;
+
+        pthread_t *ids = ALLOC(threads * sizeof(*ids));
+        struct Worker *workers = ALLOC(threads * sizeof(*workers));
+
+        for (unsigned i = 0; i < threads; i++) {
+                workers[i].pool = pool;
+                workers[i].id = i;
+        }
+        for (unsigned i = 1; i < threads; i++) {
+                int err = pthread_create(&ids[i], NULL, runWorker,
+                                         &workers[i]);
+                assert(err == 0);
+        }
+
+        runWorker(&workers[0]);
+
+        for (unsigned i = 1; i < threads; i++) {
+                pthread_join(ids[i], NULL);
+        }
+
+        FREE(workers);
+        FREE(ids);
+}
+
+/********** runWorker ********
+ * 
+ * Runs tasks from this worker's deque, or stolen from the others, until
+ * the pool is done
+ *
+ * Parameters:
+ *      void *arg: The struct Worker for this thread
+ * 
+ * Return: NULL
+ *
+ * Notes:
+ *      - yields the CPU while there is nothing to steal but other
+ *        workers' tasks are still running, since those may spawn more
+ *      
+ **********************************/
+static void *runWorker(void *arg)
+{
+        struct Worker *worker = arg;
+        WorkPool pool = worker->pool;
+        unsigned threads = pool->threads;
+        struct Task task;
+
+        for (;;) {
+                int found = popBottom(&pool->deques[worker->id], &task);
+
+                for (unsigned k = 1; !found && k < threads; k++) {
+                        unsigned victim = (worker->id + k) % threads;
+                        found = stealTop(&pool->deques[victim], &task);
+                }
+
+                if (found) {
+                        task.run(pool, worker->id, task.arg);
+                        __atomic_sub_fetch(&pool->pending, 1,
+                                           __ATOMIC_SEQ_CST);
+                } else if (__atomic_load_n(&pool->pending,
+                                           __ATOMIC_SEQ_CST) == 0) {
+                        break;
+                } else {
+                        sched_yield();
+                }
+        }
+
+        return NULL;
+}
+
+/********** popBottom / stealTop ********
+ * 
+ * Take the newest or the oldest task from a deque
+ *
+ * Parameters:
+ *      struct Deque *deque: The deque
+ *      struct Task *task:   Set to the task taken
+ * 
+ * Return: 1 if a task was taken, 0 if the deque was empty
+ *
+ * Notes: none
+ *      
+ **********************************/
+static int popBottom(struct Deque *deque, struct Task *task)
+{
+        int found = 0;
+
+        pthread_mutex_lock(&deque->lock);
+        if (deque->head < deque->tail) {
+                *task = deque->tasks[--deque->tail];
+                found = 1;
+                if (deque->head == deque->tail) {
+                        deque->head = deque->tail = 0;
+                }
+        }
+        pthread_mutex_unlock(&deque->lock);
+
+        return found;
+}
+
+static int stealTop(struct Deque *deque, struct Task *task)
+{
+        int found = 0;
+
+        pthread_mutex_lock(&deque->lock);
+        if (deque->head < deque->tail) {
+                *task = deque->tasks[deque->head++];
+                found = 1;
+                if (deque->head == deque->tail) {
+                        deque->head = deque->tail = 0;
+                }
+        }
+        pthread_mutex_unlock(&deque->lock);
+
+        return found;
+}
@@ -0,0 +1,31 @@
+/**************************************************************
+ *
+ *                     workPool.h
+ *
+ *     Assignment: arith
+ *     Authors: Anh Hoang, Emilio Aleman
+ *     Date:  3/8/2024
+ *
+ *    This file contains the declaration of a work-stealing thread pool.
+ *    Unlike ThreadPool_run, tasks may spawn more tasks while the pool
+ *    runs, so a job can fan out into as many pieces as it needs.
+ *
+ **************************************************************/
+#ifndef WORKPOOL_INCLUDED
+#define WORKPOOL_INCLUDED
+
+typedef struct WorkPool *WorkPool;
+
+/*
+ * Runs one task. worker says which thread is running it (0 to threads
+ * - 1), for per-thread scratch storage and for WorkPool_spawn.
+ */
+typedef void WorkPool_task(WorkPool pool, unsigned worker, void *arg);
+
+WorkPool WorkPool_new(unsigned threads);
+void WorkPool_free(WorkPool *pool);
+void WorkPool_spawn(WorkPool pool, unsigned worker,
+                    WorkPool_task *task, void *arg);
+void WorkPool_run(WorkPool pool);
+
+#endif